@@ -0,0 +1,238 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include "bench_mode.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+
+#include "block_index.h"
+#include "mem.h"
+
+// Sizes of the number of blocks field and of every block length field in a
+// .zjump file.
+static const size_t kNumBlocksFieldBytes    = 2;
+static const size_t kBlockLengthFieldBytes  = 3;
+
+static double Elapsed(const std::chrono::steady_clock::time_point& start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double Median(std::vector<double> values) {
+    assert(!values.empty());
+    std::sort(values.begin(), values.end());
+    const size_t mid = values.size() / 2;
+    return (values.size() % 2 == 1) ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+}
+
+static double Speed(size_t size, double seconds) {
+    return (seconds > 0) ? static_cast<double>(size) / seconds / 1000000 : 0;
+}
+
+BenchResult::BenchResult() {
+    block_size = 0;
+    num_threads = 0;
+    in_size = 0;
+    compressed_size = 0;
+    min_compress_time = 0;
+    median_compress_time = 0;
+    min_decompress_time = 0;
+    median_decompress_time = 0;
+}
+
+double BenchResult::Ratio() const {
+    return (compressed_size > 0) ? static_cast<double>(in_size) / compressed_size : 0;
+}
+
+InMemoryBench::InMemoryBench(const uint8_t* data, size_t data_size) {
+    data_ = data;
+    data_size_ = data_size;
+    in_stream_ = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+    out_stream_ = SecureAlloc<uint8_t>(kBlockMaxCompressedStreamSize);
+    // Blocks are restored right into place, so the last one still needs a
+    // whole block buffer.
+    restored_ = SecureAlloc<uint8_t>(data_size + kBlockMaxExpandedStreamSize);
+}
+
+InMemoryBench::~InMemoryBench() {
+    SecureFree<uint8_t>(in_stream_);
+    SecureFree<uint8_t>(out_stream_);
+    SecureFree<uint8_t>(restored_);
+}
+
+ZjumpErrorCode InMemoryBench::Run(size_t block_size,
+                                  int num_threads,
+                                  int num_iterations,
+                                  BenchResult* result) {
+    assert(block_size > 0);
+    assert(block_size <= kBlockMaxExpandedStreamSize);
+    assert(num_threads > 0);
+    assert(num_iterations > 0);
+    assert(result != nullptr);
+
+    std::vector<double> compress_times;
+    std::vector<double> decompress_times;
+    size_t compressed_size = 0;
+
+    block_comp_.SetNumThreads(num_threads);
+
+    for(int i=0; i<num_iterations; ++i) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        ZjumpErrorCode ret_code = Compress(block_size, &compressed_size);
+        compress_times.push_back(Elapsed(start));
+        if(ret_code != ZJUMP_NO_ERROR) {
+            return ret_code;
+        }
+
+        std::memset(restored_, 0, data_size_);
+
+        start = std::chrono::steady_clock::now();
+        ret_code = Decompress(block_size);
+        decompress_times.push_back(Elapsed(start));
+        if(ret_code != ZJUMP_NO_ERROR) {
+            return ret_code;
+        }
+
+        if(std::memcmp(restored_, data_, data_size_) != 0) {
+            return ZJUMP_ERROR_RECONSTRUCTING_STREAM;
+        }
+    }
+
+    result->block_size = block_size;
+    result->num_threads = num_threads;
+    result->in_size = data_size_;
+    result->compressed_size = compressed_size;
+    result->min_compress_time = *std::min_element(compress_times.begin(), compress_times.end());
+    result->median_compress_time = Median(compress_times);
+    result->min_decompress_time = *std::min_element(decompress_times.begin(), decompress_times.end());
+    result->median_decompress_time = Median(decompress_times);
+
+    return ZJUMP_NO_ERROR;
+}
+
+ZjumpErrorCode InMemoryBench::Compress(size_t block_size, size_t* compressed_size) {
+    compressed_.clear();
+    compressed_block_sizes_.clear();
+    block_comp_.Reset();
+
+    size_t total_size = kNumBlocksFieldBytes;
+
+    for(size_t offset=0; offset<data_size_; offset+=block_size) {
+        const size_t in_size = std::min(block_size, data_size_ - offset);
+        size_t out_size = 0;
+
+        // Blocks are transformed in place, as Compressor does with the
+        // blocks it reads.
+        std::memcpy(in_stream_, data_ + offset, in_size);
+
+        ZjumpErrorCode ret_code = block_comp_.Compress(in_stream_, in_size, out_stream_, &out_size);
+        if(ret_code != ZJUMP_NO_ERROR) {
+            return ret_code;
+        }
+
+        compressed_.insert(compressed_.end(), out_stream_, out_stream_ + out_size);
+        compressed_block_sizes_.push_back(out_size);
+        total_size += kBlockLengthFieldBytes + out_size;
+    }
+
+    // Bit stream readers may load a few bytes past the end of the last block
+    compressed_.resize(compressed_.size() + kBlockReadPaddingBytes, 0);
+    *compressed_size = total_size;
+
+    return ZJUMP_NO_ERROR;
+}
+
+ZjumpErrorCode InMemoryBench::Decompress(size_t block_size) {
+    uint8_t *in = compressed_.data();
+    uint8_t *out = restored_;
+
+    block_decomp_.Reset();
+
+    for(size_t i=0; i<compressed_block_sizes_.size(); ++i) {
+        size_t out_size = 0;
+
+        ZjumpErrorCode ret_code = block_decomp_.Decompress(in, compressed_block_sizes_[i], out, &out_size);
+        if(ret_code != ZJUMP_NO_ERROR) {
+            return ret_code;
+        }
+
+        if((out_size > block_size) || (out + out_size > restored_ + data_size_)) {
+            return ZJUMP_ERROR_RECONSTRUCTING_STREAM;
+        }
+
+        in += compressed_block_sizes_[i];
+        out += out_size;
+    }
+
+    if(out != restored_ + data_size_) {
+        return ZJUMP_ERROR_RECONSTRUCTING_STREAM;
+    }
+
+    return ZJUMP_NO_ERROR;
+}
+
+void PrintBenchResults(FILE* file,
+                       const char* name,
+                       const std::vector<BenchResult>& results) {
+    fprintf(file, "%s\n", name);
+    fprintf(file, "%10s %7s %12s %12s %7s %21s %21s\n",
+            "block", "threads", "size", "compressed", "ratio",
+            "comp MB/s (max/med)", "decomp MB/s (max/med)");
+
+    for(size_t i=0; i<results.size(); ++i) {
+        const BenchResult &r = results[i];
+        fprintf(file, "%10zu %7d %12zu %12zu %7.3f %10.2f %10.2f %10.2f %10.2f\n",
+                r.block_size, r.num_threads, r.in_size, r.compressed_size, r.Ratio(),
+                Speed(r.in_size, r.min_compress_time),
+                Speed(r.in_size, r.median_compress_time),
+                Speed(r.in_size, r.min_decompress_time),
+                Speed(r.in_size, r.median_decompress_time));
+    }
+}
+
+static void PrintJsonString(FILE* file, const char* str) {
+    fputc('"', file);
+    for(const char *c=str; *c!='\0'; ++c) {
+        if((*c == '"') || (*c == '\\')) {
+            fprintf(file, "\\%c", *c);
+        } else if(static_cast<unsigned char>(*c) < 0x20) {
+            fprintf(file, "\\u%04x", *c);
+        } else {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+void PrintBenchResultsJson(FILE* file,
+                           const char* name,
+                           const std::vector<BenchResult>& results) {
+    fprintf(file, "{\n  \"file\": ");
+    PrintJsonString(file, name);
+    fprintf(file, ",\n  \"version\": %u,\n  \"results\": [", kZjumpVersion);
+
+    for(size_t i=0; i<results.size(); ++i) {
+        const BenchResult &r = results[i];
+        fprintf(file, "%s\n    {\"block_size\": %zu, \"threads\": %d, \"size\": %zu, "
+                "\"compressed_size\": %zu, \"ratio\": %.4f, "
+                "\"compress_seconds_min\": %.6f, \"compress_seconds_median\": %.6f, "
+                "\"decompress_seconds_min\": %.6f, \"decompress_seconds_median\": %.6f, "
+                "\"compress_mbps_max\": %.2f, \"compress_mbps_median\": %.2f, "
+                "\"decompress_mbps_max\": %.2f, \"decompress_mbps_median\": %.2f}",
+                (i == 0) ? "" : ",",
+                r.block_size, r.num_threads, r.in_size, r.compressed_size, r.Ratio(),
+                r.min_compress_time, r.median_compress_time,
+                r.min_decompress_time, r.median_decompress_time,
+                Speed(r.in_size, r.min_compress_time),
+                Speed(r.in_size, r.median_compress_time),
+                Speed(r.in_size, r.min_decompress_time),
+                Speed(r.in_size, r.median_decompress_time));
+    }
+
+    fprintf(file, "\n  ]\n}\n");
+}
@@ -0,0 +1,82 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#ifndef BENCH_MODE_H_
+#define BENCH_MODE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "block_compressor.h"
+#include "block_decompressor.h"
+#include "constants.h"
+
+// Measurements of one benchmark configuration. Times are in seconds.
+struct BenchResult {
+    size_t block_size;
+    int num_threads;
+    size_t in_size;
+    size_t compressed_size;
+    double min_compress_time;
+    double median_compress_time;
+    double min_decompress_time;
+    double median_decompress_time;
+
+    BenchResult();
+
+    double Ratio() const;
+};
+
+// InMemoryBench class
+//
+// Compresses and decompresses a buffer as zjump would do with a file, but
+// without any I/O, and checks that the data is restored. The compressed
+// size includes the same headers a .zjump file has.
+class InMemoryBench {
+public:
+    InMemoryBench(const uint8_t* data, size_t data_size);
+
+    ~InMemoryBench();
+
+    // Runs num_iterations rounds of compression and decompression with
+    // blocks of block_size bytes (at most kBlockMaxExpandedStreamSize) and
+    // num_threads threads for the suffix sorting. Returns
+    // ZJUMP_ERROR_RECONSTRUCTING_STREAM if the data is not restored.
+    ZjumpErrorCode Run(size_t block_size,
+                       int num_threads,
+                       int num_iterations,
+                       BenchResult* result);
+
+private:
+    const uint8_t *data_;
+    size_t data_size_;
+    uint8_t *in_stream_;
+    uint8_t *out_stream_;
+    // The compressed blocks, one after another, and their sizes.
+    std::vector<uint8_t> compressed_;
+    std::vector<size_t> compressed_block_sizes_;
+    uint8_t *restored_;
+    BlockCompressor block_comp_;
+    BlockDecompressor block_decomp_;
+
+    ZjumpErrorCode Compress(size_t block_size, size_t* compressed_size);
+
+    ZjumpErrorCode Decompress(size_t block_size);
+};
+
+// Prints results as a table, one row per configuration.
+void PrintBenchResults(FILE* file,
+                       const char* name,
+                       const std::vector<BenchResult>& results);
+
+// Prints results as a JSON object.
+void PrintBenchResultsJson(FILE* file,
+                           const char* name,
+                           const std::vector<BenchResult>& results);
+
+#endif // BENCH_MODE_H_
@@ -0,0 +1,209 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include "bench.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "../bwt.h"
+#include "../jump_sequence.h"
+#include "../mem.h"
+
+BenchInput::BenchInput(const std::string& input_name,
+                       const uint8_t* input_data,
+                       size_t input_size) :
+    name(input_name) {
+    data_size = input_size;
+    data = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+    std::memcpy(data, input_data, input_size);
+
+    bwt = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+    bwt_primary_index = 0;
+    bwt_num_entry_points = 0;
+
+    compressed = SecureAlloc<uint8_t>(kBlockMaxCompressedStreamSize);
+    compressed_size = 0;
+}
+
+BenchInput::~BenchInput() {
+    SecureFree<uint8_t>(data);
+    SecureFree<uint8_t>(bwt);
+    SecureFree<uint8_t>(compressed);
+}
+
+bool BenchInput::Prepare() {
+    uint8_t *scratch = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+    bool ok = true;
+
+    std::memcpy(bwt, data, data_size);
+    bwt_num_entry_points = kBlockDefaultBwtEntryPoints;
+
+    Bwt bwt_transform;
+    ok = ok && (bwt_transform.Transform(bwt, data_size, &bwt_primary_index,
+                                        bwt_entry_points, &bwt_num_entry_points) == ZJUMP_NO_ERROR);
+
+    std::memcpy(scratch, bwt, data_size);
+    Jst jst(scratch, data_size);
+    ok = ok && (jst.Transform(&jst_block) == ZJUMP_NO_ERROR);
+
+    std::memcpy(scratch, data, data_size);
+    compressor.Reset();
+    ok = ok && (compressor.Compress(scratch, data_size, compressed, &compressed_size) == ZJUMP_NO_ERROR);
+
+    SecureFree<uint8_t>(scratch);
+
+    return ok;
+}
+
+void SetBlockThroughput(benchmark::State& state, size_t size) {
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(size));
+}
+
+// Synthetic inputs ------------------------------------------------------------
+
+static uint32_t NextRandom(uint32_t* seed) {
+    *seed = *seed * 1103515245u + 12345u;
+    return *seed >> 16;
+}
+
+static void FillText(std::vector<uint8_t>* data) {
+    static const char *kWords[] = {
+        "the ", "of ", "and ", "to ", "in ", "is ", "that ", "for ", "it ",
+        "as ", "was ", "with ", "be ", "by ", "on ", "not ", "he ", "this ",
+        "are ", "or ", "his ", "from ", "at ", "which ", "but ", "have ",
+        "compression ", "block ", "sequence ", "jump ", "stream ", ".\n"
+    };
+    uint32_t seed = 1;
+
+    while(data->size() < kBlockMaxExpandedStreamSize) {
+        const char *word = kWords[NextRandom(&seed) % 32];
+        data->insert(data->end(), word, word + std::strlen(word));
+    }
+
+    data->resize(kBlockMaxExpandedStreamSize);
+}
+
+// Fixed-size records with increasing ids and a few changing fields, as found
+// in binary logs and tables.
+static void FillRecords(std::vector<uint8_t>* data) {
+    uint32_t seed = 2;
+
+    for(uint32_t id=0; data->size()<kBlockMaxExpandedStreamSize; ++id) {
+        const uint32_t value = NextRandom(&seed) % 1000;
+        const uint8_t record[16] = {
+            static_cast<uint8_t>(id), static_cast<uint8_t>(id >> 8),
+            static_cast<uint8_t>(id >> 16), static_cast<uint8_t>(id >> 24),
+            'R', 'E', 'C', ':',
+            static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8), 0, 0,
+            static_cast<uint8_t>(NextRandom(&seed) % 4), 0, 0, '\n'
+        };
+        data->insert(data->end(), record, record + sizeof(record));
+    }
+
+    data->resize(kBlockMaxExpandedStreamSize);
+}
+
+// Mostly zeros with 2% of random bytes.
+static void FillSparse(std::vector<uint8_t>* data) {
+    uint32_t seed = 3;
+
+    data->assign(kBlockMaxExpandedStreamSize, 0);
+
+    for(size_t i=0; i<data->size(); ++i) {
+        if(NextRandom(&seed) % 50 == 0) {
+            (*data)[i] = static_cast<uint8_t>(NextRandom(&seed));
+        }
+    }
+}
+
+// Incompressible data, on which Jst finds no jump sequence.
+static void FillRandom(std::vector<uint8_t>* data) {
+    uint32_t seed = 4;
+
+    data->resize(kBlockMaxExpandedStreamSize);
+
+    for(size_t i=0; i<data->size(); ++i) {
+        (*data)[i] = static_cast<uint8_t>(NextRandom(&seed));
+    }
+}
+
+static void FillZeros(std::vector<uint8_t>* data) {
+    data->assign(kBlockMaxExpandedStreamSize, 0);
+}
+
+// File inputs -----------------------------------------------------------------
+
+// Reads the first block of path.
+static bool ReadFileBlock(const char* path, std::vector<uint8_t>* data) {
+    FILE *file = fopen(path, "rb");
+    if(file == nullptr) {
+        return false;
+    }
+
+    data->resize(kBlockMaxExpandedStreamSize);
+    size_t size = fread(data->data(), 1, data->size(), file);
+    data->resize(size);
+
+    fclose(file);
+
+    return size > 0;
+}
+
+static std::string BaseName(const std::string& path) {
+    size_t pos = path.find_last_of('/');
+    return (pos == std::string::npos) ? path : path.substr(pos + 1);
+}
+
+// Usage: zjump_bench [benchmark options] [file...]
+//
+// Every stage runs over the synthetic inputs and the first block of every
+// given file.
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+
+    std::vector<BenchInputPtr> inputs;
+    std::vector<uint8_t> data;
+
+    FillText(&data);
+    inputs.push_back(BenchInputPtr(new BenchInput("text", data.data(), data.size())));
+    FillRecords(&data);
+    inputs.push_back(BenchInputPtr(new BenchInput("records", data.data(), data.size())));
+    FillSparse(&data);
+    inputs.push_back(BenchInputPtr(new BenchInput("sparse", data.data(), data.size())));
+    FillRandom(&data);
+    inputs.push_back(BenchInputPtr(new BenchInput("random", data.data(), data.size())));
+    FillZeros(&data);
+    inputs.push_back(BenchInputPtr(new BenchInput("zeros", data.data(), data.size())));
+
+    for(int i=1; i<argc; ++i) {
+        if(!ReadFileBlock(argv[i], &data)) {
+            fprintf(stderr, "zjump_bench: cannot read %s\n", argv[i]);
+            return 1;
+        }
+        inputs.push_back(BenchInputPtr(new BenchInput(BaseName(argv[i]), data.data(), data.size())));
+    }
+
+    for(size_t i=0; i<inputs.size(); ++i) {
+        if(!inputs[i]->Prepare()) {
+            fprintf(stderr, "zjump_bench: cannot compress input %s\n", inputs[i]->name.c_str());
+            return 1;
+        }
+
+        RegisterBwtBenchmarks(inputs[i]);
+        RegisterJstBenchmarks(inputs[i]);
+        RegisterRleBenchmarks(inputs[i]);
+        RegisterHuffmanBenchmarks(inputs[i]);
+        RegisterBlockBenchmarks(inputs[i]);
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    return 0;
+}
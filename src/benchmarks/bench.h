@@ -0,0 +1,73 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#ifndef BENCHMARKS_BENCH_H_
+#define BENCHMARKS_BENCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "benchmark/benchmark.h"
+
+#include "../block_compressor.h"
+#include "../constants.h"
+
+// One block of input data, together with the output of every compression
+// stage, so that each stage can be measured on its own.
+//
+// Buffers are allocated with the sizes used by the compressor and the
+// decompressor, since bit readers and writers may touch a few bytes past the
+// end of the data.
+struct BenchInput {
+    std::string name;
+    uint8_t *data;
+    size_t data_size;
+
+    // Bwt output
+    uint8_t *bwt;
+    uint32_t bwt_primary_index;
+    uint32_t bwt_entry_points[kBlockMaxBwtEntryPoints];
+    uint8_t bwt_num_entry_points;
+
+    // Jst output (before the symbol encoding and Rle1)
+    ZjumpBlock jst_block;
+
+    // BlockCompressor output
+    BlockCompressor compressor;
+    uint8_t *compressed;
+    size_t compressed_size;
+
+    BenchInput(const std::string& input_name,
+               const uint8_t* input_data,
+               size_t input_size);
+
+    ~BenchInput();
+
+    // Fills the output of every stage. Returns false if any of them fails.
+    bool Prepare();
+};
+
+typedef std::shared_ptr<BenchInput> BenchInputPtr;
+
+// Reports the throughput of state as size bytes per iteration: the bytes the
+// measured stage reads, e.g. the whole block for the BWT and the Jst, but only
+// the jseq stream for the Rle1 and Huffman stages.
+void SetBlockThroughput(benchmark::State& state, size_t size);
+
+// Every stage registers one benchmark per input, named "<stage>/<input>".
+void RegisterBwtBenchmarks(const BenchInputPtr& input);
+
+void RegisterJstBenchmarks(const BenchInputPtr& input);
+
+void RegisterRleBenchmarks(const BenchInputPtr& input);
+
+void RegisterHuffmanBenchmarks(const BenchInputPtr& input);
+
+void RegisterBlockBenchmarks(const BenchInputPtr& input);
+
+#endif // BENCHMARKS_BENCH_H_
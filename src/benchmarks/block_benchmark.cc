@@ -0,0 +1,62 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include "bench.h"
+#include "perf_counters.h"
+
+#include "../block_reader.h"
+#include "../block_writer.h"
+#include "../fse.h"
+#include "../huffman.h"
+#include "../mem.h"
+
+static void BM_BlockWriter(benchmark::State& state, BenchInputPtr input) {
+    uint8_t *out = SecureAlloc<uint8_t>(kBlockMaxCompressedStreamSize);
+    size_t out_size = 0;
+
+    StageCounters counters(state);
+    for(auto _ : state) {
+        BlockWriter writer(input->compressor.LastBlock());
+        benchmark::DoNotOptimize(writer.Write(kBlockMaxCompressedStreamSize, out, &out_size));
+    }
+
+    counters.Report();
+    SetBlockThroughput(state, input->data_size);
+
+    SecureFree<uint8_t>(out);
+}
+
+// The compressed block is the first one of its stream, so it carries its own
+// tables and every Read parses and builds them again.
+static void BM_BlockReader(benchmark::State& state, BenchInputPtr input) {
+    BlockHuffmanDecoder *huff_decoders[kBlockMaxHuffmanEncodings];
+    FseDecoder fse_decoder;
+    ZjumpBlock block;
+
+    for(uint8_t i=0; i<kBlockMaxHuffmanEncodings; ++i) {
+        huff_decoders[i] = new BlockHuffmanDecoder();
+    }
+
+    StageCounters counters(state);
+    for(auto _ : state) {
+        block.Clear();
+        BlockReader reader(input->compressed, input->compressed_size, huff_decoders, &fse_decoder);
+        benchmark::DoNotOptimize(reader.Read(&block));
+    }
+
+    counters.Report();
+    SetBlockThroughput(state, input->data_size);
+
+    for(uint8_t i=0; i<kBlockMaxHuffmanEncodings; ++i) {
+        DeleteObject<BlockHuffmanEncoding>(block.allocator, block.huff_encodings[i]);
+        delete huff_decoders[i];
+    }
+}
+
+void RegisterBlockBenchmarks(const BenchInputPtr& input) {
+    benchmark::RegisterBenchmark(("BlockWriter/" + input->name).c_str(), BM_BlockWriter, input);
+    benchmark::RegisterBenchmark(("BlockReader/" + input->name).c_str(), BM_BlockReader, input);
+}
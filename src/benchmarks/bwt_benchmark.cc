@@ -0,0 +1,85 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include <cstring>
+#include <divsufsort.h>
+
+#include "bench.h"
+#include "perf_counters.h"
+
+#include "../bwt.h"
+#include "../mem.h"
+
+static void BM_Divbwt(benchmark::State& state, BenchInputPtr input) {
+    uint8_t *stream = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+    int32_t *suffix_array = SecureAlloc<int32_t>(kBlockMaxExpandedStreamSize);
+
+    StageCounters counters(state);
+    for(auto _ : state) {
+        counters.Pause();
+        std::memcpy(stream, input->data, input->data_size);
+        counters.Resume();
+
+        benchmark::DoNotOptimize(divbwt(stream, stream, suffix_array, input->data_size));
+    }
+
+    counters.Report();
+    SetBlockThroughput(state, input->data_size);
+
+    SecureFree<uint8_t>(stream);
+    SecureFree<int32_t>(suffix_array);
+}
+
+static void BM_Bwt(benchmark::State& state, BenchInputPtr input) {
+    uint8_t *stream = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+    uint32_t primary_index = 0;
+    uint32_t entry_points[kBlockMaxBwtEntryPoints];
+    Bwt bwt;
+
+    StageCounters counters(state);
+    for(auto _ : state) {
+        counters.Pause();
+        std::memcpy(stream, input->data, input->data_size);
+        uint8_t num_entry_points = kBlockDefaultBwtEntryPoints;
+        counters.Resume();
+
+        benchmark::DoNotOptimize(bwt.Transform(stream, input->data_size, &primary_index,
+                                               entry_points, &num_entry_points));
+    }
+
+    counters.Report();
+    SetBlockThroughput(state, input->data_size);
+
+    SecureFree<uint8_t>(stream);
+}
+
+static void BM_InverseBwt(benchmark::State& state, BenchInputPtr input) {
+    uint8_t *stream = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+    InverseBwt inverse_bwt;
+
+    StageCounters counters(state);
+    for(auto _ : state) {
+        counters.Pause();
+        std::memcpy(stream, input->bwt, input->data_size);
+        counters.Resume();
+
+        benchmark::DoNotOptimize(inverse_bwt.Transform(stream, input->data_size,
+                                                       input->bwt_primary_index,
+                                                       input->bwt_entry_points,
+                                                       input->bwt_num_entry_points));
+    }
+
+    counters.Report();
+    SetBlockThroughput(state, input->data_size);
+
+    SecureFree<uint8_t>(stream);
+}
+
+void RegisterBwtBenchmarks(const BenchInputPtr& input) {
+    benchmark::RegisterBenchmark(("divbwt/" + input->name).c_str(), BM_Divbwt, input);
+    benchmark::RegisterBenchmark(("Bwt/" + input->name).c_str(), BM_Bwt, input);
+    benchmark::RegisterBenchmark(("InverseBwt/" + input->name).c_str(), BM_InverseBwt, input);
+}
@@ -0,0 +1,92 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include "bench.h"
+#include "perf_counters.h"
+
+#include "../bit_stream.h"
+#include "../huffman.h"
+#include "../mem.h"
+
+// Builds a single encoding from the frequencies of the whole jseq stream, as
+// the compressor does before trying several encodings.
+static void BM_HuffmanFrequencyBuilder(benchmark::State& state, BenchInputPtr input) {
+    const ZjumpBlock &block = input->compressor.LastBlock();
+    uint32_t freqs[kBlockMaxEncodingSymbols] = {0};
+
+    for(size_t i=0; i<block.jseq_stream_size; ++i) {
+        ++freqs[block.jseq_stream[i]];
+    }
+
+    BlockHuffmanFrequencyBuilder builder;
+    BlockHuffmanEncoding encoding;
+
+    StageCounters counters(state);
+    for(auto _ : state) {
+        builder.Reset();
+        for(uint16_t s=0; s<kBlockMaxEncodingSymbols; ++s) {
+            builder.SetSymbolFrequency(s, freqs[s]);
+        }
+        builder.Build(&encoding);
+        benchmark::ClobberMemory();
+    }
+
+    counters.Report();
+    // One frequency per symbol of the alphabet, whatever the size of the block
+    SetBlockThroughput(state, kBlockMaxEncodingSymbols);
+}
+
+// Decodes the whole jseq stream coded with a single encoding.
+static void BM_HuffmanDecoder(benchmark::State& state, BenchInputPtr input) {
+    const ZjumpBlock &block = input->compressor.LastBlock();
+    const size_t coded_size = block.jseq_stream_size * 2 + 8;
+    uint8_t *coded = SecureAlloc<uint8_t>(coded_size);
+    uint32_t freqs[kBlockMaxEncodingSymbols] = {0};
+
+    for(size_t i=0; i<block.jseq_stream_size; ++i) {
+        ++freqs[block.jseq_stream[i]];
+    }
+
+    BlockHuffmanFrequencyBuilder builder;
+    BlockHuffmanEncoding encoding;
+    BlockHuffmanDecoder decoder;
+
+    for(uint16_t s=0; s<kBlockMaxEncodingSymbols; ++s) {
+        builder.SetSymbolFrequency(s, freqs[s]);
+    }
+    builder.Build(&encoding);
+    decoder.Build(encoding);
+
+    BitStreamWriter writer(coded, coded_size);
+    const uint32_t *encoder_table = encoding.EncoderTable();
+    for(size_t i=0; i<block.jseq_stream_size; ++i) {
+        const uint32_t entry = encoder_table[block.jseq_stream[i]];
+        writer.Append(entry >> 8, entry & 0xff);
+    }
+
+    StageCounters counters(state);
+    for(auto _ : state) {
+        BitStreamReader reader(coded, coded_size);
+        uint16_t symbol = 0;
+
+        for(size_t i=0; i<block.jseq_stream_size; ++i) {
+            decoder.Decode(reader, &symbol);
+            benchmark::DoNotOptimize(symbol);
+        }
+    }
+
+    counters.Report();
+    SetBlockThroughput(state, block.jseq_stream_size);
+
+    SecureFree<uint8_t>(coded);
+}
+
+void RegisterHuffmanBenchmarks(const BenchInputPtr& input) {
+    benchmark::RegisterBenchmark(("HuffmanFrequencyBuilder/" + input->name).c_str(),
+                                 BM_HuffmanFrequencyBuilder, input);
+    benchmark::RegisterBenchmark(("HuffmanDecoder/" + input->name).c_str(),
+                                 BM_HuffmanDecoder, input);
+}
@@ -0,0 +1,55 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include <cstring>
+
+#include "bench.h"
+#include "perf_counters.h"
+
+#include "../jump_sequence.h"
+#include "../mem.h"
+
+static void BM_Jst(benchmark::State& state, BenchInputPtr input) {
+    uint8_t *stream = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+    ZjumpBlock block;
+
+    StageCounters counters(state);
+    for(auto _ : state) {
+        counters.Pause();
+        std::memcpy(stream, input->bwt, input->data_size);
+        block.Clear();
+        counters.Resume();
+
+        Jst jst(stream, input->data_size);
+        benchmark::DoNotOptimize(jst.Transform(&block));
+    }
+
+    counters.Report();
+    SetBlockThroughput(state, input->data_size);
+
+    SecureFree<uint8_t>(stream);
+}
+
+static void BM_InverseJst(benchmark::State& state, BenchInputPtr input) {
+    uint8_t *stream = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+    size_t stream_size = 0;
+
+    StageCounters counters(state);
+    for(auto _ : state) {
+        InverseJst inverse_jst(input->jst_block);
+        benchmark::DoNotOptimize(inverse_jst.Transform(stream, &stream_size));
+    }
+
+    counters.Report();
+    SetBlockThroughput(state, input->data_size);
+
+    SecureFree<uint8_t>(stream);
+}
+
+void RegisterJstBenchmarks(const BenchInputPtr& input) {
+    benchmark::RegisterBenchmark(("Jst/" + input->name).c_str(), BM_Jst, input);
+    benchmark::RegisterBenchmark(("InverseJst/" + input->name).c_str(), BM_InverseJst, input);
+}
@@ -0,0 +1,184 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include "perf_counters.h"
+
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const char *kPerfEventNames[kNumPerfEvents] = {
+    "cycles",
+    "instructions",
+    "branch-misses",
+    "L1d-misses",
+    "LLC-misses",
+    "dTLB-misses"
+};
+
+static uint64_t CacheConfig(uint64_t cache, uint64_t op, uint64_t result) {
+    return cache | (op << 8) | (result << 16);
+}
+
+static int OpenEvent(PerfEvent event) {
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    switch(event) {
+        case kPerfCycles:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case kPerfInstructions:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case kPerfBranchMisses:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case kPerfL1dMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = CacheConfig(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                                      PERF_COUNT_HW_CACHE_RESULT_MISS);
+            break;
+        case kPerfLlcMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = CacheConfig(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ,
+                                      PERF_COUNT_HW_CACHE_RESULT_MISS);
+            break;
+        case kPerfDtlbMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = CacheConfig(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+                                      PERF_COUNT_HW_CACHE_RESULT_MISS);
+            break;
+        default:
+            return -1;
+    }
+
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+PerfCounters::PerfCounters() {
+    for(int e=0; e<kNumPerfEvents; ++e) {
+        fds_[e] = OpenEvent(static_cast<PerfEvent>(e));
+        values_[e] = 0;
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for(int e=0; e<kNumPerfEvents; ++e) {
+        if(fds_[e] >= 0) {
+            close(fds_[e]);
+        }
+    }
+}
+
+bool PerfCounters::Available() const {
+    for(int e=0; e<kNumPerfEvents; ++e) {
+        if(fds_[e] >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PerfCounters::Has(PerfEvent event) const {
+    return fds_[event] >= 0;
+}
+
+void PerfCounters::Start() {
+    for(int e=0; e<kNumPerfEvents; ++e) {
+        if(fds_[e] >= 0) {
+            ioctl(fds_[e], PERF_EVENT_IOC_RESET, 0);
+        }
+        values_[e] = 0;
+    }
+
+    Enable(true);
+}
+
+void PerfCounters::Pause() {
+    Enable(false);
+}
+
+void PerfCounters::Resume() {
+    Enable(true);
+}
+
+void PerfCounters::Stop() {
+    Enable(false);
+
+    for(int e=0; e<kNumPerfEvents; ++e) {
+        // value, time enabled, time running
+        uint64_t data[3] = {0, 0, 0};
+
+        if((fds_[e] < 0) || (read(fds_[e], data, sizeof(data)) != sizeof(data))) {
+            values_[e] = 0;
+        } else if((data[2] == 0) || (data[2] >= data[1])) {
+            values_[e] = data[0];
+        } else {
+            values_[e] = static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+        }
+    }
+}
+
+uint64_t PerfCounters::Value(PerfEvent event) const {
+    return values_[event];
+}
+
+void PerfCounters::Enable(bool enable) {
+    const unsigned long request = enable ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE;
+
+    for(int e=0; e<kNumPerfEvents; ++e) {
+        if(fds_[e] >= 0) {
+            ioctl(fds_[e], request, 0);
+        }
+    }
+}
+
+StageCounters::StageCounters(benchmark::State& state) : state_(state) {
+    counters_.Start();
+}
+
+void StageCounters::Pause() {
+    state_.PauseTiming();
+    counters_.Pause();
+}
+
+void StageCounters::Resume() {
+    counters_.Resume();
+    state_.ResumeTiming();
+}
+
+void StageCounters::Report() {
+    counters_.Stop();
+
+    if(!counters_.Available()) {
+        return;
+    }
+
+    for(int e=0; e<kNumPerfEvents; ++e) {
+        if(counters_.Has(static_cast<PerfEvent>(e))) {
+            state_.counters[kPerfEventNames[e]] =
+                benchmark::Counter(static_cast<double>(counters_.Value(static_cast<PerfEvent>(e))),
+                                   benchmark::Counter::kAvgIterations);
+        }
+    }
+
+    if(counters_.Has(kPerfCycles) && counters_.Has(kPerfInstructions) &&
+       (counters_.Value(kPerfCycles) > 0)) {
+        state_.counters["IPC"] = static_cast<double>(counters_.Value(kPerfInstructions)) /
+                                 counters_.Value(kPerfCycles);
+    }
+}
@@ -0,0 +1,96 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#ifndef BENCHMARKS_PERF_COUNTERS_H_
+#define BENCHMARKS_PERF_COUNTERS_H_
+
+#include <cstdint>
+
+#include "benchmark/benchmark.h"
+
+typedef enum {
+    kPerfCycles,
+    kPerfInstructions,
+    kPerfBranchMisses,
+    kPerfL1dMisses,
+    kPerfLlcMisses,
+    kPerfDtlbMisses,
+    kNumPerfEvents
+} PerfEvent;
+
+// PerfCounters class
+//
+// Hardware counters of the calling thread, read through perf_event_open.
+// Events that the kernel or the CPU do not support (as in most containers
+// and virtual machines) are just left out, and Available() tells whether any
+// of them could be opened.
+//
+// Every event is opened on its own, so the kernel may multiplex them. The
+// values are scaled by the fraction of time they were actually counted.
+//
+// The counters are per thread (pid 0, without inherit): threads started by
+// the measured code, such as the OpenMP workers of ParallelBwtEngine, are not
+// counted, so the BWT benchmarks on several threads only cover the calling
+// one.
+class PerfCounters {
+public:
+    PerfCounters();
+
+    ~PerfCounters();
+
+    bool Available() const;
+
+    bool Has(PerfEvent event) const;
+
+    // Starts counting, from zero.
+    void Start();
+
+    void Pause();
+
+    void Resume();
+
+    // Stops counting and keeps the scaled value of every event for Value().
+    void Stop();
+
+    uint64_t Value(PerfEvent event) const;
+
+private:
+    int fds_[kNumPerfEvents];
+    uint64_t values_[kNumPerfEvents];
+
+    void Enable(bool enable);
+};
+
+// StageCounters class
+//
+// Measures the hardware counters of a benchmark loop and reports them, per
+// iteration, as counters of its state. The time spent between Pause and
+// Resume (the setup of an iteration) is left out, as with the timing itself.
+//
+//     StageCounters counters(state);
+//     for(auto _ : state) {
+//         counters.Pause();
+//         ...
+//         counters.Resume();
+//         ...
+//     }
+//     counters.Report();
+class StageCounters {
+public:
+    explicit StageCounters(benchmark::State& state);
+
+    void Pause();
+
+    void Resume();
+
+    void Report();
+
+private:
+    benchmark::State &state_;
+    PerfCounters counters_;
+};
+
+#endif // BENCHMARKS_PERF_COUNTERS_H_
@@ -0,0 +1,59 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include "bench.h"
+#include "perf_counters.h"
+
+#include "../mem.h"
+#include "../rle.h"
+
+// Rle1 runs over the jseq stream once its jumps are encoded as symbols, which
+// is what InverseRle1 restores from the compressed block.
+static void BM_Rle1(benchmark::State& state, BenchInputPtr input) {
+    const ZjumpBlock &block = input->compressor.LastBlock();
+    uint8_t *symbols = SecureAlloc<uint8_t>(kBlockMaxCompressedStreamSize);
+    uint8_t *out = SecureAlloc<uint8_t>(kBlockMaxCompressedStreamSize);
+    size_t symbols_size = 0;
+    size_t out_size = 0;
+
+    InverseRle1(block.jseq_stream, block.jseq_stream_size, symbols,
+                kBlockMaxCompressedStreamSize, &symbols_size);
+
+    StageCounters counters(state);
+    for(auto _ : state) {
+        Rle1(symbols, symbols_size, out, &out_size);
+        benchmark::DoNotOptimize(out_size);
+    }
+
+    counters.Report();
+    SetBlockThroughput(state, symbols_size);
+
+    SecureFree<uint8_t>(symbols);
+    SecureFree<uint8_t>(out);
+}
+
+static void BM_InverseRle1(benchmark::State& state, BenchInputPtr input) {
+    const ZjumpBlock &block = input->compressor.LastBlock();
+    uint8_t *out = SecureAlloc<uint8_t>(kBlockMaxCompressedStreamSize);
+    size_t out_size = 0;
+
+    StageCounters counters(state);
+    for(auto _ : state) {
+        InverseRle1(block.jseq_stream, block.jseq_stream_size, out,
+                    kBlockMaxCompressedStreamSize, &out_size);
+        benchmark::DoNotOptimize(out_size);
+    }
+
+    counters.Report();
+    SetBlockThroughput(state, block.jseq_stream_size);
+
+    SecureFree<uint8_t>(out);
+}
+
+void RegisterRleBenchmarks(const BenchInputPtr& input) {
+    benchmark::RegisterBenchmark(("Rle1/" + input->name).c_str(), BM_Rle1, input);
+    benchmark::RegisterBenchmark(("InverseRle1/" + input->name).c_str(), BM_InverseRle1, input);
+}
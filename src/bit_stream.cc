@@ -16,12 +16,13 @@ template<typename T>
 uint8_t ReadBits(uint8_t num_bits,
                  size_t pos,
                  T* bits,
-                 BitStream* bit_stream) {
+                 const uint8_t* bytes,
+                 size_t size) {
     const uint8_t max_num_bits = sizeof(T) * 8;
     assert(num_bits <= max_num_bits);
 
     uint64_t value = *bits;
-    uint8_t read = ReadBits(num_bits, pos, &value, bit_stream);
+    uint8_t read = ReadBits(num_bits, pos, &value, bytes, size);
 
     *bits = static_cast<T>(value);
 
@@ -32,16 +33,17 @@ template<>
 uint8_t ReadBits(uint8_t num_bits,
                  size_t pos,
                  uint64_t* bits,
-                 BitStream* bit_stream) {
+                 const uint8_t* bytes,
+                 size_t size) {
     assert(num_bits > 0);
     assert(num_bits <= kBitStreamMaxNumBitsToRead);
-    assert(pos < bit_stream->size);
+    assert(pos < size);
 
-    if((pos + num_bits) > bit_stream->size) {
-        num_bits = bit_stream->size - pos;
+    if((pos + num_bits) > size) {
+        num_bits = size - pos;
     }
 
-    uint64_t value = *((uint64_t *)(&bit_stream->bytes[pos >> 3]));
+    uint64_t value = *((const uint64_t *)(&bytes[pos >> 3]));
     uint64_t mask = (1ULL << num_bits) - 1ULL;
     uint8_t shift = pos % 8;
     *bits = (value >> shift) & mask;
@@ -91,11 +93,10 @@ BitStream BitStreamWriter::Get() const {
     return bit_stream_;
 }
 
-BitStreamReader::BitStreamReader(uint8_t* stream,
+BitStreamReader::BitStreamReader(const uint8_t* stream,
                                  size_t stream_size) {
-    bit_stream_.bytes = stream;
-    bit_stream_.allocated = stream_size;
-    bit_stream_.size = stream_size * 8;
+    bytes_ = stream;
+    size_ = stream_size * 8;
 
     next_pos_ = 0;
 }
@@ -103,25 +104,25 @@ BitStreamReader::BitStreamReader(uint8_t* stream,
 uint8_t BitStreamReader::Read(uint8_t num_bits,
                               size_t pos,
                               uint8_t* bits) {
-    return ReadBits<uint8_t>(num_bits, pos, bits, &bit_stream_);
+    return ReadBits<uint8_t>(num_bits, pos, bits, bytes_, size_);
 }
 
 uint8_t BitStreamReader::Read(uint8_t num_bits,
                               size_t pos,
                               uint16_t* bits) {
-    return ReadBits<uint16_t>(num_bits, pos, bits, &bit_stream_);
+    return ReadBits<uint16_t>(num_bits, pos, bits, bytes_, size_);
 }
 
 uint8_t BitStreamReader::Read(uint8_t num_bits,
                               size_t pos,
                               uint32_t* bits) {
-    return ReadBits<uint32_t>(num_bits, pos, bits, &bit_stream_);
+    return ReadBits<uint32_t>(num_bits, pos, bits, bytes_, size_);
 }
 
 uint8_t BitStreamReader::Read(uint8_t num_bits,
                               size_t pos,
                               uint64_t* bits) {
-    return ReadBits(num_bits, pos, bits, &bit_stream_);
+    return ReadBits(num_bits, pos, bits, bytes_, size_);
 }
 
 uint8_t BitStreamReader::ReadNext(uint8_t num_bits,
@@ -164,3 +165,10 @@ size_t BitStreamReader::NextPos() const {
     return next_pos_;
 }
 
+size_t BitStreamReader::Size() const {
+    return size_;
+}
+
+const uint8_t* BitStreamReader::Data() const {
+    return bytes_;
+}
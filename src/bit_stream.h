@@ -36,7 +36,7 @@ private:
 
 class BitStreamReader {
 public:
-    BitStreamReader(uint8_t* stream,
+    BitStreamReader(const uint8_t* stream,
                     size_t stream_size);
 
     uint8_t Read(uint8_t num_bits,
@@ -73,8 +73,16 @@ public:
 
     size_t NextPos() const;
 
+    // Number of bits in the stream.
+    size_t Size() const;
+
+    // Bytes of the stream, for decoders that extract the bits themselves.
+    const uint8_t* Data() const;
+
 private:
-    BitStream bit_stream_;
+    const uint8_t *bytes_;
+    // In bits
+    size_t size_;
     size_t next_pos_;
 };
 
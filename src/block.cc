@@ -6,27 +6,76 @@
 
 #include "block.h"
 
+#include <algorithm>
+
 #include "constants.h"
 #include "mem.h"
 
-ZjumpBlock::ZjumpBlock() {
-    jseq_stream = SecureAlloc<uint16_t>(kBlockMaxCompressedStreamSize); //TODO: review alloc size
-    jseq_literals = SecureAlloc<uint8_t>(kBlockMaxNumJumpSequences);
-    padding_literals = SecureAlloc<uint8_t>(kBlockMaxCompressedStreamSize);
-    huff_encoding = nullptr;
+ZjumpBlock::ZjumpBlock(const ZjumpAllocator* allocator) :
+    allocator(AllocatorOrDefault(allocator)) {
+    jseq_stream = nullptr;
+    jseq_stream_capacity = 0;
+    jseq_literals = nullptr;
+    jseq_literals_capacity = 0;
+    padding_literals = nullptr;
+    padding_literals_capacity = 0;
+    huff_selectors = nullptr;
+    huff_selectors_capacity = 0;
+    fse_encoder = nullptr;
+    num_huff_encodings = 0;
+    for(uint8_t i=0; i<kBlockMaxHuffmanEncodings; ++i) {
+        huff_encodings[i] = nullptr;
+    }
     Clear();
 }
 
 ZjumpBlock::~ZjumpBlock() {
-    SecureFree<uint16_t>(jseq_stream);
-    SecureFree<uint8_t>(jseq_literals);
-    SecureFree<uint8_t>(padding_literals);
+    Deallocate<uint8_t>(allocator, jseq_stream, jseq_stream_capacity);
+    Deallocate<uint8_t>(allocator, jseq_literals, jseq_literals_capacity);
+    Deallocate<uint8_t>(allocator, padding_literals, padding_literals_capacity);
+    Deallocate<uint8_t>(allocator, huff_selectors, huff_selectors_capacity);
 }
 
 void ZjumpBlock::Clear() {
+    bwt_num_entry_points = 0;
+    fse_coded = false;
+    huff_repeat = false;
+    num_huff_selectors = 0;
     num_jseqs = 0;
     jseq_stream_size = 0;
     jseq_literals_size = 0;
     padding_literals_size = 0;
 }
 
+bool ZjumpBlock::ReserveHuffmanSelectors(size_t size) {
+    return Grow<uint8_t>(allocator, &huff_selectors, &huff_selectors_capacity, 0, size);
+}
+
+bool ZjumpBlock::ReserveJSeqStream(size_t size) {
+    if(size > jseq_stream_capacity) {
+        size = std::max(size, std::min(2 * jseq_stream_capacity, kBlockMaxCompressedStreamSize));
+        return Grow<uint8_t>(allocator, &jseq_stream, &jseq_stream_capacity, jseq_stream_size, size);
+    }
+    return true;
+}
+
+bool ZjumpBlock::ReserveJSeqLiterals(size_t size) {
+    return Grow<uint8_t>(allocator, &jseq_literals, &jseq_literals_capacity, 0, size);
+}
+
+bool ZjumpBlock::ReservePaddingLiterals(size_t size) {
+    return Grow<uint8_t>(allocator, &padding_literals, &padding_literals_capacity, 0, size);
+}
+
+bool ZjumpBlock::ReserveMaxSizes() {
+    return ReserveJSeqStream(kBlockMaxCompressedStreamSize) && //TODO: review alloc size
+           ReserveJSeqLiterals(kBlockMaxNumJumpSequences) &&
+           ReservePaddingLiterals(kBlockMaxCompressedStreamSize) &&
+           ReserveHuffmanSelectors(kBlockMaxHuffmanSelectors);
+}
+
+size_t ZjumpBlock::MemoryFootprint() const {
+    return sizeof(*this) + huff_selectors_capacity + jseq_stream_capacity +
+           jseq_literals_capacity + padding_literals_capacity;
+}
+
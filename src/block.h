@@ -10,24 +10,63 @@
 #include <cstddef>
 #include <cstdint>
 
+#include "constants.h"
+#include "fse.h"
 #include "huffman.h"
+#include "mem.h"
 
 struct ZjumpBlock {
     uint32_t bwt_primary_index;
-    HuffmanEncoding *huff_encoding;
+    uint8_t bwt_num_entry_points;
+    uint32_t bwt_entry_points[kBlockMaxBwtEntryPoints];
+    bool fse_coded;
+    FseEncoder *fse_encoder;
+    uint8_t num_huff_encodings;
+    BlockHuffmanEncoding *huff_encodings[kBlockMaxHuffmanEncodings];
+    bool huff_repeat;
+    uint8_t *huff_selectors;
+    size_t num_huff_selectors;
+    size_t huff_selectors_capacity;
     uint16_t num_jseqs;
-    uint16_t *jseq_stream;
+    uint8_t *jseq_stream;
     size_t jseq_stream_size;
+    size_t jseq_stream_capacity;
     uint8_t *jseq_literals;
     size_t jseq_literals_size;
+    size_t jseq_literals_capacity;
     uint8_t *padding_literals;
     size_t padding_literals_size;
+    size_t padding_literals_capacity;
 
-    ZjumpBlock();
+    const ZjumpAllocator *allocator;
+
+    // The arrays start empty and the Reserve methods make them grow, either
+    // to the sizes of the blocks read into them or to the largest ones, with
+    // allocator (the default one when it is null).
+    explicit ZjumpBlock(const ZjumpAllocator* allocator = nullptr);
 
     ~ZjumpBlock();
 
     void Clear();
+
+    // Make room for size elements. They return false when the array cannot
+    // be allocated. The jseq stream keeps its first jseq_stream_size
+    // symbols, and grows at least twofold (up to its largest size) so that it
+    // can be filled a few symbols at a time.
+    bool ReserveHuffmanSelectors(size_t size);
+
+    bool ReserveJSeqStream(size_t size);
+
+    bool ReserveJSeqLiterals(size_t size);
+
+    bool ReservePaddingLiterals(size_t size);
+
+    // The largest sizes of every array, which Jst and BlockCompressor need.
+    bool ReserveMaxSizes();
+
+    // Bytes of the block and its arrays. The Huffman encodings belong to the
+    // owner of the block, and are not counted.
+    size_t MemoryFootprint() const;
 };
 
 #endif // BLOCK_H_
@@ -8,23 +8,94 @@
 
 #include <algorithm>
 #include <cassert>
-#include <divsufsort.h>
+#include <cmath>
 
 #include "block_writer.h"
+#include "histogram.h"
 #include "huffman.h"
 #include "jump_sequence.h"
 #include "mem.h"
 #include "rle.h"
 
-BlockCompressor::BlockCompressor() {
+// Lower bound, in bits, of the length of any prefix encoding of the symbols
+// counted in freqs.
+static size_t EntropyLength(const uint32_t* freqs,
+                            const size_t num_symbols) {
+    double length = 0.0;
+
+    for(uint16_t s=0; s<kBlockMaxEncodingSymbols; ++s) {
+        if(freqs[s] > 0) {
+            length += freqs[s] * std::log2(static_cast<double>(num_symbols) / freqs[s]);
+        }
+    }
+
+    return static_cast<size_t>(length);
+}
+
+// Number of bits of the Huffman encodings header.
+static size_t EncodingsHeaderLength(BlockHuffmanEncoding** encodings,
+                                    const uint8_t num_encodings) {
+    size_t length = kBlockNumHuffmanEncodingsFieldSize;
+
+    for(uint8_t i=0; i<num_encodings; ++i) {
+        BlockHuffmanWriter huff_writer(*encodings[i]);
+        length += huff_writer.Length();
+    }
+
+    return length;
+}
+
+// Number of Huffman encodings tried for a jseq stream of num_symbols symbols.
+static uint8_t NumHuffmanEncodings(const size_t num_symbols) {
+    if(num_symbols < 2 * kBlockHuffmanGroupSize) {
+        return 1;
+    } else if(num_symbols < 600) {
+        return 2;
+    } else if(num_symbols < 1200) {
+        return 3;
+    } else if(num_symbols < 2400) {
+        return 4;
+    } else if(num_symbols < 4800) {
+        return 5;
+    }
+
+    return kBlockMaxHuffmanEncodings;
+}
+
+BlockCompressor::BlockCompressor(const ZjumpAllocator* allocator) :
+    allocator_(AllocatorOrDefault(allocator)),
+    block_(allocator_),
+    bwt_(allocator_),
+    fse_encoder_(kBlockMaxCompressedStreamSize, allocator_) {
     source_stream_ = nullptr;
     source_stream_size_ = 0;
+    num_prev_huff_encodings_ = 0;
+
+    for(uint8_t i=0; i<=kBlockMaxHuffmanEncodings; ++i) {
+        huff_encodings_[i] = nullptr;
+    }
+
+    for(uint8_t i=0; i<kBlockMaxHuffmanEncodings; ++i) {
+        prev_huff_encodings_[i] = nullptr;
+    }
 }
 
 BlockCompressor::~BlockCompressor() {
-    if(block_.huff_encoding != nullptr) {
-        delete block_.huff_encoding;
+    for(uint8_t i=0; i<=kBlockMaxHuffmanEncodings; ++i) {
+        DeleteObject<BlockHuffmanEncoding>(allocator_, huff_encodings_[i]);
     }
+
+    for(uint8_t i=0; i<kBlockMaxHuffmanEncodings; ++i) {
+        DeleteObject<BlockHuffmanEncoding>(allocator_, prev_huff_encodings_[i]);
+    }
+}
+
+void BlockCompressor::Reset() {
+    num_prev_huff_encodings_ = 0;
+}
+
+void BlockCompressor::SetNumThreads(int num_threads) {
+    bwt_.SetNumThreads(num_threads);
 }
 
 ZjumpErrorCode BlockCompressor::Compress(uint8_t* in,
@@ -36,97 +107,367 @@ ZjumpErrorCode BlockCompressor::Compress(uint8_t* in,
     assert(in_size <= kBlockMaxExpandedStreamSize);
     assert(out != nullptr);
 
-    Init(in, in_size);
+    if(StageTimer::kEnabled) {
+        block_stats_.Clear();
+    }
+    StageTimer timer(&block_stats_);
+
+    ZjumpErrorCode result = Init(in, in_size);
+    if(result != ZJUMP_NO_ERROR) {
+        return result;
+    }
 
-    ZjumpErrorCode result = ApplyBwt();
+    result = ApplyBwt();
     if(result != ZJUMP_NO_ERROR) {
         return result;
     }
+    timer.Lap(kStatsStageBwt);
 
     Jst jst(source_stream_, source_stream_size_);
-    result = jst.Transform(&block_);
+    result = jst.Transform(&block_, StageTimer::kEnabled ? &block_stats_.jst : nullptr);
     if(result != ZJUMP_NO_ERROR) {
         return result;
     }
+    timer.Lap(kStatsStageJst);
 
     result = EncodeJSeqStream();
     if(result != ZJUMP_NO_ERROR) {
         return result;
     }
+    timer.Lap(kStatsStageJSeqCoding);
 
     Rle1(block_.jseq_stream, block_.jseq_stream_size,
          block_.jseq_stream, &block_.jseq_stream_size);
+    timer.Lap(kStatsStageRle);
 
     result = CreateEncodingTable();
     if(result != ZJUMP_NO_ERROR) {
         return result;
     }
+    timer.Lap(kStatsStageEntropyTables);
 
     BlockWriter block_writer(block_);
     result = block_writer.Write(kBlockMaxCompressedStreamSize, out, out_size);
     if(result != ZJUMP_NO_ERROR) {
         return result;
     }
+    timer.Lap(kStatsStageBitStream);
 
     return ZJUMP_NO_ERROR;
 }
 
-void BlockCompressor::Init(uint8_t* stream, size_t stream_size) {
+const ZjumpBlock& BlockCompressor::LastBlock() const {
+    return block_;
+}
+
+const BlockStats& BlockCompressor::LastBlockStats() const {
+    return block_stats_;
+}
+
+// The buffers are allocated by the first block, with their largest sizes.
+ZjumpErrorCode BlockCompressor::Init(uint8_t* stream, size_t stream_size) {
     source_stream_ = stream;
     source_stream_size_ = stream_size;
 
     block_.Clear();
 
-    if(block_.huff_encoding != nullptr) {
-        delete block_.huff_encoding;
+    // the encodings are owned by this object
+    block_.num_huff_encodings = 0;
+
+    for(uint8_t i=0; i<=kBlockMaxHuffmanEncodings; ++i) {
+        if(huff_encodings_[i] == nullptr) {
+            huff_encodings_[i] = NewObject<BlockHuffmanEncoding>(allocator_);
+            if(huff_encodings_[i] == nullptr) {
+                return ZJUMP_ERROR_MEMORY_ALLOC;
+            }
+        }
     }
-}
 
-ZjumpErrorCode BlockCompressor::ApplyBwt() {
-    int pidx = divbwt(source_stream_, source_stream_, nullptr, source_stream_size_);
-    if(pidx < 0) {
-        return ZJUMP_ERROR_BWT;
+    for(uint8_t i=0; i<kBlockMaxHuffmanEncodings; ++i) {
+        if(prev_huff_encodings_[i] == nullptr) {
+            prev_huff_encodings_[i] = NewObject<BlockHuffmanEncoding>(allocator_);
+            if(prev_huff_encodings_[i] == nullptr) {
+                return ZJUMP_ERROR_MEMORY_ALLOC;
+            }
+        }
     }
 
-    block_.bwt_primary_index = static_cast<uint32_t>(pidx);
+    if(!block_.ReserveMaxSizes()) {
+        return ZJUMP_ERROR_MEMORY_ALLOC;
+    }
 
     return ZJUMP_NO_ERROR;
 }
 
+ZjumpErrorCode BlockCompressor::ApplyBwt() {
+    block_.bwt_num_entry_points = kBlockDefaultBwtEntryPoints;
+
+    return bwt_.Transform(source_stream_, source_stream_size_,
+                          &block_.bwt_primary_index,
+                          block_.bwt_entry_points,
+                          &block_.bwt_num_entry_points);
+}
+
+// Every jump is turned into its symbol in place.
 ZjumpErrorCode BlockCompressor::EncodeJSeqStream() {
-    uint16_t *encoded = SecureAlloc<uint16_t>(kBlockMaxCompressedStreamSize);
-    size_t n = 0;
+    uint8_t *stream = block_.jseq_stream;
 
     for(size_t i=0; i<block_.jseq_stream_size; ++i) {
-        uint16_t jump = block_.jseq_stream[i];
+        const uint8_t jump = stream[i];
 
         if((jump >= kMinJumpSize) && (jump <= kMaxJumpSize)) {
-            encoded[n++] = kMinJumpSymbol + (jump - kMinJumpSize);
-        } else {
-            encoded[n++] = jump;
+            stream[i] = static_cast<uint8_t>(kMinJumpSymbol + (jump - kMinJumpSize));
         }
     }
 
-    SecureFree<uint16_t>(block_.jseq_stream);
-
-    block_.jseq_stream = encoded;
-    block_.jseq_stream_size = n;
-
     return ZJUMP_NO_ERROR;
 }
 
 ZjumpErrorCode BlockCompressor::CreateEncodingTable() {
-    HuffmanFrequencyBuilder builder(kBlockMaxEncodingSymbols, kBlockMaxEncodingBitLength);
+    CountSymbols(block_.jseq_stream, block_.jseq_stream_size, symbol_freqs_);
 
-    for(size_t i=0; i<block_.jseq_stream_size; ++i) {
-        builder.AddSymbolFrequency(block_.jseq_stream[i], 1);
+    // The symbols of the previous encodings keep a code, so that the new
+    // encodings can still be reused when the next blocks use again some rare
+    // symbols that this one does not.
+    for(uint16_t s=0; s<kBlockMaxEncodingSymbols; ++s) {
+        coded_symbols_[s] = (symbol_freqs_[s] > 0);
+        for(uint8_t i=0; i<num_prev_huff_encodings_; ++i) {
+            coded_symbols_[s] |= (prev_huff_encodings_[i]->GetEncodedSymbol(s) != nullptr);
+        }
+    }
+
+    uint8_t num_new_encodings = 0;
+    const size_t huff_length = ChooseEncodingTables(&num_new_encodings);
+
+    // A single FSE table wins on very skewed streams, where every Huffman code
+    // takes at least one bit. The Huffman encodings are left untouched, so a
+    // later block may still repeat them.
+    block_.fse_coded = false;
+    if(fse_encoder_.Build(symbol_freqs_, kBlockMaxEncodingSymbols)) {
+        const size_t fse_length = fse_encoder_.HeaderLength() +
+                                  fse_encoder_.Encode(block_.jseq_stream, block_.jseq_stream_size);
+        if(fse_length < huff_length) {
+            block_.fse_coded = true;
+            block_.fse_encoder = &fse_encoder_;
+            return ZJUMP_NO_ERROR;
+        }
     }
 
-    block_.huff_encoding = builder.Build();
-    if(block_.huff_encoding == nullptr) {
+    block_.huff_repeat = (num_new_encodings == 0);
+    if(!block_.huff_repeat) {
+        BlockHuffmanEncoding **new_encodings = (num_new_encodings == 1) ? huff_encodings_ : &huff_encodings_[1];
+        for(uint8_t i=0; i<num_new_encodings; ++i) {
+            std::swap(new_encodings[i], prev_huff_encodings_[i]);
+        }
+        num_prev_huff_encodings_ = num_new_encodings;
+    }
+
+    // prev_huff_encodings_ holds the encodings of the block from now on
+    for(uint8_t i=0; i<num_prev_huff_encodings_; ++i) {
+        block_.huff_encodings[i] = prev_huff_encodings_[i];
+    }
+    block_.num_huff_encodings = num_prev_huff_encodings_;
+
+    LoadBitLengths(prev_huff_encodings_, num_prev_huff_encodings_);
+    if(SelectEncodings(num_prev_huff_encodings_) == SIZE_MAX) {
         return ZJUMP_ERROR_HUFFMAN;
     }
 
     return ZJUMP_NO_ERROR;
 }
 
+// Decides whether the block is encoded with the encodings of the previous
+// block, in which case num_new_encodings is set to zero, or with the
+// num_new_encodings first encodings of huff_encodings_ (a single encoding) or
+// of &huff_encodings_[1] (several encodings). Returns the number of bits of
+// the chosen encodings header, selectors and coded stream.
+size_t BlockCompressor::ChooseEncodingTables(uint8_t* num_new_encodings) {
+    size_t prev_length = SIZE_MAX;
+
+    // When the previous encodings are already close to the entropy of the
+    // block, new encodings are not even built.
+    if(num_prev_huff_encodings_ > 0) {
+        LoadBitLengths(prev_huff_encodings_, num_prev_huff_encodings_);
+        prev_length = SelectEncodings(num_prev_huff_encodings_);
+
+        size_t min_length = EntropyLength(symbol_freqs_, block_.jseq_stream_size);
+        if( (prev_length != SIZE_MAX) &&
+            (prev_length <= min_length + kBlockHuffmanRepeatMaxExtraBits)) {
+            *num_new_encodings = 0;
+            return prev_length;
+        }
+    }
+
+    BuildEncodings(huff_encodings_, 1);
+    LoadBitLengths(huff_encodings_, 1);
+    size_t new_length = SelectEncodings(1) + EncodingsHeaderLength(huff_encodings_, 1);
+    *num_new_encodings = 1;
+
+    const uint8_t num_encodings = NumHuffmanEncodings(block_.jseq_stream_size);
+    if(num_encodings > 1) {
+        BuildEncodings(&huff_encodings_[1], num_encodings);
+        LoadBitLengths(&huff_encodings_[1], num_encodings);
+        size_t length = SelectEncodings(num_encodings) +
+                        EncodingsHeaderLength(&huff_encodings_[1], num_encodings);
+
+        if(length < new_length) {
+            new_length = length;
+            *num_new_encodings = num_encodings;
+        }
+    }
+
+    if( (prev_length != SIZE_MAX) &&
+        (prev_length <= new_length + kBlockHuffmanRepeatMaxExtraBits)) {
+        *num_new_encodings = 0;
+        return prev_length;
+    }
+
+    return new_length;
+}
+
+// Builds num_encodings encodings for the jseq stream. When there are several
+// of them, they start coding cheaply disjoint ranges of symbols with about the
+// same frequency, and then each one is rebuilt from the groups of symbols
+// that it codes best, kBlockHuffmanRefinementPasses times.
+void BlockCompressor::BuildEncodings(BlockHuffmanEncoding** encodings,
+                                     uint8_t num_encodings) {
+    if(num_encodings == 1) {
+        BuildEncoding(symbol_freqs_, encodings[0]);
+        return;
+    }
+
+    size_t remaining = block_.jseq_stream_size;
+    uint16_t s = 0;
+
+    for(uint8_t i=0; i<num_encodings; ++i) {
+        const size_t target = remaining / (num_encodings - i);
+        const uint16_t first = s;
+        size_t freq = 0;
+
+        while( (s < kBlockMaxEncodingSymbols) &&
+               ((freq < target) || (i == num_encodings - 1))) {
+            freq += symbol_freqs_[s++];
+        }
+
+        for(uint16_t k=0; k<kBlockMaxEncodingSymbols; ++k) {
+            if(!coded_symbols_[k]) {
+                bit_lengths_[i][k] = 0;
+            } else if((k >= first) && (k < s)) {
+                bit_lengths_[i][k] = 1;
+            } else {
+                bit_lengths_[i][k] = kBlockMaxEncodingBitLength;
+            }
+        }
+
+        remaining -= freq;
+    }
+
+    for(uint8_t pass=0; pass<kBlockHuffmanRefinementPasses; ++pass) {
+        SelectEncodings(num_encodings);
+
+        for(uint8_t i=0; i<num_encodings; ++i) {
+            BuildEncoding(encoding_freqs_[i], encodings[i]);
+        }
+
+        LoadBitLengths(encodings, num_encodings);
+    }
+}
+
+// Every symbol in coded_symbols_ gets a code, even if freqs does not count it.
+void BlockCompressor::BuildEncoding(const uint32_t* freqs,
+                                    BlockHuffmanEncoding* encoding) {
+    huff_builder_.Reset();
+
+    for(uint16_t s=0; s<kBlockMaxEncodingSymbols; ++s) {
+        uint32_t freq = freqs[s];
+        if((freq == 0) && coded_symbols_[s]) {
+            freq = 1;
+        }
+        huff_builder_.SetSymbolFrequency(s, freq);
+    }
+
+    huff_builder_.Build(encoding);
+}
+
+// Copies the code lengths of encodings into bit_lengths_, with 0 for the
+// symbols without a code.
+void BlockCompressor::LoadBitLengths(BlockHuffmanEncoding** encodings,
+                                     uint8_t num_encodings) {
+    for(uint8_t i=0; i<num_encodings; ++i) {
+        for(uint16_t s=0; s<kBlockMaxEncodingSymbols; ++s) {
+            const EncodedSymbol *enc = encodings[i]->GetEncodedSymbol(s);
+            bit_lengths_[i][s] = (enc != nullptr) ? enc->enc_bit_length : 0;
+        }
+    }
+}
+
+// Assigns to every group of the jseq stream the encoding, given by
+// bit_lengths_, that codes it with fewer bits, and counts the symbols coded by
+// each encoding in encoding_freqs_. Returns the number of bits of the coded
+// stream and its selectors, or SIZE_MAX if some group cannot be coded.
+size_t BlockCompressor::SelectEncodings(uint8_t num_encodings) {
+    // larger than any group coded with valid codes
+    const uint32_t kMissingSymbolLength = kBlockHuffmanGroupSize * kBlockMaxEncodingBitLength + 1;
+    const uint8_t *stream = block_.jseq_stream;
+    const size_t stream_size = block_.jseq_stream_size;
+    uint8_t mtf[kBlockMaxHuffmanEncodings];
+    size_t length = 0;
+
+    for(uint8_t i=0; i<num_encodings; ++i) {
+        mtf[i] = i;
+        std::fill_n(encoding_freqs_[i], kBlockMaxEncodingSymbols, 0);
+    }
+
+    block_.num_huff_selectors = 0;
+
+    for(size_t start=0; start<stream_size; start+=kBlockHuffmanGroupSize) {
+        const size_t end = std::min(start + kBlockHuffmanGroupSize, stream_size);
+        uint32_t group_length[kBlockMaxHuffmanEncodings] = {0};
+
+        for(size_t j=start; j<end; ++j) {
+            for(uint8_t i=0; i<num_encodings; ++i) {
+                const uint8_t bit_length = bit_lengths_[i][stream[j]];
+                group_length[i] += (bit_length > 0) ? bit_length : kMissingSymbolLength;
+            }
+        }
+
+        uint8_t best = 0;
+        for(uint8_t i=1; i<num_encodings; ++i) {
+            if(group_length[i] < group_length[best]) {
+                best = i;
+            }
+        }
+
+        if(group_length[best] >= kMissingSymbolLength) {
+            return SIZE_MAX;
+        }
+
+        length += group_length[best];
+
+        for(size_t j=start; j<end; ++j) {
+            ++encoding_freqs_[best][stream[j]];
+        }
+
+        if(num_encodings > 1) {
+            block_.huff_selectors[block_.num_huff_selectors++] = best;
+
+            // unary code of the position of the selector in the MTF list
+            uint8_t k = 0;
+            while(mtf[k] != best) {
+                ++k;
+            }
+            length += k + 1u;
+
+            for(; k>0; --k) {
+                mtf[k] = mtf[k - 1];
+            }
+            mtf[0] = best;
+        }
+    }
+
+    if(num_encodings > 1) {
+        length += kBlockNumHuffmanSelectorsFieldSize;
+    }
+
+    return length;
+}
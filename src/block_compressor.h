@@ -11,31 +11,82 @@
 #include <cstdint>
 
 #include "block.h"
+#include "bwt.h"
 #include "constants.h"
+#include "fse.h"
+#include "huffman.h"
+#include "stats.h"
 
+// BlockCompressor class
+//
+// Its memory is allocated with allocator (the default one when it is null),
+// by the first call to Compress, which fails with ZJUMP_ERROR_MEMORY_ALLOC
+// if it cannot be allocated.
 class BlockCompressor {
 public:
-    BlockCompressor();
+    explicit BlockCompressor(const ZjumpAllocator* allocator = nullptr);
 
     ~BlockCompressor();
 
+    // Forgets the state carried from one block to the next one. It must be
+    // called before compressing the first block of a stream.
+    void Reset();
+
+    // Sets the number of threads used to sort the suffixes of large blocks.
+    void SetNumThreads(int num_threads);
+
     ZjumpErrorCode Compress(uint8_t* in,
                             size_t in_size,
                             uint8_t* out,
                             size_t* out_size);
 
+    // The block built by the last call to Compress. Its encodings are owned
+    // by this object and stay valid until the next call.
+    const ZjumpBlock& LastBlock() const;
+
+    // Time spent on every stage by the last call to Compress. It is only
+    // measured in builds with ZJUMP_STATS.
+    const BlockStats& LastBlockStats() const;
+
 private:
+    const ZjumpAllocator *allocator_;
     uint8_t *source_stream_;
     size_t source_stream_size_;
     ZjumpBlock block_;
+    Bwt bwt_;
+    BlockHuffmanFrequencyBuilder huff_builder_;
+    // The first encoding is the candidate to code the whole block alone, and
+    // the following ones are the candidate set of several encodings.
+    BlockHuffmanEncoding *huff_encodings_[kBlockMaxHuffmanEncodings + 1];
+    BlockHuffmanEncoding *prev_huff_encodings_[kBlockMaxHuffmanEncodings];
+    uint8_t num_prev_huff_encodings_;
+    uint32_t symbol_freqs_[kBlockMaxEncodingSymbols];
+    bool coded_symbols_[kBlockMaxEncodingSymbols];
+    uint8_t bit_lengths_[kBlockMaxHuffmanEncodings][kBlockMaxEncodingSymbols];
+    uint32_t encoding_freqs_[kBlockMaxHuffmanEncodings][kBlockMaxEncodingSymbols];
+    FseEncoder fse_encoder_;
+    BlockStats block_stats_;
 
-    void Init(uint8_t *stream, size_t stream_size);
+    ZjumpErrorCode Init(uint8_t *stream, size_t stream_size);
 
     ZjumpErrorCode ApplyBwt();
 
     ZjumpErrorCode EncodeJSeqStream();
 
     ZjumpErrorCode CreateEncodingTable();
+
+    size_t ChooseEncodingTables(uint8_t* num_new_encodings);
+
+    void BuildEncodings(BlockHuffmanEncoding** encodings,
+                        uint8_t num_encodings);
+
+    void BuildEncoding(const uint32_t* freqs,
+                       BlockHuffmanEncoding* encoding);
+
+    void LoadBitLengths(BlockHuffmanEncoding** encodings,
+                        uint8_t num_encodings);
+
+    size_t SelectEncodings(uint8_t num_encodings);
 };
 
 #endif // BLOCK_COMPRESSOR_H_
@@ -6,101 +6,343 @@
 
 #include "block_decompressor.h"
 
+#include <algorithm>
 #include <cassert>
-#include <divsufsort.h>
 
+#include "block_index.h"
 #include "block_reader.h"
 #include "jump_sequence.h"
 #include "mem.h"
 #include "rle.h"
 
-BlockDecompressor::BlockDecompressor() {
+// DecoderScratch --------------------------------------------------------------
+
+DecoderScratch::DecoderScratch(const ZjumpAllocator* allocator) :
+    allocator(AllocatorOrDefault(allocator)),
+    block(this->allocator),
+    inverse_bwt(this->allocator) {
+    rle_stream = nullptr;
+    rle_stream_capacity = 0;
+    jst_workspace = nullptr;
+    jst_workspace_capacity = 0;
+    in_stream = nullptr;
+    in_stream_capacity = 0;
+    out_stream = nullptr;
+    out_stream_capacity = 0;
+}
+
+DecoderScratch::~DecoderScratch() {
+    for(uint8_t i=0; i<kBlockMaxHuffmanEncodings; ++i) {
+        DeleteObject<BlockHuffmanEncoding>(allocator, block.huff_encodings[i]);
+    }
+    Deallocate<uint8_t>(allocator, rle_stream, rle_stream_capacity);
+    Deallocate<uint8_t>(allocator, jst_workspace, jst_workspace_capacity);
+    Deallocate<uint8_t>(allocator, in_stream, in_stream_capacity);
+    Deallocate<uint8_t>(allocator, out_stream, out_stream_capacity);
+}
+
+DecoderScratch* DecoderScratch::ForThisThread() {
+    static thread_local DecoderScratch scratch;
+    return &scratch;
+}
+
+uint8_t* DecoderScratch::InStream(size_t size) {
+    if(!Grow<uint8_t>(allocator, &in_stream, &in_stream_capacity, 0, size + kBlockReadPaddingBytes)) {
+        return nullptr;
+    }
+    return in_stream;
+}
+
+uint8_t* DecoderScratch::OutStream(size_t size) {
+    if(!Grow<uint8_t>(allocator, &out_stream, &out_stream_capacity, 0, size)) {
+        return nullptr;
+    }
+    return out_stream;
+}
+
+size_t DecoderScratch::MemoryFootprint() const {
+    size_t size = sizeof(*this);
+
+    size += block.MemoryFootprint() - sizeof(block);
+    for(uint8_t i=0; i<kBlockMaxHuffmanEncodings; ++i) {
+        if(block.huff_encodings[i] != nullptr) {
+            size += sizeof(BlockHuffmanEncoding);
+        }
+    }
+
+    size += rle_stream_capacity + jst_workspace_capacity;
+    size += inverse_bwt.MemoryFootprint() - sizeof(inverse_bwt);
+    size += in_stream_capacity + out_stream_capacity;
+
+    return size;
+}
+
+// BlockDecompressor -----------------------------------------------------------
+
+BlockDecompressor::BlockDecompressor(const ZjumpAllocator* allocator) :
+    allocator_(AllocatorOrDefault(allocator)) {
+    scratch_ = nullptr;
+    own_scratch_ = false;
+    num_huff_encodings_ = 0;
+    for(uint8_t i=0; i<kBlockMaxHuffmanEncodings; ++i) {
+        huff_decoders_[i] = nullptr;
+    }
+}
+
+BlockDecompressor::BlockDecompressor(DecoderScratch* scratch) :
+    allocator_(scratch->allocator) {
+    scratch_ = scratch;
+    own_scratch_ = false;
+    num_huff_encodings_ = 0;
+    for(uint8_t i=0; i<kBlockMaxHuffmanEncodings; ++i) {
+        huff_decoders_[i] = nullptr;
+    }
 }
 
 BlockDecompressor::~BlockDecompressor() {
-    if(block_.huff_encoding != nullptr) {
-        delete block_.huff_encoding;
+    for(uint8_t i=0; i<kBlockMaxHuffmanEncodings; ++i) {
+        DeleteObject<BlockHuffmanDecoder>(allocator_, huff_decoders_[i]);
+    }
+
+    if(own_scratch_) {
+        DeleteObject<DecoderScratch>(allocator_, scratch_);
     }
 }
 
-ZjumpErrorCode BlockDecompressor::Decompress(uint8_t* in,
+void BlockDecompressor::Reset() {
+    num_huff_encodings_ = 0;
+}
+
+ZjumpErrorCode BlockDecompressor::Decompress(const uint8_t* in,
                                              size_t in_size,
                                              uint8_t* out,
                                              size_t* out_size) {
+    assert(out != nullptr);
+
+    return DecompressBlock(in, in_size, &out, out_size);
+}
+
+ZjumpErrorCode BlockDecompressor::Decompress(const uint8_t* in,
+                                             size_t in_size,
+                                             uint8_t** out,
+                                             size_t* out_size) {
+    assert(out != nullptr);
+
+    *out = nullptr;
+    return DecompressBlock(in, in_size, out, out_size);
+}
+
+ZjumpErrorCode BlockDecompressor::ReadHeader(const uint8_t* in, size_t in_size, ZjumpBlock* header) {
+    assert(in != nullptr);
+    assert(in_size > 0);
+    assert(header != nullptr);
+
+    header->Clear();
+
+    DecoderScratch *scratch = Scratch();
+    if(scratch == nullptr) {
+        return ZJUMP_ERROR_MEMORY_ALLOC;
+    }
+
+    BlockReader block_reader(in, in_size, huff_decoders_, &scratch->fse_decoder);
+    return block_reader.ReadHeader(header);
+}
+
+ZjumpErrorCode BlockDecompressor::LoadTables(const uint8_t* in, size_t in_size) {
     assert(in != nullptr);
     assert(in_size > 0);
     assert(in_size <= kBlockMaxCompressedStreamSize);
-    assert(out != nullptr);
 
-    Init();
+    DecoderScratch *scratch = Scratch();
+    if(scratch == nullptr) {
+        return ZJUMP_ERROR_MEMORY_ALLOC;
+    }
+
+    return ReadBlock(scratch, in, in_size, true);
+}
+
+const BlockStats& BlockDecompressor::LastBlockStats() const {
+    return block_stats_;
+}
+
+size_t BlockDecompressor::MemoryFootprint() const {
+    size_t size = sizeof(*this);
+
+    for(uint8_t i=0; i<kBlockMaxHuffmanEncodings; ++i) {
+        if(huff_decoders_[i] != nullptr) {
+            size += sizeof(BlockHuffmanDecoder);
+        }
+    }
+
+    if(own_scratch_) {
+        size += scratch_->MemoryFootprint();
+    }
+
+    return size;
+}
+
+// The scratch of every thread uses the default allocator, so an object with
+// any other allocator needs one of its own.
+DecoderScratch* BlockDecompressor::Scratch() {
+    if(scratch_ != nullptr) {
+        return scratch_;
+    }
+
+    if(allocator_ == DefaultAllocator()) {
+        return DecoderScratch::ForThisThread();
+    }
+
+    scratch_ = NewObject<DecoderScratch>(allocator_, allocator_);
+    own_scratch_ = (scratch_ != nullptr);
+
+    return scratch_;
+}
 
-    BlockReader block_reader(in, in_size);
-    ZjumpErrorCode ret_code = block_reader.Read(&block_);
+ZjumpErrorCode BlockDecompressor::DecompressBlock(const uint8_t* in,
+                                                  size_t in_size,
+                                                  uint8_t** out,
+                                                  size_t* out_size) {
+    assert(in != nullptr);
+    assert(in_size > 0);
+    assert(in_size <= kBlockMaxCompressedStreamSize);
+
+    if(StageTimer::kEnabled) {
+        block_stats_.Clear();
+    }
+    StageTimer timer(&block_stats_);
+
+    DecoderScratch *scratch = Scratch();
+    if(scratch == nullptr) {
+        return ZJUMP_ERROR_MEMORY_ALLOC;
+    }
+
+    ZjumpErrorCode ret_code = ReadBlock(scratch, in, in_size, false);
     if(ret_code != ZJUMP_NO_ERROR) {
         return ret_code;
     }
+    timer.Lap(kStatsStageBitStream);
 
-    ApplyInverseRle1();
+    ret_code = ApplyInverseRle1(scratch);
+    if(ret_code != ZJUMP_NO_ERROR) {
+        return ret_code;
+    }
+    timer.Lap(kStatsStageRle);
 
-    DecodeJSeqStream();
+    DecodeJSeqStream(&scratch->block);
+    timer.Lap(kStatsStageJSeqCoding);
 
-    InverseJst inv_jst(block_);
-    ret_code = inv_jst.Transform(out, out_size);
+    ret_code = ApplyInverseJst(scratch, out, out_size);
     if(ret_code != ZJUMP_NO_ERROR) {
         return ret_code;
     }
+    timer.Lap(kStatsStageJst);
 
-    ret_code = ApplyInverseBwt(out, *out_size);
+    ret_code = ApplyInverseBwt(scratch, *out, *out_size);
     if(ret_code != ZJUMP_NO_ERROR) {
         return ret_code;
     }
+    timer.Lap(kStatsStageBwt);
 
     return ZJUMP_NO_ERROR;
 }
 
-void BlockDecompressor::Init() {
-    block_.Clear();
+// The block of scratch is told how many Huffman encodings the stream has so
+// far, and the reader leaves there how many it has after this block. Their
+// tables are only needed to build the decoders, so they may be overwritten
+// by the blocks of other streams.
+ZjumpErrorCode BlockDecompressor::ReadBlock(DecoderScratch* scratch,
+                                            const uint8_t* in,
+                                            size_t in_size,
+                                            bool tables_only) {
+    ZjumpBlock &block = scratch->block;
 
-    if(block_.huff_encoding != nullptr) {
-        delete block_.huff_encoding;
-    }
+    block.Clear();
+    block.num_huff_encodings = num_huff_encodings_;
+
+    BlockReader block_reader(in, in_size, huff_decoders_, &scratch->fse_decoder);
+    ZjumpErrorCode ret_code = tables_only ? block_reader.ReadTables(&block) : block_reader.Read(&block);
+
+    num_huff_encodings_ = block.num_huff_encodings;
+
+    return ret_code;
 }
 
-void BlockDecompressor::ApplyInverseRle1() {
-    uint16_t *out = SecureAlloc<uint16_t>(kBlockMaxCompressedStreamSize);
+// The expanded stream takes the place of the jseq stream, whose buffer is
+// kept for the next block. The buffer of the expanded stream is only grown
+// when it does not fit, at least doubling it so that the slightly larger
+// streams of the next blocks fit as well.
+ZjumpErrorCode BlockDecompressor::ApplyInverseRle1(DecoderScratch* scratch) {
+    ZjumpBlock &block = scratch->block;
     size_t out_size = 0;
 
-    InverseRle1(block_.jseq_stream, block_.jseq_stream_size, out, &out_size);
+    if(!InverseRle1(block.jseq_stream, block.jseq_stream_size,
+                    scratch->rle_stream, scratch->rle_stream_capacity, &out_size)) {
+        out_size = InverseRle1Size(block.jseq_stream, block.jseq_stream_size);
+        if(out_size > kBlockMaxCompressedStreamSize) {
+            return ZJUMP_ERROR_RECONSTRUCTING_STREAM;
+        }
+
+        const size_t capacity = std::max(out_size,
+                std::min(2 * scratch->rle_stream_capacity, kBlockMaxCompressedStreamSize));
+        if(!Grow<uint8_t>(scratch->allocator, &scratch->rle_stream, &scratch->rle_stream_capacity, 0, capacity)) {
+            return ZJUMP_ERROR_MEMORY_ALLOC;
+        }
+        InverseRle1(block.jseq_stream, block.jseq_stream_size,
+                    scratch->rle_stream, scratch->rle_stream_capacity, &out_size);
+    }
 
-    SecureFree<uint16_t>(block_.jseq_stream);
+    std::swap(block.jseq_stream, scratch->rle_stream);
+    std::swap(block.jseq_stream_capacity, scratch->rle_stream_capacity);
+    block.jseq_stream_size = out_size;
 
-    block_.jseq_stream = out;
-    block_.jseq_stream_size = out_size;
+    return ZJUMP_NO_ERROR;
 }
 
-void BlockDecompressor::DecodeJSeqStream() {
+void BlockDecompressor::DecodeJSeqStream(ZjumpBlock* block) {
     size_t n = 0;
 
-    for(size_t i=0; i<block_.jseq_stream_size; ++i) {
-        uint16_t symbol = block_.jseq_stream[i];
+    for(size_t i=0; i<block->jseq_stream_size; ++i) {
+        const uint8_t symbol = block->jseq_stream[i];
 
         if((symbol >= kMinJumpSymbol) && (symbol <= kMaxJumpSymbol)) {
-            block_.jseq_stream[n++] = kMinJumpSize + (symbol - kMinJumpSymbol);
+            block->jseq_stream[n++] = static_cast<uint8_t>(kMinJumpSize + (symbol - kMinJumpSymbol));
         } else {
-            block_.jseq_stream[n++] = symbol;
+            block->jseq_stream[n++] = symbol;
         }
     }
 
-    block_.jseq_stream_size = n;
+    block->jseq_stream_size = n;
 }
 
-ZjumpErrorCode BlockDecompressor::ApplyInverseBwt(uint8_t* stream, size_t stream_size) {
-    int pidx = static_cast<int>(block_.bwt_primary_index);
+ZjumpErrorCode BlockDecompressor::ApplyInverseJst(DecoderScratch* scratch,
+                                                  uint8_t** stream,
+                                                  size_t* stream_size) {
+    InverseJst inv_jst(scratch->block);
+    const size_t size = std::max<size_t>(inv_jst.MaxOutputSize(), 1);
 
-    if(inverse_bw_transform(stream, stream, nullptr, stream_size, pidx) != 0) {
-        return ZJUMP_ERROR_BWT;
+    if(*stream == nullptr) {
+        *stream = scratch->OutStream(size);
+        if(*stream == nullptr) {
+            return ZJUMP_ERROR_MEMORY_ALLOC;
+        }
     }
 
-    return ZJUMP_NO_ERROR;
+    if(!Grow<uint8_t>(scratch->allocator, &scratch->jst_workspace, &scratch->jst_workspace_capacity, 0, size)) {
+        return ZJUMP_ERROR_MEMORY_ALLOC;
+    }
+
+    return inv_jst.Transform(*stream, stream_size,
+                             StageTimer::kEnabled ? &block_stats_.jst : nullptr,
+                             scratch->jst_workspace);
 }
 
+ZjumpErrorCode BlockDecompressor::ApplyInverseBwt(DecoderScratch* scratch,
+                                                  uint8_t* stream,
+                                                  size_t stream_size) {
+    const ZjumpBlock &block = scratch->block;
+
+    return scratch->inverse_bwt.Transform(stream, stream_size,
+                                          block.bwt_primary_index,
+                                          block.bwt_entry_points,
+                                          block.bwt_num_entry_points);
+}
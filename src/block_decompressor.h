@@ -11,29 +11,143 @@
 #include <cstdint>
 
 #include "block.h"
+#include "bwt.h"
 #include "constants.h"
+#include "fse.h"
+#include "huffman.h"
+#include "stats.h"
 
+// DecoderScratch struct
+//
+// Workspace that BlockDecompressor needs for a single block: the block as it
+// is read, with the Huffman encodings it carries, the FSE decoder, the output
+// of the inverse RLE and Jst and the LF table of the inverse BWT. Nothing in
+// it is carried from one block to the next, so a single one is shared by all
+// the streams a thread decompresses, however many of them are open (see
+// ForThisThread).
+//
+// Every buffer starts empty and grows, with allocator, to what the largest
+// block decompressed with it needs: up to about 1.9 MB for full-size blocks,
+// and a few KB for small streams. It also keeps the compressed and
+// decompressed block of callers that have no buffers of their own, such as
+// Decompressor.
+struct DecoderScratch {
+    const ZjumpAllocator *allocator;
+    ZjumpBlock block;
+    FseDecoder fse_decoder;
+    uint8_t *rle_stream;
+    size_t rle_stream_capacity;
+    uint8_t *jst_workspace;
+    size_t jst_workspace_capacity;
+    InverseBwt inverse_bwt;
+    uint8_t *in_stream;
+    size_t in_stream_capacity;
+    uint8_t *out_stream;
+    size_t out_stream_capacity;
+
+    // The default allocator is used when allocator is null.
+    explicit DecoderScratch(const ZjumpAllocator* allocator = nullptr);
+
+    ~DecoderScratch();
+
+    // Scratch of the calling thread, with the default allocator, created the
+    // first time it is asked for and freed when the thread exits.
+    static DecoderScratch* ForThisThread();
+
+    // Room for a compressed block of size bytes, followed by
+    // kBlockReadPaddingBytes so it can be decoded in place, and for a
+    // decompressed block of size bytes. They return nullptr when the buffer
+    // cannot grow.
+    uint8_t* InStream(size_t size);
+
+    uint8_t* OutStream(size_t size);
+
+    // Bytes of the scratch, its buffers and the Huffman encodings of block.
+    size_t MemoryFootprint() const;
+};
+
+// BlockDecompressor class
+//
+// Decompresses the blocks of a stream, one after another. Only what is
+// carried from one block to the next is kept by the object itself: the
+// Huffman decoders of the last block that carried encodings, allocated as
+// they are needed (less than 9 KB each, up to kBlockMaxHuffmanEncodings).
+// Everything else lives in a DecoderScratch.
+//
+// Allocation failures make the calls fail with ZJUMP_ERROR_MEMORY_ALLOC.
 class BlockDecompressor {
 public:
-    BlockDecompressor();
+    // Memory is allocated with allocator, or with the default one when it is
+    // null. With the default allocator, the scratch of the calling thread is
+    // used on every call. With any other, the object allocates a scratch of
+    // its own the first time it needs it.
+    explicit BlockDecompressor(const ZjumpAllocator* allocator = nullptr);
+
+    // scratch must outlive the object and be used by a single thread at a
+    // time. The Huffman decoders are allocated with its allocator.
+    explicit BlockDecompressor(DecoderScratch* scratch);
 
     ~BlockDecompressor();
 
-    ZjumpErrorCode Decompress(uint8_t* in,
+    // Forgets the state carried from one block to the next one. It must be
+    // called before decompressing the first block of a stream.
+    void Reset();
+
+    // out holds kBlockMaxExpandedStreamSize bytes.
+    ZjumpErrorCode Decompress(const uint8_t* in,
                               size_t in_size,
                               uint8_t* out,
                               size_t* out_size);
 
+    // Decompresses into the out stream of the scratch, which is only grown
+    // to the size of the block. *out points to it until the scratch is used
+    // again.
+    ZjumpErrorCode Decompress(const uint8_t* in,
+                              size_t in_size,
+                              uint8_t** out,
+                              size_t* out_size);
+
+    // Reads the BWT metadata and entropy coding flags of a block into
+    // header, which is cleared first. Huffman encodings are not read.
+    ZjumpErrorCode ReadHeader(const uint8_t* in, size_t in_size, ZjumpBlock* header);
+
+    // Loads the entropy tables of a block without decompressing it, so the
+    // blocks that repeat its Huffman encodings can be decompressed next.
+    ZjumpErrorCode LoadTables(const uint8_t* in, size_t in_size);
+
+    // Time spent on every stage by the last call to Decompress. It is only
+    // measured in builds with ZJUMP_STATS.
+    const BlockStats& LastBlockStats() const;
+
+    // Scratch used by the calling thread (see the constructors), or nullptr
+    // when it cannot be allocated.
+    DecoderScratch* Scratch();
+
+    // Bytes of the object and its Huffman decoders. The scratch is not
+    // counted unless it belongs to the object.
+    size_t MemoryFootprint() const;
+
 private:
-    ZjumpBlock block_;
+    const ZjumpAllocator *allocator_;
+    DecoderScratch *scratch_;
+    bool own_scratch_;
+    uint8_t num_huff_encodings_;
+    BlockHuffmanDecoder *huff_decoders_[kBlockMaxHuffmanEncodings];
+    BlockStats block_stats_;
+
+    // Decompresses into *out, or into the scratch when it is null.
+    ZjumpErrorCode DecompressBlock(const uint8_t* in, size_t in_size, uint8_t** out, size_t* out_size);
+
+    // Reads a block, or just its tables, into the block of scratch.
+    ZjumpErrorCode ReadBlock(DecoderScratch* scratch, const uint8_t* in, size_t in_size, bool tables_only);
 
-    void Init();
+    ZjumpErrorCode ApplyInverseRle1(DecoderScratch* scratch);
 
-    void ApplyInverseRle1();
+    void DecodeJSeqStream(ZjumpBlock* block);
 
-    void DecodeJSeqStream();
+    ZjumpErrorCode ApplyInverseJst(DecoderScratch* scratch, uint8_t** stream, size_t* stream_size);
 
-    ZjumpErrorCode ApplyInverseBwt(uint8_t* stream, size_t stream_size);
+    ZjumpErrorCode ApplyInverseBwt(DecoderScratch* scratch, uint8_t* stream, size_t stream_size);
 };
 
 #endif // BLOCK_DECOMPRESSOR_H_
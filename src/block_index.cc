@@ -0,0 +1,164 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include "block_index.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "block.h"
+
+BlockIndex::BlockIndex() {
+    data_ = nullptr;
+    size_ = 0;
+}
+
+ZjumpErrorCode BlockIndex::Build(const uint8_t* data, size_t size, BlockDecompressor* block_decomp) {
+    assert(data != nullptr);
+    assert(block_decomp != nullptr);
+
+    Clear();
+
+    uint16_t num_blocks = 0;
+    if(size < 2) {
+        return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
+    }
+
+    std::memcpy(&num_blocks, data, 2);
+    if(num_blocks == 0) {
+        return ZJUMP_ERROR_FORMAT_NUM_BLOCKS;
+    }
+
+    data_ = data;
+    size_ = size;
+    blocks_.reserve(num_blocks);
+
+    ZjumpBlock header;
+    size_t tables_block = kNoTablesBlock;
+    size_t pos = 2;
+
+    for(uint16_t i=0; i<num_blocks; ++i) {
+        uint32_t block_length_field = 0;
+
+        if(size_ - pos < 3) {
+            return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
+        }
+
+        std::memcpy(&block_length_field, data_ + pos, 3);
+        pos += 3;
+
+        if((block_length_field == 0) || (block_length_field > kBlockMaxCompressedStreamSize)) {
+            return ZJUMP_ERROR_FORMAT_BLOCK_LENGTH;
+        }
+
+        if(block_length_field > size_ - pos) {
+            return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
+        }
+
+        IndexedBlock block;
+        block.offset = pos;
+        block.size = block_length_field;
+        blocks_.push_back(block);
+        pos += block.size;
+
+        // Only the header is copied, with room for the bytes loaded past it
+        uint8_t copy[kBlockMaxHeaderBytes + kBlockReadPaddingBytes];
+        const size_t header_size = std::min(block.size, kBlockMaxHeaderBytes);
+        std::memcpy(copy, data_ + block.offset, header_size);
+
+        ZjumpErrorCode ret_code = block_decomp->ReadHeader(copy, header_size, &header);
+        if(ret_code != ZJUMP_NO_ERROR) {
+            return ret_code;
+        }
+
+        // FSE coded blocks leave the Huffman encodings as they are
+        if(header.huff_repeat) {
+            if(tables_block == kNoTablesBlock) {
+                return ZJUMP_ERROR_FORMAT_HUFFMAN_REPEAT;
+            }
+        } else if(!header.fse_coded) {
+            tables_block = i;
+        }
+
+        blocks_.back().huff_repeat = header.huff_repeat;
+        blocks_.back().tables_block = tables_block;
+    }
+
+    if(pos < size_) {
+        return ZJUMP_ERROR_FORMAT_STREAM_TOO_LARGE;
+    }
+
+    return ZJUMP_NO_ERROR;
+}
+
+void BlockIndex::Clear() {
+    data_ = nullptr;
+    size_ = 0;
+    blocks_.clear();
+}
+
+size_t BlockIndex::NumBlocks() const {
+    return blocks_.size();
+}
+
+const IndexedBlock& BlockIndex::Block(size_t index) const {
+    assert(index < blocks_.size());
+    return blocks_[index];
+}
+
+size_t BlockIndex::MemoryFootprint() const {
+    return sizeof(*this) + blocks_.capacity() * sizeof(IndexedBlock);
+}
+
+const uint8_t* BlockIndex::BlockData(size_t index, uint8_t* copy) const {
+    const IndexedBlock &block = Block(index);
+    const uint8_t *data = data_ + block.offset;
+
+    if(size_ - block.offset >= block.size + kBlockReadPaddingBytes) {
+        return data;
+    }
+
+    std::memcpy(copy, data, block.size);
+    return copy;
+}
+
+ZjumpErrorCode BlockIndex::DecompressBlock(size_t index,
+                                           BlockDecompressor* block_decomp,
+                                           size_t* loaded_tables,
+                                           uint8_t* copy,
+                                           uint8_t* out,
+                                           size_t* out_size) const {
+    const IndexedBlock &block = Block(index);
+
+    if(block.huff_repeat && (block.tables_block != *loaded_tables)) {
+        const IndexedBlock &tables = Block(block.tables_block);
+
+        ZjumpErrorCode ret_code = block_decomp->LoadTables(BlockData(block.tables_block, copy), tables.size);
+        if(ret_code != ZJUMP_NO_ERROR) {
+            return ret_code;
+        }
+
+        *loaded_tables = block.tables_block;
+    }
+
+    ZjumpErrorCode ret_code = block_decomp->Decompress(BlockData(index, copy), block.size, out, out_size);
+    if(ret_code != ZJUMP_NO_ERROR) {
+        *loaded_tables = kNoTablesBlock;
+        return ret_code;
+    }
+
+    if(block.tables_block == index) {
+        *loaded_tables = index;
+    }
+
+    const bool last_block = (index + 1 == blocks_.size());
+    if(!last_block && (*out_size != kBlockMaxExpandedStreamSize)) {
+        return ZJUMP_ERROR_FORMAT_BLOCK_LENGTH;
+    }
+
+    return ZJUMP_NO_ERROR;
+}
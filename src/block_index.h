@@ -0,0 +1,85 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#ifndef BLOCK_INDEX_H_
+#define BLOCK_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "block_decompressor.h"
+#include "constants.h"
+
+// Bit stream readers may load a few bytes past the end of a block, so a
+// block is only decoded in place when they can still be read.
+static const size_t kBlockReadPaddingBytes = 8;
+
+// Bytes of the largest header read by BlockDecompressor::ReadHeader.
+static const size_t kBlockMaxHeaderBytes =
+    (kBlockBwtPrimaryIndexFieldSize + kBlockBwtNumEntryPointsFieldSize +
+     kBlockMaxBwtEntryPoints * kBlockBwtEntryPointFieldSize +
+     kBlockFseFieldSize + kBlockHuffmanRepeatFieldSize + 7) / 8;
+
+// Value of IndexedBlock::tables_block when no block has carried Huffman
+// encodings yet.
+static const size_t kNoTablesBlock = static_cast<size_t>(-1);
+
+// A block of an indexed stream, and the last block before it that carried
+// Huffman encodings: the block itself, unless it repeats them or is FSE coded.
+struct IndexedBlock {
+    size_t offset;
+    size_t size;
+    bool huff_repeat;
+    size_t tables_block;
+};
+
+// BlockIndex class
+//
+// Position of every block of a stream held in memory (usually a mapped
+// file), so its blocks can be decompressed independently and in any order:
+// every block but the last one expands to kBlockMaxExpandedStreamSize bytes,
+// and the ones that repeat Huffman encodings know which block carries them.
+class BlockIndex {
+public:
+    BlockIndex();
+
+    // Indexes the stream in data, from its number of blocks field. Only the
+    // headers of the blocks are read, through block_decomp, whose Huffman
+    // encodings are left as they were.
+    ZjumpErrorCode Build(const uint8_t* data, size_t size, BlockDecompressor* block_decomp);
+
+    void Clear();
+
+    size_t NumBlocks() const;
+
+    const IndexedBlock& Block(size_t index) const;
+
+    // Bytes of the object and its entries.
+    size_t MemoryFootprint() const;
+
+    // Data of a block. Since bit stream readers may load a few bytes past
+    // its end, it is copied into copy (of kBlockMaxCompressedStreamSize
+    // bytes) when it is too close to the end of the stream.
+    const uint8_t* BlockData(size_t index, uint8_t* copy) const;
+
+    // Decompresses a block with block_decomp, which holds the Huffman
+    // encodings of loaded_tables (kNoTablesBlock at first). The encodings the
+    // block repeats are loaded first if needed, and loaded_tables updated.
+    ZjumpErrorCode DecompressBlock(size_t index,
+                                   BlockDecompressor* block_decomp,
+                                   size_t* loaded_tables,
+                                   uint8_t* copy,
+                                   uint8_t* out,
+                                   size_t* out_size) const;
+
+private:
+    const uint8_t *data_;
+    size_t size_;
+    std::vector<IndexedBlock> blocks_;
+};
+
+#endif // BLOCK_INDEX_H_
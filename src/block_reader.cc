@@ -6,16 +6,24 @@
 
 #include "block_reader.h"
 
+#include <algorithm>
 #include <cassert>
-#include <unordered_map>
 
-#include "huffman.h"
+#include "mem.h"
 
-BlockReader::BlockReader(uint8_t* stream, size_t stream_size) {
+BlockReader::BlockReader(const uint8_t* stream,
+                         size_t stream_size,
+                         BlockHuffmanDecoder** huff_decoders,
+                         FseDecoder* fse_decoder) {
     assert(stream != nullptr);
     assert(stream_size > 0);
+    assert(huff_decoders != nullptr);
+    assert(fse_decoder != nullptr);
     stream_ = stream;
     stream_size_ = stream_size;
+    block_ = nullptr;
+    huff_decoders_ = huff_decoders;
+    fse_decoder_ = fse_decoder;
 }
 
 ZjumpErrorCode BlockReader::Read(ZjumpBlock* block) {
@@ -28,7 +36,7 @@ ZjumpErrorCode BlockReader::Read(ZjumpBlock* block) {
         return code;
     }
 
-    code = ReadHuffmanTree(reader);
+    code = ReadEntropyTables(reader);
     if(code != ZJUMP_NO_ERROR) {
         return code;
     }
@@ -46,6 +54,53 @@ ZjumpErrorCode BlockReader::Read(ZjumpBlock* block) {
     return ZJUMP_NO_ERROR;
 }
 
+ZjumpErrorCode BlockReader::ReadHeader(ZjumpBlock* block) {
+    block_ = block;
+
+    BitStreamReader reader(stream_, stream_size_);
+
+    ZjumpErrorCode code = ReadBwtMetadata(reader);
+    if(code != ZJUMP_NO_ERROR) {
+        return code;
+    }
+
+    uint8_t fse_coded = 0;
+    uint8_t read = reader.ReadNext(kBlockFseFieldSize, &fse_coded);
+    if(read != kBlockFseFieldSize) {
+        return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
+    }
+
+    block_->fse_coded = (fse_coded != 0);
+    block_->huff_repeat = false;
+
+    if(block_->fse_coded) {
+        return ZJUMP_NO_ERROR;
+    }
+
+    uint8_t repeat = 0;
+    read = reader.ReadNext(kBlockHuffmanRepeatFieldSize, &repeat);
+    if(read != kBlockHuffmanRepeatFieldSize) {
+        return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
+    }
+
+    block_->huff_repeat = (repeat != 0);
+
+    return ZJUMP_NO_ERROR;
+}
+
+ZjumpErrorCode BlockReader::ReadTables(ZjumpBlock* block) {
+    block_ = block;
+
+    BitStreamReader reader(stream_, stream_size_);
+
+    ZjumpErrorCode code = ReadBwtMetadata(reader);
+    if(code != ZJUMP_NO_ERROR) {
+        return code;
+    }
+
+    return ReadEntropyTables(reader);
+}
+
 ZjumpErrorCode BlockReader::ReadBwtMetadata(BitStreamReader& reader) {
     uint8_t read = reader.ReadNext(kBlockBwtPrimaryIndexFieldSize, &(block_->bwt_primary_index));
     if(read != kBlockBwtPrimaryIndexFieldSize) {
@@ -56,25 +111,179 @@ ZjumpErrorCode BlockReader::ReadBwtMetadata(BitStreamReader& reader) {
         return ZJUMP_ERROR_FORMAT_BWT_PRIMARY_INDEX;
     }
 
+    read = reader.ReadNext(kBlockBwtNumEntryPointsFieldSize, &(block_->bwt_num_entry_points));
+    if(read != kBlockBwtNumEntryPointsFieldSize) {
+        return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
+    }
+
+    if(block_->bwt_num_entry_points > kBlockMaxBwtEntryPoints) {
+        return ZJUMP_ERROR_FORMAT_BWT_ENTRY_POINTS;
+    }
+
+    for(uint8_t i=0; i<block_->bwt_num_entry_points; ++i) {
+        read = reader.ReadNext(kBlockBwtEntryPointFieldSize, &(block_->bwt_entry_points[i]));
+        if(read != kBlockBwtEntryPointFieldSize) {
+            return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
+        }
+
+        if(block_->bwt_entry_points[i] > kBlockMaxExpandedStreamSize) {
+            return ZJUMP_ERROR_FORMAT_BWT_ENTRY_POINTS;
+        }
+    }
+
+    return ZJUMP_NO_ERROR;
+}
+
+ZjumpErrorCode BlockReader::ReadEntropyTables(BitStreamReader& reader) {
+    uint8_t fse_coded = 0;
+    uint8_t read = reader.ReadNext(kBlockFseFieldSize, &fse_coded);
+    if(read != kBlockFseFieldSize) {
+        return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
+    }
+
+    block_->fse_coded = (fse_coded != 0);
+
+    if(!block_->fse_coded) {
+        return ReadHuffmanTree(reader);
+    }
+
+    if(!fse_decoder_->ReadHeader(reader)) {
+        return ZJUMP_ERROR_FORMAT_FSE_TABLE;
+    }
+
     return ZJUMP_NO_ERROR;
 }
 
 ZjumpErrorCode BlockReader::ReadHuffmanTree(BitStreamReader& reader) {
-    HuffmanReader huff_reader(reader, kBlockMaxEncodingSymbols, kBlockMaxEncodingBitLength);
-    int ret_code = huff_reader.Read(&(block_->huff_encoding));
+    uint8_t repeat = 0;
+    uint8_t read = reader.ReadNext(kBlockHuffmanRepeatFieldSize, &repeat);
+    if(read != kBlockHuffmanRepeatFieldSize) {
+        return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
+    }
+
+    block_->huff_repeat = (repeat != 0);
 
-    switch(ret_code) {
-        case HuffmanReader::NO_ERROR:
+    // both the encodings and the decoders are kept from the previous block
+    if(block_->huff_repeat) {
+        if(block_->num_huff_encodings == 0) {
+            return ZJUMP_ERROR_FORMAT_HUFFMAN_REPEAT;
+        }
+        return ReadHuffmanSelectors(reader);
+    }
+
+    uint8_t num_encodings = 0;
+    read = reader.ReadNext(kBlockNumHuffmanEncodingsFieldSize, &num_encodings);
+    if(read != kBlockNumHuffmanEncodingsFieldSize) {
+        return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
+    }
+
+    ++num_encodings;
+    if(num_encodings > kBlockMaxHuffmanEncodings) {
+        return ZJUMP_ERROR_FORMAT_HUFFMAN_SELECTOR;
+    }
+
+    // the encodings of the previous block are not valid any more, but their
+    // storage is reused
+    block_->num_huff_encodings = 0;
+
+    for(uint8_t i=0; i<num_encodings; ++i) {
+        if(block_->huff_encodings[i] == nullptr) {
+            block_->huff_encodings[i] = NewObject<BlockHuffmanEncoding>(block_->allocator);
+            if(block_->huff_encodings[i] == nullptr) {
+                return ZJUMP_ERROR_MEMORY_ALLOC;
+            }
+        }
+
+        ZjumpErrorCode code = ReadHuffmanEncoding(reader, block_->huff_encodings[i]);
+        if(code != ZJUMP_NO_ERROR) {
+            return code;
+        }
+
+        ++block_->num_huff_encodings;
+
+        if(huff_decoders_[i] == nullptr) {
+            huff_decoders_[i] = NewObject<BlockHuffmanDecoder>(block_->allocator);
+            if(huff_decoders_[i] == nullptr) {
+                return ZJUMP_ERROR_MEMORY_ALLOC;
+            }
+        }
+        huff_decoders_[i]->Build(*block_->huff_encodings[i]);
+    }
+
+    return ReadHuffmanSelectors(reader);
+}
+
+ZjumpErrorCode BlockReader::ReadHuffmanEncoding(BitStreamReader& reader,
+                                                BlockHuffmanEncoding* encoding) {
+    BlockHuffmanReader huff_reader(reader);
+
+    switch(huff_reader.Read(encoding)) {
+        case BlockHuffmanReader::NO_ERROR:
             return ZJUMP_NO_ERROR;
-        case HuffmanReader::ERROR_BIT_STREAM:
+        case BlockHuffmanReader::ERROR_BIT_STREAM:
             return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
-        case HuffmanReader::ERROR_HUFFMAN:
+        case BlockHuffmanReader::ERROR_HUFFMAN:
             return ZJUMP_ERROR_HUFFMAN;
         default:
             return ZJUMP_ERROR_UNEXPECTED;
     }
 }
 
+ZjumpErrorCode BlockReader::ReadHuffmanSelectors(BitStreamReader& reader) {
+    block_->num_huff_selectors = 0;
+
+    if(block_->num_huff_encodings == 1) {
+        return ZJUMP_NO_ERROR;
+    }
+
+    uint8_t read = reader.ReadNext(kBlockNumHuffmanSelectorsFieldSize, &(block_->num_huff_selectors));
+    if(read != kBlockNumHuffmanSelectorsFieldSize) {
+        return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
+    }
+
+    if(block_->num_huff_selectors > kBlockMaxHuffmanSelectors) {
+        return ZJUMP_ERROR_FORMAT_HUFFMAN_SELECTOR;
+    }
+
+    if(!block_->ReserveHuffmanSelectors(block_->num_huff_selectors)) {
+        return ZJUMP_ERROR_MEMORY_ALLOC;
+    }
+
+    uint8_t mtf[kBlockMaxHuffmanEncodings];
+    for(uint8_t i=0; i<kBlockMaxHuffmanEncodings; ++i) {
+        mtf[i] = i;
+    }
+
+    for(size_t i=0; i<block_->num_huff_selectors; ++i) {
+        uint8_t j = 0;
+        uint8_t bit = 1;
+
+        while(true) {
+            if(reader.ReadNext(1, &bit) != 1) {
+                return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
+            }
+
+            if(bit == 0) {
+                break;
+            }
+
+            if(++j >= block_->num_huff_encodings) {
+                return ZJUMP_ERROR_FORMAT_HUFFMAN_SELECTOR;
+            }
+        }
+
+        const uint8_t selector = mtf[j];
+        for(uint8_t k=j; k>0; --k) {
+            mtf[k] = mtf[k - 1];
+        }
+        mtf[0] = selector;
+
+        block_->huff_selectors[i] = selector;
+    }
+
+    return ZJUMP_NO_ERROR;
+}
+
 ZjumpErrorCode BlockReader::ReadLiterals(BitStreamReader& reader) {
     uint8_t read = reader.ReadNext(kBlockNumLiteralsFieldSize, &(block_->padding_literals_size));
     if(read != kBlockNumLiteralsFieldSize) {
@@ -85,6 +294,10 @@ ZjumpErrorCode BlockReader::ReadLiterals(BitStreamReader& reader) {
         return ZJUMP_ERROR_FORMAT_LITERALS_LENGTH;
     }
 
+    if(!block_->ReservePaddingLiterals(block_->padding_literals_size)) {
+        return ZJUMP_ERROR_MEMORY_ALLOC;
+    }
+
     for(size_t i=0; i<block_->padding_literals_size; ++i) {
         if(reader.ReadNext(8, &(block_->padding_literals[i])) != 8) {
             return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
@@ -118,6 +331,10 @@ ZjumpErrorCode BlockReader::ReadJumpSequences(BitStreamReader& reader) {
 }
 
 ZjumpErrorCode BlockReader::ReadJSeqLiterals(BitStreamReader& reader) {
+    if(!block_->ReserveJSeqLiterals(block_->num_jseqs)) {
+        return ZJUMP_ERROR_MEMORY_ALLOC;
+    }
+
     for(size_t i=0; i<block_->num_jseqs; ++i) {
         if(reader.ReadNext(8, &(block_->jseq_literals[i])) != 8) {
             return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
@@ -129,63 +346,78 @@ ZjumpErrorCode BlockReader::ReadJSeqLiterals(BitStreamReader& reader) {
     return ZJUMP_NO_ERROR;
 }
 
-static ZjumpErrorCode ReadEncodedSymbol(
-        BitStreamReader& reader,
-        std::unordered_map<uint32_t, uint16_t>& encoded_to_symbol_map,
-        uint16_t* symbol) {
-    uint8_t enc_bit_length = 0;
-    uint16_t enc_value = 0;
-    std::unordered_map<uint32_t, uint16_t>::iterator it;
+ZjumpErrorCode BlockReader::ReadJSeqStream(BitStreamReader& reader) {
+    if(block_->fse_coded) {
+        return ReadFseJSeqStream(reader);
+    }
 
-    while(enc_bit_length < kBlockMaxEncodingBitLength) {
-        uint8_t bit;
+    const bool use_selectors = (block_->num_huff_encodings > 1);
+    size_t remaining_jseqs = block_->num_jseqs;
 
-        if(reader.ReadNext(1, &bit) != 1) {
-            return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
+    block_->jseq_stream_size = 0;
+
+    // A group of symbols at a time, all with the same decoder. The last
+    // group may be decoded past the end of the last sequence, which is fine
+    // since nothing else is read after the stream.
+    while(remaining_jseqs > 0) {
+        const size_t start = block_->jseq_stream_size;
+        if(start >= kBlockMaxCompressedStreamSize) {
+            return ZJUMP_ERROR_FORMAT_HUFFMAN_ENCODED_SYMBOL;
         }
 
-        enc_value = (enc_value << 1) | bit;
-        ++enc_bit_length;
+        const BlockHuffmanDecoder *decoder = huff_decoders_[0];
+        if(use_selectors) {
+            const size_t group = start / kBlockHuffmanGroupSize;
+            if(group >= block_->num_huff_selectors) {
+                return ZJUMP_ERROR_FORMAT_HUFFMAN_SELECTOR;
+            }
+            decoder = huff_decoders_[block_->huff_selectors[group]];
+        }
 
-        uint32_t k = enc_bit_length | (enc_value << 8);
-        it = encoded_to_symbol_map.find(k);
-        if(it != encoded_to_symbol_map.end()) {
-            *symbol = it->second;
-            break;
+        const size_t num_symbols = std::min(kBlockHuffmanGroupSize - (start % kBlockHuffmanGroupSize),
+                                            kBlockMaxCompressedStreamSize - start);
+        if(!block_->ReserveJSeqStream(start + num_symbols)) {
+            return ZJUMP_ERROR_MEMORY_ALLOC;
         }
-    }
+        const size_t decoded = decoder->DecodeSymbols(reader, num_symbols, block_->jseq_stream + start);
 
-    if(enc_bit_length > kBlockMaxEncodingBitLength) {
-        return ZJUMP_ERROR_FORMAT_HUFFMAN_ENCODED_SYMBOL;
+        for(size_t i=start; (i < start + decoded) && (remaining_jseqs > 0); ++i) {
+            ++block_->jseq_stream_size;
+            if(block_->jseq_stream[i] == kEndOfSequenceSymbol) {
+                --remaining_jseqs;
+            }
+        }
+
+        if((remaining_jseqs > 0) && (decoded < num_symbols)) {
+            return ZJUMP_ERROR_FORMAT_HUFFMAN_ENCODED_SYMBOL;
+        }
     }
 
     return ZJUMP_NO_ERROR;
 }
 
-ZjumpErrorCode BlockReader::ReadJSeqStream(BitStreamReader& reader) {
-    // key: enc_bit_length | (enc_value << 8)
-    // value: <symbol>
-    std::unordered_map<uint32_t, uint16_t> encoded_to_symbol_map;
-    const HuffmanEncoding *encoding = block_->huff_encoding;
-    const uint16_t max_symbols = encoding->MaxSymbols();
-
-    for(uint16_t s=0; s<max_symbols; ++s) {
-        const EncodedSymbol *enc = encoding->GetEncodedSymbol(s);
-        if(enc != nullptr) {
-            uint32_t k = enc->enc_bit_length | (enc->enc_value << 8);
-            encoded_to_symbol_map[k] = s;
-        }
-    }
-
+ZjumpErrorCode BlockReader::ReadFseJSeqStream(BitStreamReader& reader) {
     block_->jseq_stream_size = 0;
 
+    if(!fse_decoder_->Start(reader)) {
+        return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
+    }
+
     for(size_t i=0; i<block_->num_jseqs; ++i) {
-        uint16_t symbol=0;
+        uint8_t symbol=0;
 
         do {
-            ZjumpErrorCode code = ReadEncodedSymbol(reader, encoded_to_symbol_map, &symbol);
-            if(code != ZJUMP_NO_ERROR) {
-                return code;
+            if(block_->jseq_stream_size >= kBlockMaxCompressedStreamSize) {
+                return ZJUMP_ERROR_FORMAT_HUFFMAN_ENCODED_SYMBOL;
+            }
+
+            if( (block_->jseq_stream_size == block_->jseq_stream_capacity) &&
+                !block_->ReserveJSeqStream(block_->jseq_stream_size + 1)) {
+                return ZJUMP_ERROR_MEMORY_ALLOC;
+            }
+
+            if(!fse_decoder_->Decode(reader, &symbol)) {
+                return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
             }
 
             block_->jseq_stream[block_->jseq_stream_size++] = symbol;
@@ -195,4 +427,3 @@ ZjumpErrorCode BlockReader::ReadJSeqStream(BitStreamReader& reader) {
 
     return ZJUMP_NO_ERROR;
 }
-
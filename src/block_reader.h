@@ -13,22 +13,54 @@
 #include "bit_stream.h"
 #include "block.h"
 #include "constants.h"
+#include "fse.h"
+#include "huffman.h"
 
 class BlockReader {
 public:
-    BlockReader(uint8_t* stream, size_t stream_size);
+    // fse_decoder is rebuilt for every FSE coded block.
+    // huff_decoders holds kBlockMaxHuffmanEncodings decoders, built for the
+    // Huffman encodings of the previous block, if any. They are rebuilt when
+    // the block carries new encodings, and allocated the first time they are
+    // needed (they are null until then), with the allocator of the block
+    // they are read with. They are freed by their owner.
+    BlockReader(const uint8_t* stream,
+                size_t stream_size,
+                BlockHuffmanDecoder** huff_decoders,
+                FseDecoder* fse_decoder);
 
+    // The Huffman encodings of block are allocated the first time they are
+    // needed, and reused by the next blocks read into it. They are freed by
+    // the owner of block. The arrays of block are made to grow as needed.
+    // Allocation failures return ZJUMP_ERROR_MEMORY_ALLOC.
     ZjumpErrorCode Read(ZjumpBlock* block);
 
+    // Reads the BWT metadata and the entropy coding flags only (fse_coded and
+    // huff_repeat), without building any table.
+    ZjumpErrorCode ReadHeader(ZjumpBlock* block);
+
+    // Reads the BWT metadata and the entropy tables, leaving the decoders
+    // as if the whole block had been read.
+    ZjumpErrorCode ReadTables(ZjumpBlock* block);
+
 private:
-    uint8_t *stream_;
+    const uint8_t *stream_;
     size_t stream_size_;
     ZjumpBlock *block_;
+    BlockHuffmanDecoder **huff_decoders_;
+    FseDecoder *fse_decoder_;
 
     ZjumpErrorCode ReadBwtMetadata(BitStreamReader& reader);
 
+    ZjumpErrorCode ReadEntropyTables(BitStreamReader& reader);
+
     ZjumpErrorCode ReadHuffmanTree(BitStreamReader& reader);
 
+    ZjumpErrorCode ReadHuffmanEncoding(BitStreamReader& reader,
+                                       BlockHuffmanEncoding* encoding);
+
+    ZjumpErrorCode ReadHuffmanSelectors(BitStreamReader& reader);
+
     ZjumpErrorCode ReadLiterals(BitStreamReader& reader);
 
     ZjumpErrorCode ReadJumpSequences(BitStreamReader& reader);
@@ -36,6 +68,8 @@ private:
     ZjumpErrorCode ReadJSeqLiterals(BitStreamReader& reader);
 
     ZjumpErrorCode ReadJSeqStream(BitStreamReader& reader);
+
+    ZjumpErrorCode ReadFseJSeqStream(BitStreamReader& reader);
 };
 
 #endif // BLOCK_READER_H_
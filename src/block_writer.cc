@@ -11,19 +11,9 @@
 
 using namespace std;
 
-// TODO: Improve function. See here: http://graphics.stanford.edu/~seander/bithacks.html
-static void ReverseBits(const uint16_t bits,
-                        const uint8_t num_bits,
-                        uint16_t* reversed_bits) {
-    uint16_t p = bits;
-    uint16_t q = 0;
-    for(uint8_t i=0; i<num_bits; ++i) {
-        q <<= 1;
-        q |= (p & 1);
-        p >>= 1;
-    }
-    *reversed_bits = q;
-}
+// Codes are packed in a 64-bit accumulator, which is flushed when it may not
+// have room for one more code.
+static const uint8_t kBlockWriterMaxPackedBits = 56 - kHuffmanMaxSupportedBitLength;
 
 BlockWriter::BlockWriter(const ZjumpBlock& block) : block_(block) {
 }
@@ -40,7 +30,7 @@ ZjumpErrorCode BlockWriter::Write(const size_t allocated_size,
         return code;
     }
 
-    code = WriteHuffmanTree(&writer);
+    code = WriteEntropyTables(&writer);
     if(code != ZJUMP_NO_ERROR) {
         return code;
     }
@@ -67,18 +57,103 @@ ZjumpErrorCode BlockWriter::WriteBwtMetadata(BitStreamWriter* writer) {
         return ZJUMP_ERROR_BIT_WRITER;
     }
 
+    written = writer->Append(block_.bwt_num_entry_points, kBlockBwtNumEntryPointsFieldSize);
+    if(written != kBlockBwtNumEntryPointsFieldSize) {
+        return ZJUMP_ERROR_BIT_WRITER;
+    }
+
+    for(uint8_t i=0; i<block_.bwt_num_entry_points; ++i) {
+        written = writer->Append(block_.bwt_entry_points[i], kBlockBwtEntryPointFieldSize);
+        if(written != kBlockBwtEntryPointFieldSize) {
+            return ZJUMP_ERROR_BIT_WRITER;
+        }
+    }
+
     return ZJUMP_NO_ERROR;
 }
 
-ZjumpErrorCode BlockWriter::WriteHuffmanTree(BitStreamWriter* writer) {
-    HuffmanWriter huff_writer(*block_.huff_encoding);
-    if(huff_writer.Write(writer)) {
+ZjumpErrorCode BlockWriter::WriteEntropyTables(BitStreamWriter* writer) {
+    uint8_t written = writer->Append(block_.fse_coded, kBlockFseFieldSize);
+    if(written != kBlockFseFieldSize) {
+        return ZJUMP_ERROR_BIT_WRITER;
+    }
+
+    if(!block_.fse_coded) {
+        return WriteHuffmanTree(writer);
+    }
+
+    if(block_.fse_encoder->WriteHeader(writer)) {
         return ZJUMP_NO_ERROR;
     } else {
         return ZJUMP_ERROR_BIT_WRITER;
     }
 }
 
+ZjumpErrorCode BlockWriter::WriteHuffmanTree(BitStreamWriter* writer) {
+    uint8_t written = writer->Append(block_.huff_repeat, kBlockHuffmanRepeatFieldSize);
+    if(written != kBlockHuffmanRepeatFieldSize) {
+        return ZJUMP_ERROR_BIT_WRITER;
+    }
+
+    // the decoder takes the encodings from the previous block
+    if(block_.huff_repeat) {
+        return WriteHuffmanSelectors(writer);
+    }
+
+    written = writer->Append(block_.num_huff_encodings - 1u, kBlockNumHuffmanEncodingsFieldSize);
+    if(written != kBlockNumHuffmanEncodingsFieldSize) {
+        return ZJUMP_ERROR_BIT_WRITER;
+    }
+
+    for(uint8_t i=0; i<block_.num_huff_encodings; ++i) {
+        BlockHuffmanWriter huff_writer(*block_.huff_encodings[i]);
+        if(!huff_writer.Write(writer)) {
+            return ZJUMP_ERROR_BIT_WRITER;
+        }
+    }
+
+    return WriteHuffmanSelectors(writer);
+}
+
+// Selectors are move-to-front transformed and written in unary: selector
+// position j in the MTF list takes j bits set to one followed by a zero.
+ZjumpErrorCode BlockWriter::WriteHuffmanSelectors(BitStreamWriter* writer) {
+    if(block_.num_huff_encodings == 1) {
+        return ZJUMP_NO_ERROR;
+    }
+
+    uint8_t written = writer->Append(block_.num_huff_selectors, kBlockNumHuffmanSelectorsFieldSize);
+    if(written != kBlockNumHuffmanSelectorsFieldSize) {
+        return ZJUMP_ERROR_BIT_WRITER;
+    }
+
+    uint8_t mtf[kBlockMaxHuffmanEncodings];
+    for(uint8_t i=0; i<kBlockMaxHuffmanEncodings; ++i) {
+        mtf[i] = i;
+    }
+
+    for(size_t i=0; i<block_.num_huff_selectors; ++i) {
+        const uint8_t selector = block_.huff_selectors[i];
+        uint8_t j = 0;
+
+        while(mtf[j] != selector) {
+            ++j;
+        }
+
+        for(uint8_t k=j; k>0; --k) {
+            mtf[k] = mtf[k - 1];
+        }
+        mtf[0] = selector;
+
+        written = writer->Append((1u << j) - 1u, j + 1);
+        if(written != j + 1) {
+            return ZJUMP_ERROR_BIT_WRITER;
+        }
+    }
+
+    return ZJUMP_NO_ERROR;
+}
+
 ZjumpErrorCode BlockWriter::WriteLiterals(BitStreamWriter* writer) {
     uint8_t written = writer->Append(block_.padding_literals_size, kBlockNumLiteralsFieldSize);
     if(written != kBlockNumLiteralsFieldSize) {
@@ -95,7 +170,8 @@ ZjumpErrorCode BlockWriter::WriteLiterals(BitStreamWriter* writer) {
 }
 
 ZjumpErrorCode BlockWriter::WriteJumpSequences(BitStreamWriter* writer) {
-    const HuffmanEncoding *encoding = block_.huff_encoding;
+    const uint32_t *encoder_table = nullptr;
+    const bool use_selectors = (block_.num_huff_encodings > 1);
 
     uint8_t written = writer->Append(block_.num_jseqs, kBlockNumJumpSequencesFieldSize);
     if(written != kBlockNumJumpSequencesFieldSize) {
@@ -108,23 +184,50 @@ ZjumpErrorCode BlockWriter::WriteJumpSequences(BitStreamWriter* writer) {
         }
     }
 
-    for(size_t i=0; i<block_.jseq_stream_size; ++i) {
-        const uint16_t symbol = block_.jseq_stream[i];
-        const EncodedSymbol *enc = encoding->GetEncodedSymbol(symbol);
-        uint16_t reversed_bits;
+    // the stream was already coded while choosing the entropy coder
+    if(block_.fse_coded) {
+        if(block_.fse_encoder->WriteStream(writer)) {
+            return ZJUMP_NO_ERROR;
+        } else {
+            return ZJUMP_ERROR_BIT_WRITER;
+        }
+    }
+
+    encoder_table = block_.huff_encodings[0]->EncoderTable();
 
-        if(enc == nullptr) {
-            return ZJUMP_ERROR_UNEXPECTED;
+    uint64_t bits = 0;
+    uint8_t num_bits = 0;
+    uint32_t missing_code = 0;
+
+    for(size_t i=0; i<block_.jseq_stream_size; ++i) {
+        if(use_selectors && ((i % kBlockHuffmanGroupSize) == 0)) {
+            encoder_table = block_.huff_encodings[block_.huff_selectors[i / kBlockHuffmanGroupSize]]->EncoderTable();
         }
 
-        ReverseBits(enc->enc_value, enc->enc_bit_length, &reversed_bits);
+        const uint32_t entry = encoder_table[block_.jseq_stream[i]];
+        const uint8_t bit_length = static_cast<uint8_t>(entry);
 
-        written = writer->Append(reversed_bits, enc->enc_bit_length);
-        if(written != enc->enc_bit_length) {
-            return ZJUMP_ERROR_BIT_WRITER;
+        missing_code |= (bit_length == 0);
+        bits |= static_cast<uint64_t>(entry >> 8) << num_bits;
+        num_bits += bit_length;
+
+        if(num_bits > kBlockWriterMaxPackedBits) {
+            if(writer->Append(bits, num_bits) != num_bits) {
+                return ZJUMP_ERROR_BIT_WRITER;
+            }
+            bits = 0;
+            num_bits = 0;
         }
     }
 
+    if(missing_code) {
+        return ZJUMP_ERROR_UNEXPECTED;
+    }
+
+    if((num_bits > 0) && (writer->Append(bits, num_bits) != num_bits)) {
+        return ZJUMP_ERROR_BIT_WRITER;
+    }
+
     return ZJUMP_NO_ERROR;
 }
 
@@ -27,8 +27,12 @@ private:
 
     ZjumpErrorCode WriteBwtMetadata(BitStreamWriter* writer);
 
+    ZjumpErrorCode WriteEntropyTables(BitStreamWriter* writer);
+
     ZjumpErrorCode WriteHuffmanTree(BitStreamWriter* writer);
 
+    ZjumpErrorCode WriteHuffmanSelectors(BitStreamWriter* writer);
+
     ZjumpErrorCode WriteLiterals(BitStreamWriter* writer);
 
     ZjumpErrorCode WriteJumpSequences(BitStreamWriter* writer);
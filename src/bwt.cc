@@ -0,0 +1,269 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include "bwt.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "mem.h"
+
+// Distance, in input bytes, of the bucket slots prefetched while building the
+// LF table.
+static const size_t kLfTablePrefetchDistance = 16;
+
+// Minimum stream size for which suffixes are sorted in parallel.
+static const size_t kBwtParallelMinStreamSize = 128 * 1024;
+
+size_t BwtEntryPointOffset(size_t stream_size,
+                           uint8_t num_entry_points,
+                           uint8_t entry_point) {
+    assert(entry_point <= num_entry_points);
+    return (static_cast<uint64_t>(stream_size) * entry_point) / (num_entry_points + 1u);
+}
+
+// Bwt -------------------------------------------------------------------------
+
+Bwt::Bwt(const ZjumpAllocator* allocator) :
+    allocator_(AllocatorOrDefault(allocator)),
+    parallel_engine_(ParallelBwtEngine::MaxThreads()) {
+    engine_ = nullptr;
+    suffix_array_ = nullptr;
+    transformed_ = nullptr;
+}
+
+Bwt::~Bwt() {
+    Deallocate<int32_t>(allocator_, suffix_array_, kBlockMaxExpandedStreamSize, kHugePageSize);
+    Deallocate<uint8_t>(allocator_, transformed_, kBlockMaxExpandedStreamSize);
+}
+
+void Bwt::SetEngine(BwtEngine* engine) {
+    engine_ = engine;
+}
+
+void Bwt::SetNumThreads(int num_threads) {
+    parallel_engine_ = ParallelBwtEngine(num_threads);
+}
+
+BwtEngine* Bwt::SelectEngine(size_t stream_size) {
+    if(engine_ != nullptr) {
+        return engine_;
+    }
+
+    if( ParallelBwtEngine::Available() &&
+        (parallel_engine_.NumThreads() > 1) &&
+        (stream_size >= kBwtParallelMinStreamSize)) {
+        return &parallel_engine_;
+    }
+
+    return &serial_engine_;
+}
+
+ZjumpErrorCode Bwt::Transform(uint8_t* stream,
+                              size_t stream_size,
+                              uint32_t* primary_index,
+                              uint32_t* entry_points,
+                              uint8_t* num_entry_points) {
+    assert(stream != nullptr);
+    assert(stream_size > 0);
+    assert(stream_size <= kBlockMaxExpandedStreamSize);
+    assert(primary_index != nullptr);
+    assert(num_entry_points != nullptr);
+    assert(*num_entry_points <= kBlockMaxBwtEntryPoints);
+
+    // every chain must rebuild at least one byte
+    if(*num_entry_points >= stream_size) {
+        *num_entry_points = static_cast<uint8_t>(stream_size - 1);
+    }
+
+    if(suffix_array_ == nullptr) {
+        suffix_array_ = Allocate<int32_t>(allocator_, kBlockMaxExpandedStreamSize, kHugePageSize);
+        if(suffix_array_ == nullptr) {
+            return ZJUMP_ERROR_MEMORY_ALLOC;
+        }
+    }
+
+    if(*num_entry_points > 0) {
+        assert(entry_points != nullptr);
+        return TransformWithEntryPoints(stream, stream_size, primary_index,
+            entry_points, *num_entry_points);
+    }
+
+    int pidx = SelectEngine(stream_size)->Transform(stream, suffix_array_, stream_size);
+    if(pidx < 0) {
+        return ZJUMP_ERROR_BWT;
+    }
+
+    *primary_index = static_cast<uint32_t>(pidx);
+
+    return ZJUMP_NO_ERROR;
+}
+
+// The transform engines do not expose the suffix array, so the transform is
+// built from the one computed by the suffix sorting. Row r + 1 of the transform belongs to the suffix
+// that starts at sa[r]; row 0 belongs to the implicit end-of-string symbol.
+ZjumpErrorCode Bwt::TransformWithEntryPoints(uint8_t* stream,
+                                             size_t stream_size,
+                                             uint32_t* primary_index,
+                                             uint32_t* entry_points,
+                                             uint8_t num_entry_points) {
+    if(transformed_ == nullptr) {
+        transformed_ = Allocate<uint8_t>(allocator_, kBlockMaxExpandedStreamSize);
+        if(transformed_ == nullptr) {
+            return ZJUMP_ERROR_MEMORY_ALLOC;
+        }
+    }
+
+    const uint32_t num_chains = num_entry_points + 1u;
+    const int32_t *sa = suffix_array_;
+    uint8_t *out = transformed_;
+
+    if(!SelectEngine(stream_size)->SuffixSort(stream, suffix_array_, stream_size)) {
+        return ZJUMP_ERROR_BWT;
+    }
+
+    size_t n = 0;
+    out[n++] = stream[stream_size - 1];
+
+    for(size_t r=0; r<stream_size; ++r) {
+        const size_t offset = static_cast<size_t>(sa[r]);
+
+        if(offset == 0) {
+            *primary_index = static_cast<uint32_t>(r + 1);
+            continue;
+        }
+
+        out[n++] = stream[offset - 1];
+
+        // the smallest chain whose start is not before this offset
+        const size_t chain = (static_cast<uint64_t>(offset) * num_chains + stream_size - 1) / stream_size;
+        if( (chain <= num_entry_points) &&
+            (BwtEntryPointOffset(stream_size, num_entry_points, chain) == offset)) {
+            entry_points[chain - 1] = static_cast<uint32_t>(r + 1);
+        }
+    }
+
+    std::copy_n(out, stream_size, stream);
+
+    return ZJUMP_NO_ERROR;
+}
+
+// InverseBwt ------------------------------------------------------------------
+
+InverseBwt::InverseBwt(const ZjumpAllocator* allocator) :
+    allocator_(AllocatorOrDefault(allocator)) {
+    lf_table_ = nullptr;
+    lf_table_size_ = 0;
+}
+
+InverseBwt::~InverseBwt() {
+    Deallocate<uint32_t>(allocator_, lf_table_, lf_table_size_);
+}
+
+ZjumpErrorCode InverseBwt::Transform(uint8_t* stream,
+                                     size_t stream_size,
+                                     uint32_t primary_index,
+                                     const uint32_t* entry_points,
+                                     uint8_t num_entry_points) {
+    assert(stream != nullptr);
+    assert(stream_size <= kBlockMaxExpandedStreamSize);
+    assert(num_entry_points <= kBlockMaxBwtEntryPoints);
+
+    if(stream_size == 0) {
+        return ZJUMP_NO_ERROR;
+    }
+
+    const uint32_t num_chains = num_entry_points + 1u;
+    uint32_t row[kBlockMaxBwtEntryPoints + 1];
+    uint8_t *out[kBlockMaxBwtEntryPoints + 1];
+    size_t length[kBlockMaxBwtEntryPoints + 1];
+
+    row[0] = primary_index;
+    for(uint8_t j=0; j<num_entry_points; ++j) {
+        row[j + 1] = entry_points[j];
+    }
+
+    for(uint32_t j=0; j<num_chains; ++j) {
+        if((row[j] == 0) || (row[j] > stream_size)) {
+            return ZJUMP_ERROR_BWT;
+        }
+
+        size_t start = BwtEntryPointOffset(stream_size, num_entry_points, j);
+        size_t end = (j == num_entry_points) ?
+            stream_size : BwtEntryPointOffset(stream_size, num_entry_points, j + 1);
+        out[j] = stream + start;
+        length[j] = end - start;
+    }
+
+    // Row 0 (the one of the implicit end-of-string symbol) is kept as a
+    // sentinel pointing to itself, so a corrupted chain never leaves the table.
+    if(!Grow<uint32_t>(allocator_, &lf_table_, &lf_table_size_, 0, stream_size + 1)) {
+        return ZJUMP_ERROR_MEMORY_ALLOC;
+    }
+    lf_table_[0] = 0;
+
+    BuildLfTable(stream, stream_size, primary_index);
+
+    const uint32_t *lf = lf_table_;
+    const size_t common_length = *std::min_element(length, length + num_chains);
+
+    // All the chains are followed at the same time. The entry a chain will
+    // need next is prefetched while the rest of the chains are processed.
+    for(size_t i=0; i<common_length; ++i) {
+        for(uint32_t j=0; j<num_chains; ++j) {
+            const uint32_t entry = lf[row[j]];
+            out[j][i] = static_cast<uint8_t>(entry);
+            row[j] = entry >> 8;
+            __builtin_prefetch(&lf[row[j]]);
+        }
+    }
+
+    for(uint32_t j=0; j<num_chains; ++j) {
+        for(size_t i=common_length; i<length[j]; ++i) {
+            const uint32_t entry = lf[row[j]];
+            out[j][i] = static_cast<uint8_t>(entry);
+            row[j] = entry >> 8;
+        }
+    }
+
+    return ZJUMP_NO_ERROR;
+}
+
+size_t InverseBwt::MemoryFootprint() const {
+    return sizeof(*this) + lf_table_size_ * sizeof(uint32_t);
+}
+
+// The stream does not contain the end-of-string symbol, which would be placed
+// at primary_index. Hence, the row of the i-th byte is i when i < primary_index
+// and i + 1 otherwise. Rows are stored one position ahead of their sorted
+// position to leave room for the sentinel.
+void InverseBwt::BuildLfTable(const uint8_t* stream,
+                              size_t stream_size,
+                              uint32_t primary_index) {
+    uint32_t bucket[256] = {0};
+
+    for(size_t i=0; i<stream_size; ++i) {
+        ++bucket[stream[i]];
+    }
+
+    for(uint32_t c=0, sum=1; c<256; ++c) {
+        uint32_t count = bucket[c];
+        bucket[c] = sum;
+        sum += count;
+    }
+
+    uint32_t *lf = lf_table_;
+
+    for(size_t i=0; i<stream_size; ++i) {
+        if(i + kLfTablePrefetchDistance < stream_size) {
+            __builtin_prefetch(&lf[bucket[stream[i + kLfTablePrefetchDistance]]], 1);
+        }
+
+        const uint8_t c = stream[i];
+        const uint32_t row = static_cast<uint32_t>(i) + (i >= primary_index);
+        lf[bucket[c]++] = (row << 8) | c;
+    }
+}
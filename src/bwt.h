@@ -0,0 +1,115 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#ifndef BWT_H_
+#define BWT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "bwt_engine.h"
+#include "constants.h"
+#include "mem.h"
+
+// Returns the stream offset at which the entry_point-th chain of the inverse
+// transform starts, when the stream is split into num_entry_points + 1 chains.
+// Chain 0 always starts at offset 0, the one of the primary index.
+size_t BwtEntryPointOffset(size_t stream_size,
+                           uint8_t num_entry_points,
+                           uint8_t entry_point);
+
+// Burrows-Wheeler Transform.
+// It transforms a stream in place, in the same way libdivsufsort's divbwt does.
+//
+// Besides the primary index, it can also record the rows of some extra entry
+// points (see BwtEntryPointOffset), which let InverseBwt rebuild the stream
+// through several independent chains.
+//
+// The suffix array workspace is allocated by the first call to Transform,
+// with kHugePageSize alignment so it can be backed by huge pages, and reused
+// by the next ones. libdivsufsort allocates its buckets (about 257 KB) with
+// malloc on every call, out of reach of the allocator.
+//
+// Suffix sorting is delegated to a BwtEngine. Unless an engine is set, the
+// parallel engine is chosen for large streams when several threads are
+// available, and the serial one otherwise.
+class Bwt {
+public:
+    // The workspaces are allocated with allocator, or with the default one
+    // when it is null.
+    explicit Bwt(const ZjumpAllocator* allocator = nullptr);
+
+    ~Bwt();
+
+    // Forces every transform to use engine. A nullptr restores the
+    // automatic selection. The engine is not owned by this object.
+    void SetEngine(BwtEngine* engine);
+
+    // Sets the number of threads the parallel engine may use.
+    void SetNumThreads(int num_threads);
+
+    // num_entry_points holds the requested number of extra entry points and
+    // is updated with the number actually recorded in entry_points.
+    ZjumpErrorCode Transform(uint8_t* stream,
+                             size_t stream_size,
+                             uint32_t* primary_index,
+                             uint32_t* entry_points,
+                             uint8_t* num_entry_points);
+
+private:
+    const ZjumpAllocator *allocator_;
+    int32_t *suffix_array_;
+    uint8_t *transformed_;
+    SerialBwtEngine serial_engine_;
+    ParallelBwtEngine parallel_engine_;
+    BwtEngine *engine_;
+
+    BwtEngine* SelectEngine(size_t stream_size);
+
+    ZjumpErrorCode TransformWithEntryPoints(uint8_t* stream,
+                                            size_t stream_size,
+                                            uint32_t* primary_index,
+                                            uint32_t* entry_points,
+                                            uint8_t num_entry_points);
+};
+
+// Inverse Burrows-Wheeler Transform.
+// It restores, in place, a stream transformed by Bwt.
+//
+// Every entry of the LF table packs the next row to visit (upper 24 bits) and
+// the byte to output (lower 8 bits) into a single uint32_t, so that each step
+// of the reconstruction costs one random memory access. The table is
+// reused by every call to Transform, and only reallocated when a stream
+// larger than any of the previous ones comes.
+//
+// When entry points are given, the chains that start at them are followed in
+// an interleaved way, so their memory accesses overlap with each other.
+class InverseBwt {
+public:
+    explicit InverseBwt(const ZjumpAllocator* allocator = nullptr);
+
+    ~InverseBwt();
+
+    ZjumpErrorCode Transform(uint8_t* stream,
+                             size_t stream_size,
+                             uint32_t primary_index,
+                             const uint32_t* entry_points = nullptr,
+                             uint8_t num_entry_points = 0);
+
+    // Bytes of the object and its LF table.
+    size_t MemoryFootprint() const;
+
+private:
+    const ZjumpAllocator *allocator_;
+    uint32_t *lf_table_;
+    size_t lf_table_size_;
+
+    void BuildLfTable(const uint8_t* stream,
+                      size_t stream_size,
+                      uint32_t primary_index);
+};
+
+#endif // BWT_H_
@@ -0,0 +1,80 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include "bwt_engine.h"
+
+#include <cassert>
+#include <divsufsort.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// The number of OpenMP threads is a per-thread setting, so engines running
+// on different threads do not interfere with each other.
+static void SetNumThreads(int num_threads) {
+#ifdef _OPENMP
+    omp_set_num_threads(num_threads);
+#else
+    (void)num_threads;
+#endif
+}
+
+// SerialBwtEngine -------------------------------------------------------------
+
+bool SerialBwtEngine::SuffixSort(const uint8_t* stream,
+                                 int32_t* sa,
+                                 size_t stream_size) {
+    SetNumThreads(1);
+    return divsufsort(stream, sa, stream_size) == 0;
+}
+
+int SerialBwtEngine::Transform(uint8_t* stream,
+                               int32_t* sa,
+                               size_t stream_size) {
+    SetNumThreads(1);
+    return divbwt(stream, stream, sa, stream_size);
+}
+
+// ParallelBwtEngine -----------------------------------------------------------
+
+ParallelBwtEngine::ParallelBwtEngine(int num_threads) {
+    assert(num_threads > 0);
+    num_threads_ = num_threads;
+}
+
+bool ParallelBwtEngine::SuffixSort(const uint8_t* stream,
+                                   int32_t* sa,
+                                   size_t stream_size) {
+    SetNumThreads(num_threads_);
+    return divsufsort(stream, sa, stream_size) == 0;
+}
+
+int ParallelBwtEngine::Transform(uint8_t* stream,
+                                 int32_t* sa,
+                                 size_t stream_size) {
+    SetNumThreads(num_threads_);
+    return divbwt(stream, stream, sa, stream_size);
+}
+
+int ParallelBwtEngine::NumThreads() const {
+    return num_threads_;
+}
+
+bool ParallelBwtEngine::Available() {
+#ifdef _OPENMP
+    return true;
+#else
+    return false;
+#endif
+}
+
+int ParallelBwtEngine::MaxThreads() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
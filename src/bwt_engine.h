@@ -0,0 +1,73 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#ifndef BWT_ENGINE_H_
+#define BWT_ENGINE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// BwtEngine class
+//
+// Suffix sorting back end used by Bwt. Both methods work on a workspace
+// (sa) of, at least, stream_size elements, which is owned by the caller.
+class BwtEngine {
+public:
+    virtual ~BwtEngine() {}
+
+    // Stores the suffix array of stream in sa. Returns false on failure.
+    virtual bool SuffixSort(const uint8_t* stream,
+                            int32_t* sa,
+                            size_t stream_size) = 0;
+
+    // Transforms stream in place, as libdivsufsort's divbwt does, and
+    // returns the primary index, or a negative value on failure.
+    virtual int Transform(uint8_t* stream,
+                          int32_t* sa,
+                          size_t stream_size) = 0;
+};
+
+// Single-threaded libdivsufsort.
+class SerialBwtEngine : public BwtEngine {
+public:
+    bool SuffixSort(const uint8_t* stream,
+                    int32_t* sa,
+                    size_t stream_size) override;
+
+    int Transform(uint8_t* stream,
+                  int32_t* sa,
+                  size_t stream_size) override;
+};
+
+// Multi-threaded libdivsufsort.
+//
+// It needs zjump and libdivsufsort to be built with OpenMP (ZJUMP_USE_OPENMP
+// in CMake, OPENMP=1 in make). Otherwise it runs on a single thread.
+class ParallelBwtEngine : public BwtEngine {
+public:
+    explicit ParallelBwtEngine(int num_threads);
+
+    bool SuffixSort(const uint8_t* stream,
+                    int32_t* sa,
+                    size_t stream_size) override;
+
+    int Transform(uint8_t* stream,
+                  int32_t* sa,
+                  size_t stream_size) override;
+
+    int NumThreads() const;
+
+    // Whether the engine can actually use more than one thread.
+    static bool Available();
+
+    // Number of threads available to the engine by default.
+    static int MaxThreads();
+
+private:
+    int num_threads_;
+};
+
+#endif // BWT_ENGINE_H_
@@ -6,24 +6,42 @@
 
 #include "compress.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
 
-#include "block_compressor.h"
 #include "mem.h"
 
-Compressor::Compressor() {
-    in_stream_ = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
-    out_stream_ = SecureAlloc<uint8_t>(kBlockMaxCompressedStreamSize);
+Compressor::Compressor(const ZjumpAllocator* allocator) :
+    allocator_(AllocatorOrDefault(allocator)),
+    block_comp_(allocator_) {
+    in_stream_ = nullptr;
+    out_stream_ = nullptr;
     in_stream_size_ = 0;
     out_stream_size_ = 0;
     out_file_ = nullptr;
+    in_map_pos_ = 0;
     num_blocks_ = 0;
+
+    for(unsigned i=0; i<kIoRingBlocks; ++i) {
+        ring_blocks_[i].in = nullptr;
+        ring_blocks_[i].out = nullptr;
+    }
 }
 
 Compressor::~Compressor() {
-    SecureFree<uint8_t>(in_stream_);
-    SecureFree<uint8_t>(out_stream_);
+    // No request may be left writing into the buffers
+    io_ring_.Close();
+
+    Deallocate<uint8_t>(allocator_, in_stream_, kBlockMaxExpandedStreamSize);
+    Deallocate<uint8_t>(allocator_, out_stream_, kBlockMaxCompressedStreamSize);
+
+    for(unsigned i=0; i<kIoRingBlocks; ++i) {
+        Deallocate<uint8_t>(allocator_, ring_blocks_[i].in, kBlockMaxExpandedStreamSize);
+        Deallocate<uint8_t>(allocator_, ring_blocks_[i].out, 3 + kBlockMaxCompressedStreamSize);
+    }
 }
 
 ZjumpErrorCode Compressor::Compress(FILE *in_file, FILE *out_file) {
@@ -32,6 +50,28 @@ ZjumpErrorCode Compressor::Compress(FILE *in_file, FILE *out_file) {
 
     out_file_ = out_file;
     num_blocks_ = 0;
+    block_comp_.Reset();
+    stats_.Clear();
+
+    if(SupportsPositionalIo(in_file) && SupportsPositionalIo(out_file) && InitIoRing()) {
+        return CompressWithIoRing(in_file, out_file);
+    }
+
+    if(in_stream_ == nullptr) {
+        in_stream_ = Allocate<uint8_t>(allocator_, kBlockMaxExpandedStreamSize);
+    }
+    if(out_stream_ == nullptr) {
+        out_stream_ = Allocate<uint8_t>(allocator_, kBlockMaxCompressedStreamSize);
+    }
+    if((in_stream_ == nullptr) || (out_stream_ == nullptr)) {
+        return ZJUMP_ERROR_MEMORY_ALLOC;
+    }
+
+    in_map_.Map(in_file);
+    in_map_pos_ = 0;
+
+    BlockStats io_stats;
+    StageTimer io_timer(&io_stats);
 
     ZjumpErrorCode ret_code = ReserveNumBlocksField();
     if(ret_code != ZJUMP_NO_ERROR) {
@@ -40,30 +80,44 @@ ZjumpErrorCode Compressor::Compress(FILE *in_file, FILE *out_file) {
 
     do {
         out_stream_size_ = 0;
-        in_stream_size_ = fread(in_stream_, 1, kBlockMaxExpandedStreamSize, in_file);
+        if(StageTimer::kEnabled) {
+            io_stats.Clear();
+        }
+        io_timer.Restart();
 
-        if(ferror(in_file)) {
-            return ZJUMP_ERROR_FILE;
+        ret_code = ReadBlock(in_file);
+        if(ret_code != ZJUMP_NO_ERROR) {
+            return ret_code;
         }
+        io_timer.Lap(kStatsStageIo);
 
         if(in_stream_size_ == 0) {
             break;
         }
 
-        BlockCompressor block_comp;
-        ret_code = block_comp.Compress(in_stream_, in_stream_size_, out_stream_, &out_stream_size_);
+        ret_code = block_comp_.Compress(in_stream_, in_stream_size_, out_stream_, &out_stream_size_);
         if(ret_code != ZJUMP_NO_ERROR) {
             return ret_code;
         }
 
+        io_timer.Restart();
         ret_code = WriteBlock();
         if(ret_code != ZJUMP_NO_ERROR) {
             return ret_code;
         }
+        io_timer.Lap(kStatsStageIo);
+
+        if(StageTimer::kEnabled) {
+            BlockStats block_stats = block_comp_.LastBlockStats();
+            block_stats.stage_nanos[kStatsStageIo] = io_stats.stage_nanos[kStatsStageIo];
+            stats_.AddBlock(block_stats);
+        }
 
         ++num_blocks_;
 
-    } while(!feof(in_file));
+    } while(in_map_.IsMapped() || !feof(in_file));
+
+    in_map_.Unmap();
 
     ret_code = WriteNumBlocksField();
     if(ret_code != ZJUMP_NO_ERROR) {
@@ -74,6 +128,196 @@ ZjumpErrorCode Compressor::Compress(FILE *in_file, FILE *out_file) {
     return ZJUMP_NO_ERROR;
 }
 
+const StreamStats& Compressor::Stats() const {
+    return stats_;
+}
+
+// The BWT transforms the block in place, so the data is copied once into
+// in_stream_, either from the mapping or through stdio.
+ZjumpErrorCode Compressor::ReadBlock(FILE* in_file) {
+    if(in_map_.IsMapped()) {
+        in_stream_size_ = std::min(kBlockMaxExpandedStreamSize, in_map_.Size() - in_map_pos_);
+        std::memcpy(in_stream_, in_map_.Data() + in_map_pos_, in_stream_size_);
+        in_map_pos_ += in_stream_size_;
+        return ZJUMP_NO_ERROR;
+    }
+
+    in_stream_size_ = fread(in_stream_, 1, kBlockMaxExpandedStreamSize, in_file);
+
+    if(ferror(in_file)) {
+        return ZJUMP_ERROR_FILE;
+    }
+
+    return ZJUMP_NO_ERROR;
+}
+
+bool Compressor::InitIoRing() {
+    if(io_ring_.IsOpen()) {
+        return true;
+    }
+
+    // Every block may have both its read and its write in flight
+    if(!io_ring_.Init(2 * kIoRingBlocks)) {
+        return false;
+    }
+
+    struct iovec buffers[2 * kIoRingBlocks];
+
+    for(unsigned i=0; i<kIoRingBlocks; ++i) {
+        RingBlock &block = ring_blocks_[i];
+
+        if(block.in == nullptr) {
+            block.in = Allocate<uint8_t>(allocator_, kBlockMaxExpandedStreamSize);
+        }
+        if(block.out == nullptr) {
+            // block length field and block
+            block.out = Allocate<uint8_t>(allocator_, 3 + kBlockMaxCompressedStreamSize);
+        }
+        if((block.in == nullptr) || (block.out == nullptr)) {
+            // Blocks are compressed with stdio instead
+            io_ring_.Close();
+            return false;
+        }
+
+        block.read.buffer_index = 2 * i;
+        block.write.buffer_index = 2 * i + 1;
+        buffers[2 * i].iov_base = block.in;
+        buffers[2 * i].iov_len = kBlockMaxExpandedStreamSize;
+        buffers[2 * i + 1].iov_base = block.out;
+        buffers[2 * i + 1].iov_len = 3 + kBlockMaxCompressedStreamSize;
+    }
+
+    // Unregistered buffers work too, just a bit slower
+    io_ring_.RegisterBuffers(buffers, 2 * kIoRingBlocks);
+
+    return true;
+}
+
+ZjumpErrorCode Compressor::CompressWithIoRing(FILE* in_file, FILE* out_file) {
+    ZjumpErrorCode ret_code = RunIoRing(in_file, out_file);
+
+    // No request is left in flight, even after an error
+    for(unsigned i=0; i<kIoRingBlocks; ++i) {
+        io_ring_.Wait(&ring_blocks_[i].read);
+        io_ring_.Wait(&ring_blocks_[i].write);
+    }
+
+    return ret_code;
+}
+
+// Blocks are read kIoRingBlocks ahead, and every block is written while the
+// next ones are compressed. Since the input size is known, so is the range
+// of every block, and the output offset of a block follows from the size of
+// the previous ones.
+ZjumpErrorCode Compressor::RunIoRing(FILE* in_file, FILE* out_file) {
+    const int in_fd = fileno(in_file);
+    const int out_fd = fileno(out_file);
+    struct stat st;
+
+    if((fstat(in_fd, &st) != 0) || (fflush(out_file) != 0)) {
+        return ZJUMP_ERROR_FILE;
+    }
+
+    const off_t in_start = ftello(in_file);
+    const size_t in_size = (st.st_size > in_start) ? static_cast<size_t>(st.st_size - in_start) : 0;
+    const size_t num_blocks = (in_size + kBlockMaxExpandedStreamSize - 1) / kBlockMaxExpandedStreamSize;
+    const off_t out_start = ftello(out_file);
+    off_t out_offset = out_start + 2;
+
+    for(size_t i=0; i<num_blocks; ++i) {
+        RingBlock &block = ring_blocks_[i % kIoRingBlocks];
+
+        BlockStats io_stats;
+        StageTimer io_timer(&io_stats);
+
+        // The block kIoRingBlocks behind must be written before its buffer is
+        // reused
+        if(i >= kIoRingBlocks) {
+            if(!io_ring_.Wait(&block.write)) {
+                return ZJUMP_ERROR_FILE;
+            }
+        }
+
+        if(i < kIoRingBlocks) {
+            block.read.fd = in_fd;
+            block.read.data = block.in;
+            block.read.write = false;
+            block.read.offset = in_start + static_cast<off_t>(i * kBlockMaxExpandedStreamSize);
+            block.read.size = std::min(kBlockMaxExpandedStreamSize, in_size - i * kBlockMaxExpandedStreamSize);
+            if(!io_ring_.Start(&block.read)) {
+                return ZJUMP_ERROR_FILE;
+            }
+        }
+
+        if(!io_ring_.Wait(&block.read) || (block.read.done != block.read.size)) {
+            return ZJUMP_ERROR_FILE;
+        }
+        io_timer.Lap(kStatsStageIo);
+
+        size_t out_size = 0;
+        ZjumpErrorCode ret_code = block_comp_.Compress(block.in, block.read.size, block.out + 3, &out_size);
+        if(ret_code != ZJUMP_NO_ERROR) {
+            return ret_code;
+        }
+
+        io_timer.Restart();
+        uint32_t block_length_field = static_cast<uint32_t>(out_size);
+        std::memcpy(block.out, &block_length_field, 3);
+
+        block.write.fd = out_fd;
+        block.write.data = block.out;
+        block.write.write = true;
+        block.write.offset = out_offset;
+        block.write.size = 3 + out_size;
+        if(!io_ring_.Start(&block.write)) {
+            return ZJUMP_ERROR_FILE;
+        }
+        out_offset += static_cast<off_t>(block.write.size);
+
+        // The BWT is done with the input buffer, which can take the block
+        // kIoRingBlocks ahead
+        const size_t next = i + kIoRingBlocks;
+        if(next < num_blocks) {
+            block.read.offset = in_start + static_cast<off_t>(next * kBlockMaxExpandedStreamSize);
+            block.read.size = std::min(kBlockMaxExpandedStreamSize, in_size - next * kBlockMaxExpandedStreamSize);
+            if(!io_ring_.Start(&block.read)) {
+                return ZJUMP_ERROR_FILE;
+            }
+        }
+        io_timer.Lap(kStatsStageIo);
+
+        if(StageTimer::kEnabled) {
+            BlockStats block_stats = block_comp_.LastBlockStats();
+            block_stats.stage_nanos[kStatsStageIo] = io_stats.stage_nanos[kStatsStageIo];
+            stats_.AddBlock(block_stats);
+        }
+
+        ++num_blocks_;
+    }
+
+    for(size_t i=0; i<std::min<size_t>(num_blocks, kIoRingBlocks); ++i) {
+        if(!io_ring_.Wait(&ring_blocks_[i].write)) {
+            return ZJUMP_ERROR_FILE;
+        }
+    }
+
+    IoRequest num_blocks_field;
+    num_blocks_field.fd = out_fd;
+    num_blocks_field.data = reinterpret_cast<uint8_t*>(&num_blocks_);
+    num_blocks_field.size = 2;
+    num_blocks_field.offset = out_start;
+    num_blocks_field.write = true;
+    if(!io_ring_.Start(&num_blocks_field) || !io_ring_.Wait(&num_blocks_field)) {
+        return ZJUMP_ERROR_FILE;
+    }
+
+    if(fseeko(out_file, out_offset, SEEK_SET) != 0) {
+        return ZJUMP_ERROR_FILE;
+    }
+
+    return ZJUMP_NO_ERROR;
+}
+
 ZjumpErrorCode Compressor::ReserveNumBlocksField() {
     uint16_t zero = 0;
 
@@ -10,23 +10,63 @@
 #include <cstdint>
 #include <cstdio>
 
+#include "block_compressor.h"
 #include "constants.h"
+#include "io_ring.h"
+#include "mapped_file.h"
+#include "mem.h"
+#include "stats.h"
 
+// Compressor class
+//
+// Compresses a file into a zjump stream, block by block. Memory is allocated
+// with allocator, or with the default one when it is null, and allocation
+// failures make Compress fail with ZJUMP_ERROR_MEMORY_ALLOC.
 class Compressor {
 public:
-    Compressor();
+    explicit Compressor(const ZjumpAllocator* allocator = nullptr);
 
     ~Compressor();
 
     ZjumpErrorCode Compress(FILE *in_file, FILE *out_file);
 
+    // Stats of every block of the last stream. They are only measured in
+    // builds with ZJUMP_STATS.
+    const StreamStats& Stats() const;
+
 private:
+    // Buffers of a block compressed through io_ring_: in is read, and out
+    // written, asynchronously
+    struct RingBlock {
+        uint8_t *in;
+        uint8_t *out;
+        IoRequest read;
+        IoRequest write;
+    };
+
+    const ZjumpAllocator *allocator_;
     uint8_t *in_stream_;
     uint8_t *out_stream_;
     size_t in_stream_size_;
     size_t out_stream_size_;
     FILE *out_file_;
+    // Regular input files are mapped, and the rest read with stdio
+    MappedFile in_map_;
+    size_t in_map_pos_;
     uint16_t num_blocks_;
+    StreamStats stats_;
+    BlockCompressor block_comp_;
+    IoRing io_ring_;
+    RingBlock ring_blocks_[kIoRingBlocks];
+
+    ZjumpErrorCode ReadBlock(FILE* in_file);
+
+    // Sets up io_ring_ and the buffers of ring_blocks_, the first time.
+    bool InitIoRing();
+
+    ZjumpErrorCode CompressWithIoRing(FILE* in_file, FILE* out_file);
+
+    ZjumpErrorCode RunIoRing(FILE* in_file, FILE* out_file);
 
     ZjumpErrorCode ReserveNumBlocksField();
 
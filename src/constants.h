@@ -28,7 +28,11 @@ typedef enum {
     ZJUMP_ERROR_FORMAT_LITERALS_LENGTH,
     ZJUMP_ERROR_FORMAT_NUM_JSEQS,
     ZJUMP_ERROR_FORMAT_HUFFMAN_ENCODED_SYMBOL,
-    ZJUMP_ERROR_RECONSTRUCTING_STREAM
+    ZJUMP_ERROR_RECONSTRUCTING_STREAM,
+    ZJUMP_ERROR_FORMAT_HUFFMAN_REPEAT,
+    ZJUMP_ERROR_FORMAT_HUFFMAN_SELECTOR,
+    ZJUMP_ERROR_FORMAT_FSE_TABLE,
+    ZJUMP_ERROR_FORMAT_BWT_ENTRY_POINTS
 } ZjumpErrorCode;
 
 // Zjump version = MAJOR*10000 + MINOR*100 + PATCH
@@ -39,6 +43,9 @@ static const size_t kBlockMaxCompressedStreamSize   = 250000;
 
 static const size_t kBlockMaxNumJumpSequences = 65535;
 
+static const uint8_t kBlockMaxBwtEntryPoints        = 15;
+static const uint8_t kBlockDefaultBwtEntryPoints    = 7;
+
 static const uint16_t kRUNASymbol           = 0;
 static const uint16_t kRUNBSymbol           = 1;
 static const uint16_t kMinJumpSymbol        = 2;
@@ -50,11 +57,35 @@ static const uint16_t kShrinkStreamSymbol   = 255;
 static const uint16_t kMinJumpSize = 2;
 static const uint16_t kMaxJumpSize = kMaxJumpSymbol - kMinJumpSymbol + kMinJumpSize;
 
+// ZjumpBlock::jseq_stream holds a byte per jump or symbol
+static_assert((kShrinkStreamSymbol <= 0xff) && (kMaxJumpSize <= 0xff), "jseq stream values must fit in a byte");
+
 static const uint16_t kBlockMaxEncodingSymbols  = 256;
 static const uint8_t kBlockMaxEncodingBitLength = 15;
 
+// The jseq stream is split in groups of kBlockHuffmanGroupSize symbols, and
+// every group is coded with one of the (up to kBlockMaxHuffmanEncodings)
+// Huffman encodings of the block.
+static const uint8_t kBlockMaxHuffmanEncodings = 6;
+static const size_t kBlockHuffmanGroupSize = 50;
+static const size_t kBlockMaxHuffmanSelectors =
+    (kBlockMaxCompressedStreamSize + kBlockHuffmanGroupSize - 1) / kBlockHuffmanGroupSize;
+
+// Number of refinement passes used to choose the Huffman encodings of a block.
+static const uint8_t kBlockHuffmanRefinementPasses = 4;
+
+// A block reuses the Huffman encodings of the previous one when that costs, at
+// most, this number of bits more than new encodings (including their header).
+static const size_t kBlockHuffmanRepeatMaxExtraBits = 256;
+
 static const uint8_t kBlockBwtPrimaryIndexFieldSize     = 24;
+static const uint8_t kBlockBwtNumEntryPointsFieldSize   = 4;
+static const uint8_t kBlockBwtEntryPointFieldSize       = 24;
+static const uint8_t kBlockFseFieldSize                 = 1;
+static const uint8_t kBlockHuffmanRepeatFieldSize       = 1;
 static const uint8_t kBlockHuffmanBitLengthFieldSize    = 4;
+static const uint8_t kBlockNumHuffmanEncodingsFieldSize = 3;
+static const uint8_t kBlockNumHuffmanSelectorsFieldSize = 16;
 static const uint8_t kBlockNumLiteralsFieldSize         = 24;
 static const uint8_t kBlockNumJumpSequencesFieldSize    = 16;
 
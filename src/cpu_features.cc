@@ -0,0 +1,60 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include "cpu_features.h"
+
+#include <cstdlib>
+#include <cstring>
+
+CpuFeatures::CpuFeatures() {
+    sse42 = false;
+    avx2 = false;
+    bmi2 = false;
+    avx512 = false;
+}
+
+std::string CpuFeatures::Names() const {
+    std::string names;
+
+    if(sse42) {
+        names += " sse4.2";
+    }
+    if(avx2) {
+        names += " avx2";
+    }
+    if(bmi2) {
+        names += " bmi2";
+    }
+    if(avx512) {
+        names += " avx512f";
+    }
+
+    return names.empty() ? "generic" : names.substr(1);
+}
+
+CpuFeatures DetectCpuFeatures() {
+    CpuFeatures features;
+
+    const char *forced = getenv("ZJUMP_CPU");
+    if((forced != nullptr) && (strcmp(forced, "generic") == 0)) {
+        return features;
+    }
+
+#if defined(ZJUMP_CPU_DISPATCH)
+    __builtin_cpu_init();
+    features.sse42 = __builtin_cpu_supports("sse4.2");
+    features.avx2 = __builtin_cpu_supports("avx2");
+    features.bmi2 = __builtin_cpu_supports("bmi2");
+    features.avx512 = __builtin_cpu_supports("avx512f");
+#endif
+
+    return features;
+}
+
+const CpuFeatures& GetCpuFeatures() {
+    static const CpuFeatures features = DetectCpuFeatures();
+    return features;
+}
@@ -0,0 +1,45 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#ifndef CPU_FEATURES_H_
+#define CPU_FEATURES_H_
+
+#include <string>
+
+// Kernels for specific instruction sets are only compiled on x86 with GCC or
+// Clang, which can target them function by function. Elsewhere, every kernel
+// runs its generic version.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define ZJUMP_CPU_DISPATCH
+#define ZJUMP_TARGET(isa) __attribute__((target(isa)))
+#define ZJUMP_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define ZJUMP_TARGET(isa)
+#define ZJUMP_ALWAYS_INLINE inline
+#endif
+
+// Instruction set extensions of the CPU that zjump runs on.
+struct CpuFeatures {
+    bool sse42;
+    bool avx2;
+    bool bmi2;
+    bool avx512;
+
+    CpuFeatures();
+
+    // Names of the available extensions, separated by spaces, or "generic".
+    std::string Names() const;
+};
+
+// Detects the features of the CPU. Setting ZJUMP_CPU=generic in the
+// environment disables them all, to compare against the generic kernels.
+CpuFeatures DetectCpuFeatures();
+
+// Features detected the first time it is called, which kernels use to pick
+// their version.
+const CpuFeatures& GetCpuFeatures();
+
+#endif // CPU_FEATURES_H_
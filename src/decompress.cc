@@ -6,31 +6,78 @@
 
 #include "decompress.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <fcntl.h>
+#include <thread>
+#include <unistd.h>
 
-#include "block_decompressor.h"
 #include "mem.h"
 
-Decompressor::Decompressor() {
-    in_stream_ = SecureAlloc<uint8_t>(kBlockMaxCompressedStreamSize);
-    out_stream_ = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+Decompressor::Decompressor(const ZjumpAllocator* allocator) :
+    allocator_(AllocatorOrDefault(allocator)),
+    block_decomp_(allocator_) {
     in_stream_size_ = 0;
     out_stream_size_ = 0;
+    in_block_ = nullptr;
     in_file_ = nullptr;
+    in_map_pos_ = 0;
+    in_size_ = 0;
     num_blocks_ = 0;
+    num_threads_ = 1;
+    next_block_ = 0;
+    error_ = ZJUMP_NO_ERROR;
+    out_fd_ = -1;
+    out_offset_ = 0;
+    out_size_ = 0;
+
+    for(unsigned i=0; i<kIoRingBlocks; ++i) {
+        ring_out_streams_[i] = nullptr;
+    }
 }
 
 Decompressor::~Decompressor() {
-    SecureFree<uint8_t>(in_stream_);
-    SecureFree<uint8_t>(out_stream_);
+    // No request may be left reading from the buffers
+    ReleaseIoRing();
+}
+
+void Decompressor::SetNumThreads(int num_threads) {
+    assert(num_threads > 0);
+    num_threads_ = num_threads;
 }
 
 ZjumpErrorCode Decompressor::Decompress(FILE* in_file, FILE* out_file) {
     assert(in_file != nullptr);
-    assert(out_file != nullptr);
 
     in_file_ = in_file;
     num_blocks_ = 0;
+    in_size_ = 0;
+    out_size_ = 0;
+    block_decomp_.Reset();
+    stats_.Clear();
+
+    in_map_.Map(in_file);
+    in_map_pos_ = 0;
+
+    const bool positional_out = (out_file == nullptr) || SupportsPositionalIo(out_file);
+
+    if((num_threads_ > 1) && in_map_.IsMapped() && positional_out) {
+        ZjumpErrorCode ret_code = DecompressInParallel(out_file);
+        in_map_.Unmap();
+        return ret_code;
+    }
+
+    // The input is read from the mapping, which the kernel reads ahead
+    if(in_map_.IsMapped() && (out_file != nullptr) && SupportsPositionalIo(out_file) && InitIoRing()) {
+        ZjumpErrorCode ret_code = DecompressWithIoRing(out_file);
+        ReleaseIoRing();
+        in_map_.Unmap();
+        return ret_code;
+    }
+
+    BlockStats io_stats;
+    StageTimer io_timer(&io_stats);
 
     ZjumpErrorCode ret_code = ReadNumBlocks();
     if(ret_code != ZJUMP_NO_ERROR) {
@@ -40,38 +87,93 @@ ZjumpErrorCode Decompressor::Decompress(FILE* in_file, FILE* out_file) {
     uint16_t processed_blocks = 0;
     while(processed_blocks < num_blocks_) {
         out_stream_size_ = 0;
+        if(StageTimer::kEnabled) {
+            io_stats.Clear();
+        }
+        io_timer.Restart();
 
         ret_code = ReadBlock();
         if(ret_code != ZJUMP_NO_ERROR) {
             return ret_code;
         }
+        io_timer.Lap(kStatsStageIo);
 
-        BlockDecompressor block_decomp;
-        ret_code = block_decomp.Decompress(in_stream_, in_stream_size_,
-            out_stream_, &out_stream_size_);
+        uint8_t *out_stream = nullptr;
+        ret_code = block_decomp_.Decompress(in_block_, in_stream_size_,
+            &out_stream, &out_stream_size_);
         if(ret_code != ZJUMP_NO_ERROR) {
             return ret_code;
         }
 
-        size_t written = fwrite(out_stream_, 1, out_stream_size_, out_file);
-        if((written != out_stream_size_) || ferror(out_file)) {
-            return ZJUMP_ERROR_FILE;
+        io_timer.Restart();
+        if(out_file != nullptr) {
+            size_t written = fwrite(out_stream, 1, out_stream_size_, out_file);
+            if((written != out_stream_size_) || ferror(out_file)) {
+                return ZJUMP_ERROR_FILE;
+            }
+        }
+        out_size_ += out_stream_size_;
+        io_timer.Lap(kStatsStageIo);
+
+        if(StageTimer::kEnabled) {
+            BlockStats block_stats = block_decomp_.LastBlockStats();
+            block_stats.stage_nanos[kStatsStageIo] = io_stats.stage_nanos[kStatsStageIo];
+            stats_.AddBlock(block_stats);
         }
 
         ++processed_blocks;
     }
 
-    if(AnyRemainingData(in_file)) {
+    const bool remaining_data = AnyRemainingData();
+    in_map_.Unmap();
+
+    if(remaining_data) {
         return ZJUMP_ERROR_FORMAT_STREAM_TOO_LARGE;
     }
 
     return ZJUMP_NO_ERROR;
 }
 
-ZjumpErrorCode Decompressor::ReadNumBlocks() {
-    size_t read = fread(&num_blocks_, 2, 1, in_file_);
+size_t Decompressor::CompressedSize() const {
+    return in_size_;
+}
+
+size_t Decompressor::DecompressedSize() const {
+    return out_size_;
+}
+
+const StreamStats& Decompressor::Stats() const {
+    return stats_;
+}
+
+size_t Decompressor::MemoryFootprint() const {
+    size_t size = sizeof(*this);
+
+    size += block_decomp_.MemoryFootprint() - sizeof(block_decomp_);
+    size += stats_.MemoryFootprint() - sizeof(stats_);
+    size += block_index_.MemoryFootprint() - sizeof(block_index_);
+    size += block_stats_.capacity() * sizeof(BlockStats);
+
+    return size;
+}
+
+ZjumpErrorCode Decompressor::ReadInput(void* data, size_t size) {
+    if(in_map_.IsMapped()) {
+        if(size > in_map_.Size() - in_map_pos_) {
+            return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
+        }
+
+        std::memcpy(data, in_map_.Data() + in_map_pos_, size);
+        in_map_pos_ += size;
+        in_size_ += size;
 
-    if(read != 1) {
+        return ZJUMP_NO_ERROR;
+    }
+
+    size_t read = fread(data, 1, size, in_file_);
+    in_size_ += read;
+
+    if(read != size) {
         if(ferror(in_file_)) {
             return ZJUMP_ERROR_FILE;
         } else {
@@ -79,6 +181,15 @@ ZjumpErrorCode Decompressor::ReadNumBlocks() {
         }
     }
 
+    return ZJUMP_NO_ERROR;
+}
+
+ZjumpErrorCode Decompressor::ReadNumBlocks() {
+    ZjumpErrorCode ret_code = ReadInput(&num_blocks_, 2);
+    if(ret_code != ZJUMP_NO_ERROR) {
+        return ret_code;
+    }
+
     if(num_blocks_ == 0) {
         return ZJUMP_ERROR_FORMAT_NUM_BLOCKS;
     }
@@ -87,35 +198,307 @@ ZjumpErrorCode Decompressor::ReadNumBlocks() {
 }
 
 ZjumpErrorCode Decompressor::ReadBlock() {
-    size_t read = fread(&in_stream_size_, 3, 1, in_file_);
+    uint32_t block_length_field = 0;
 
-    if(read != 1) {
-        if(ferror(in_file_)) {
+    ZjumpErrorCode ret_code = ReadInput(&block_length_field, 3);
+    if(ret_code != ZJUMP_NO_ERROR) {
+        return ret_code;
+    }
+
+    in_stream_size_ = block_length_field;
+
+    if((in_stream_size_ == 0) || (in_stream_size_ > kBlockMaxCompressedStreamSize)) {
+        return ZJUMP_ERROR_FORMAT_BLOCK_LENGTH;
+    }
+
+    // The block is decoded straight from the mapping, unless it is too close
+    // to its end
+    if( in_map_.IsMapped() &&
+        (in_map_.Size() - in_map_pos_ >= in_stream_size_ + kBlockReadPaddingBytes)) {
+        in_block_ = in_map_.Data() + in_map_pos_;
+        in_map_pos_ += in_stream_size_;
+        in_size_ += in_stream_size_;
+        return ZJUMP_NO_ERROR;
+    }
+
+    DecoderScratch *scratch = block_decomp_.Scratch();
+    uint8_t *in_stream = (scratch != nullptr) ? scratch->InStream(in_stream_size_) : nullptr;
+    if(in_stream == nullptr) {
+        return ZJUMP_ERROR_MEMORY_ALLOC;
+    }
+
+    in_block_ = in_stream;
+    return ReadInput(in_stream, in_stream_size_);
+}
+
+bool Decompressor::AnyRemainingData() {
+    if(in_map_.IsMapped()) {
+        return in_map_pos_ < in_map_.Size();
+    }
+
+    uint8_t single_byte;
+    return fread(&single_byte, 1, 1, in_file_) == 1;
+}
+
+bool Decompressor::InitIoRing() {
+    if(io_ring_.IsOpen()) {
+        return true;
+    }
+
+    if(!io_ring_.Init(kIoRingBlocks)) {
+        return false;
+    }
+
+    struct iovec buffers[kIoRingBlocks];
+
+    for(unsigned i=0; i<kIoRingBlocks; ++i) {
+        if(ring_out_streams_[i] == nullptr) {
+            ring_out_streams_[i] = Allocate<uint8_t>(allocator_, kBlockMaxExpandedStreamSize);
+            if(ring_out_streams_[i] == nullptr) {
+                // Blocks are written with stdio instead
+                ReleaseIoRing();
+                return false;
+            }
+        }
+
+        ring_writes_[i].buffer_index = i;
+        buffers[i].iov_base = ring_out_streams_[i];
+        buffers[i].iov_len = kBlockMaxExpandedStreamSize;
+    }
+
+    // Unregistered buffers work too, just a bit slower
+    io_ring_.RegisterBuffers(buffers, kIoRingBlocks);
+
+    return true;
+}
+
+// The ring and its buffers (kIoRingBlocks full-size blocks) are only held
+// while a stream is decompressed, so an idle context stays small.
+void Decompressor::ReleaseIoRing() {
+    io_ring_.Close();
+
+    for(unsigned i=0; i<kIoRingBlocks; ++i) {
+        Deallocate<uint8_t>(allocator_, ring_out_streams_[i], kBlockMaxExpandedStreamSize);
+        ring_out_streams_[i] = nullptr;
+    }
+}
+
+ZjumpErrorCode Decompressor::DecompressWithIoRing(FILE* out_file) {
+    ZjumpErrorCode ret_code = RunIoRing(out_file);
+
+    // No request is left in flight, even after an error
+    for(unsigned i=0; i<kIoRingBlocks; ++i) {
+        io_ring_.Wait(&ring_writes_[i]);
+    }
+
+    return ret_code;
+}
+
+// Every block is written while the next ones are decompressed, up to
+// kIoRingBlocks writes in flight.
+ZjumpErrorCode Decompressor::RunIoRing(FILE* out_file) {
+    if(fflush(out_file) != 0) {
+        return ZJUMP_ERROR_FILE;
+    }
+
+    const int out_fd = fileno(out_file);
+    const off_t out_start = ftello(out_file);
+    off_t out_offset = out_start;
+
+    ZjumpErrorCode ret_code = ReadNumBlocks();
+    if(ret_code != ZJUMP_NO_ERROR) {
+        return ret_code;
+    }
+
+    for(uint16_t i=0; i<num_blocks_; ++i) {
+        IoRequest &write = ring_writes_[i % kIoRingBlocks];
+        uint8_t *out = ring_out_streams_[i % kIoRingBlocks];
+
+        BlockStats io_stats;
+        StageTimer io_timer(&io_stats);
+
+        ret_code = ReadBlock();
+        if(ret_code != ZJUMP_NO_ERROR) {
+            return ret_code;
+        }
+
+        // The block kIoRingBlocks behind must be written before its buffer
+        // is reused
+        if((i >= kIoRingBlocks) && !io_ring_.Wait(&write)) {
             return ZJUMP_ERROR_FILE;
-        } else {
-            return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
+        }
+        io_timer.Lap(kStatsStageIo);
+
+        size_t out_size = 0;
+        ret_code = block_decomp_.Decompress(in_block_, in_stream_size_, out, &out_size);
+        if(ret_code != ZJUMP_NO_ERROR) {
+            return ret_code;
+        }
+
+        io_timer.Restart();
+        write.fd = out_fd;
+        write.data = out;
+        write.size = out_size;
+        write.offset = out_offset;
+        write.write = true;
+        if(!io_ring_.Start(&write)) {
+            return ZJUMP_ERROR_FILE;
+        }
+        out_offset += static_cast<off_t>(out_size);
+        io_timer.Lap(kStatsStageIo);
+
+        if(StageTimer::kEnabled) {
+            BlockStats block_stats = block_decomp_.LastBlockStats();
+            block_stats.stage_nanos[kStatsStageIo] = io_stats.stage_nanos[kStatsStageIo];
+            stats_.AddBlock(block_stats);
         }
     }
 
-    if(in_stream_size_ == 0) {
-        return ZJUMP_ERROR_FORMAT_BLOCK_LENGTH;
+    for(unsigned i=0; i<std::min<unsigned>(num_blocks_, kIoRingBlocks); ++i) {
+        if(!io_ring_.Wait(&ring_writes_[i])) {
+            return ZJUMP_ERROR_FILE;
+        }
     }
 
-    read = fread(in_stream_, 1, in_stream_size_, in_file_);
+    if(AnyRemainingData()) {
+        return ZJUMP_ERROR_FORMAT_STREAM_TOO_LARGE;
+    }
 
-    if(read != in_stream_size_) {
-        if(ferror(in_file_)) {
+    if(fseeko(out_file, out_offset, SEEK_SET) != 0) {
+        return ZJUMP_ERROR_FILE;
+    }
+    out_size_ = static_cast<size_t>(out_offset - out_start);
+
+    return ZJUMP_NO_ERROR;
+}
+
+// Every block but the last one expands to kBlockMaxExpandedStreamSize bytes,
+// so its offset in the output is known beforehand. Once the blocks are
+// indexed, they are decompressed by several threads and written in place,
+// in any order, without going through the FILE object.
+ZjumpErrorCode Decompressor::DecompressInParallel(FILE* out_file) {
+    ZjumpErrorCode ret_code = block_index_.Build(in_map_.Data(), in_map_.Size(), &block_decomp_);
+    if(ret_code != ZJUMP_NO_ERROR) {
+        return ret_code;
+    }
+
+    out_fd_ = -1;
+    out_offset_ = 0;
+
+    if(out_file != nullptr) {
+        if(fflush(out_file) != 0) {
             return ZJUMP_ERROR_FILE;
-        } else {
-            return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
         }
+
+        out_fd_ = fileno(out_file);
+        out_offset_ = ftello(out_file);
+
+        // Allocating the whole output upfront keeps the file from being
+        // extended out of order. Where the file system does not support it,
+        // the writes extend the file anyway.
+        const off_t max_out_size = static_cast<off_t>(block_index_.NumBlocks()) * kBlockMaxExpandedStreamSize;
+        fallocate(out_fd_, 0, out_offset_, max_out_size);
+    }
+
+    block_stats_.assign(StageTimer::kEnabled ? block_index_.NumBlocks() : 0, BlockStats());
+    next_block_ = 0;
+    error_ = ZJUMP_NO_ERROR;
+
+    const size_t num_threads = std::min(static_cast<size_t>(num_threads_), block_index_.NumBlocks());
+    std::vector<std::thread> threads;
+
+    for(size_t t=1; t<num_threads; ++t) {
+        threads.push_back(std::thread(&Decompressor::DecompressIndexedBlocks, this));
+    }
+
+    DecompressIndexedBlocks();
+
+    for(size_t t=0; t<threads.size(); ++t) {
+        threads[t].join();
+    }
+
+    for(size_t i=0; i<block_stats_.size(); ++i) {
+        stats_.AddBlock(block_stats_[i]);
+    }
+
+    ret_code = static_cast<ZjumpErrorCode>(error_.load());
+    if(ret_code != ZJUMP_NO_ERROR) {
+        return ret_code;
+    }
+
+    in_size_ = in_map_.Size();
+
+    if(out_file == nullptr) {
+        return ZJUMP_NO_ERROR;
+    }
+
+    // Drops the space allocated past the last block
+    const off_t out_end = out_offset_ + static_cast<off_t>(out_size_);
+    if((ftruncate(out_fd_, out_end) != 0) || (fseeko(out_file, out_end, SEEK_SET) != 0)) {
+        return ZJUMP_ERROR_FILE;
     }
 
     return ZJUMP_NO_ERROR;
 }
 
-bool Decompressor::AnyRemainingData(FILE* file) {
-    uint8_t single_byte;
-    return fread(&single_byte, 1, 1, file) == 1;
+void Decompressor::DecompressIndexedBlocks() {
+    BlockDecompressor block_decomp(allocator_);
+    DecoderScratch *scratch = block_decomp.Scratch();
+    if(scratch == nullptr) {
+        SetError(ZJUMP_ERROR_MEMORY_ALLOC);
+        return;
+    }
+
+    uint8_t *in_copy = scratch->InStream(kBlockMaxCompressedStreamSize);
+    uint8_t *out = scratch->OutStream(kBlockMaxExpandedStreamSize);
+    if((in_copy == nullptr) || (out == nullptr)) {
+        SetError(ZJUMP_ERROR_MEMORY_ALLOC);
+        return;
+    }
+    size_t loaded_tables = kNoTablesBlock;
+
+    BlockStats io_stats;
+    StageTimer io_timer(&io_stats);
+
+    while(error_ == ZJUMP_NO_ERROR) {
+        const size_t i = next_block_++;
+        if(i >= block_index_.NumBlocks()) {
+            break;
+        }
+
+        size_t out_size = 0;
+        ZjumpErrorCode ret_code = block_index_.DecompressBlock(i, &block_decomp, &loaded_tables,
+            in_copy, out, &out_size);
+        if(ret_code != ZJUMP_NO_ERROR) {
+            SetError(ret_code);
+            break;
+        }
+
+        if(StageTimer::kEnabled) {
+            io_stats.Clear();
+        }
+        io_timer.Restart();
+
+        const off_t offset = static_cast<off_t>(i) * kBlockMaxExpandedStreamSize;
+        if((out_fd_ >= 0) && !WriteAt(out_fd_, out, out_size, out_offset_ + offset)) {
+            SetError(ZJUMP_ERROR_FILE);
+            break;
+        }
+        io_timer.Lap(kStatsStageIo);
+
+        if(i + 1 == block_index_.NumBlocks()) {
+            out_size_ = static_cast<size_t>(offset) + out_size;
+        }
+
+        if(StageTimer::kEnabled) {
+            block_stats_[i] = block_decomp.LastBlockStats();
+            block_stats_[i].stage_nanos[kStatsStageIo] = io_stats.stage_nanos[kStatsStageIo];
+        }
+    }
 }
 
+// Only the first error is kept.
+void Decompressor::SetError(ZjumpErrorCode ret_code) {
+    int expected = ZJUMP_NO_ERROR;
+    error_.compare_exchange_strong(expected, ret_code);
+}
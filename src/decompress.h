@@ -7,32 +7,116 @@
 #ifndef DECOMPRESS_H_
 #define DECOMPRESS_H_
 
+#include <atomic>
 #include <cstdint>
 #include <cstdio>
+#include <sys/types.h>
+#include <vector>
 
+#include "block_decompressor.h"
+#include "block_index.h"
 #include "constants.h"
+#include "io_ring.h"
+#include "mapped_file.h"
+#include "mem.h"
+#include "stats.h"
 
+// Decompressor class
+//
+// Between calls to Decompress, a context only keeps the Huffman decoders of
+// the last stream (see BlockDecompressor) and its stats. The io_uring ring
+// and the buffers of the blocks it writes are only held during a call. The
+// buffers of the block being decompressed belong to the DecoderScratch of the
+// calling thread, which is shared by every context used on that thread.
+//
+// Memory is allocated with allocator, or with the default one when it is
+// null. A context with any other allocator has a scratch of its own, and
+// one more for every thread that decompresses in parallel. Allocation
+// failures make Decompress fail with ZJUMP_ERROR_MEMORY_ALLOC.
 class Decompressor {
 public:
-    Decompressor();
+    explicit Decompressor(const ZjumpAllocator* allocator = nullptr);
 
     ~Decompressor();
 
+    // With more than one thread (1 by default), a regular input file is
+    // decompressed in parallel when out_file is a regular file as well:
+    // every block is written at its final offset as soon as it is ready.
+    // Otherwise blocks are decompressed and written in order.
+    void SetNumThreads(int num_threads);
+
+    // Without out_file, every block is fully decompressed and then
+    // discarded, which tests the integrity of the stream.
     ZjumpErrorCode Decompress(FILE* in_file, FILE* out_file);
 
+    // Number of bytes of the last stream, and bytes it expanded to.
+    size_t CompressedSize() const;
+
+    size_t DecompressedSize() const;
+
+    // Stats of every block of the last stream. They are only measured in
+    // builds with ZJUMP_STATS.
+    const StreamStats& Stats() const;
+
+    // Bytes held by the context. The scratch of every thread is not counted
+    // (see DecoderScratch::MemoryFootprint), unless it belongs to the context.
+    size_t MemoryFootprint() const;
+
 private:
-    uint8_t *in_stream_;
-    uint8_t *out_stream_;
+    // The current block: either in the scratch of the thread or a pointer
+    // into in_map_
+    const ZjumpAllocator *allocator_;
+    const uint8_t *in_block_;
     size_t in_stream_size_;
     size_t out_stream_size_;
     FILE *in_file_;
+    // Regular input files are mapped, and the rest read with stdio
+    MappedFile in_map_;
+    size_t in_map_pos_;
+    size_t in_size_;
     uint16_t num_blocks_;
+    StreamStats stats_;
+    BlockDecompressor block_decomp_;
+    int num_threads_;
+    // Blocks written asynchronously, each one from its own buffer
+    IoRing io_ring_;
+    uint8_t *ring_out_streams_[kIoRingBlocks];
+    IoRequest ring_writes_[kIoRingBlocks];
+    // Parallel decompression
+    BlockIndex block_index_;
+    std::vector<BlockStats> block_stats_;
+    std::atomic<size_t> next_block_;
+    std::atomic<int> error_;
+    // -1 when blocks are only tested
+    int out_fd_;
+    off_t out_offset_;
+    size_t out_size_;
+
+    // Reads size bytes of the input into data.
+    ZjumpErrorCode ReadInput(void* data, size_t size);
 
     ZjumpErrorCode ReadNumBlocks();
 
     ZjumpErrorCode ReadBlock();
 
-    bool AnyRemainingData(FILE* file);
+    bool AnyRemainingData();
+
+    // Sets up io_ring_ and ring_out_streams_ for a stream.
+    bool InitIoRing();
+
+    void ReleaseIoRing();
+
+    ZjumpErrorCode DecompressWithIoRing(FILE* out_file);
+
+    ZjumpErrorCode RunIoRing(FILE* out_file);
+
+    ZjumpErrorCode DecompressInParallel(FILE* out_file);
+
+    // Body of every decompression thread: takes the next block until there
+    // are no more blocks or one of them fails.
+    void DecompressIndexedBlocks();
+
+    void SetError(ZjumpErrorCode ret_code);
 };
 
 #endif // DECOMPRESS_H_
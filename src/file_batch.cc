@@ -0,0 +1,423 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include "file_batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "block_compressor.h"
+#include "block_decompressor.h"
+#include "block_index.h"
+#include "compress.h"
+#include "decompress.h"
+#include "io_ring.h"
+#include "mapped_file.h"
+#include "mem.h"
+
+struct FileBatch::Job {
+    std::string in_name;
+    std::string out_name;
+    FILE *in_file;
+    FILE *out_file;
+    MappedFile in_map;
+    size_t num_blocks;
+    size_t num_segments;
+    std::atomic<size_t> segments_left;
+    // Guards error and the compressed segments
+    std::mutex mutex;
+    ZjumpErrorCode error;
+    // Compression: segments done but not written yet
+    std::vector<std::vector<uint8_t>> segments;
+    std::vector<bool> segment_ready;
+    size_t next_segment;
+    // Decompression
+    BlockIndex index;
+    // Reported in the results
+    size_t in_size;
+    size_t out_size;
+    std::chrono::steady_clock::time_point start;
+    double seconds;
+
+    Job() {
+        in_file = nullptr;
+        out_file = nullptr;
+        num_blocks = 0;
+        num_segments = 0;
+        segments_left = 0;
+        error = ZJUMP_NO_ERROR;
+        next_segment = 0;
+        in_size = 0;
+        out_size = 0;
+        seconds = 0;
+    }
+
+    bool HasError() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return error != ZJUMP_NO_ERROR;
+    }
+
+    // Only the first error is kept.
+    void SetError(ZjumpErrorCode ret_code) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(error == ZJUMP_NO_ERROR) {
+            error = ret_code;
+        }
+    }
+};
+
+// Everything a thread needs to process a block of any file.
+struct FileBatch::ThreadContext {
+    std::unique_ptr<BlockCompressor> block_comp;
+    std::unique_ptr<BlockDecompressor> block_decomp;
+    uint8_t *in;
+    uint8_t *out;
+
+    explicit ThreadContext(BatchMode mode) {
+        if(mode == kBatchCompress) {
+            block_comp.reset(new BlockCompressor());
+            // The pool already runs a block per thread
+            block_comp->SetNumThreads(1);
+            in = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+            out = SecureAlloc<uint8_t>(kBlockMaxCompressedStreamSize);
+        } else {
+            block_decomp.reset(new BlockDecompressor());
+            in = SecureAlloc<uint8_t>(kBlockMaxCompressedStreamSize);
+            out = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+        }
+    }
+
+    ~ThreadContext() {
+        SecureFree<uint8_t>(in);
+        SecureFree<uint8_t>(out);
+    }
+};
+
+FileBatch::FileBatch(BatchMode mode, int num_threads) : pool_(num_threads) {
+    mode_ = mode;
+    keep_input_ = false;
+
+    for(int t=0; t<num_threads; ++t) {
+        contexts_.push_back(std::unique_ptr<ThreadContext>(new ThreadContext(mode)));
+    }
+}
+
+FileBatch::~FileBatch() {}
+
+void FileBatch::SetKeepInput(bool keep_input) {
+    keep_input_ = keep_input;
+}
+
+void FileBatch::Add(const std::string& in_name, const std::string& out_name) {
+    jobs_.push_back(std::unique_ptr<Job>(new Job()));
+    jobs_.back()->in_name = in_name;
+    jobs_.back()->out_name = out_name;
+}
+
+ZjumpErrorCode FileBatch::Run() {
+    for(size_t i=0; i<jobs_.size(); ++i) {
+        Job *job = jobs_[i].get();
+        pool_.Add([this, job](int thread) { OpenFile(job, thread); });
+    }
+
+    pool_.Run();
+
+    ZjumpErrorCode ret_code = ZJUMP_NO_ERROR;
+    results_.clear();
+
+    for(size_t i=0; i<jobs_.size(); ++i) {
+        const Job &job = *jobs_[i];
+
+        BatchFileResult result;
+        result.in_name = job.in_name;
+        result.out_name = job.out_name;
+        result.error = job.error;
+        result.in_size = job.in_size;
+        result.out_size = job.out_size;
+        result.seconds = job.seconds;
+        results_.push_back(result);
+
+        if(ret_code == ZJUMP_NO_ERROR) {
+            ret_code = job.error;
+        }
+    }
+
+    jobs_.clear();
+
+    return ret_code;
+}
+
+const std::vector<BatchFileResult>& FileBatch::Results() const {
+    return results_;
+}
+
+// Files are opened by the pool as well, so only the ones being processed are
+// open at any time.
+void FileBatch::OpenFile(Job* job, int thread) {
+    job->start = std::chrono::steady_clock::now();
+
+    job->in_file = fopen(job->in_name.c_str(), "rb");
+    if(job->in_file == nullptr) {
+        perror(job->in_name.c_str());
+        job->error = ZJUMP_ERROR_FILE;
+        FinishFile(job);
+        return;
+    }
+
+    if(mode_ != kBatchTest) {
+        job->out_file = fopen(job->out_name.c_str(), "wb");
+        if(job->out_file == nullptr) {
+            perror(job->out_name.c_str());
+            job->error = ZJUMP_ERROR_FILE;
+            FinishFile(job);
+            return;
+        }
+    }
+
+    ZjumpErrorCode ret_code = ZJUMP_NO_ERROR;
+
+    if(job->in_map.Map(job->in_file)) {
+        job->in_size = job->in_map.Size();
+    }
+
+    if(!job->in_map.IsMapped() || ((job->out_file != nullptr) && !SupportsPositionalIo(job->out_file))) {
+        ret_code = ProcessSerially(job);
+    } else if(mode_ == kBatchCompress) {
+        ret_code = StartCompression(job, thread);
+    } else {
+        ret_code = StartDecompression(job, thread);
+    }
+
+    // Otherwise the last segment finishes the file
+    if((ret_code != ZJUMP_NO_ERROR) || (job->num_segments == 0)) {
+        job->error = ret_code;
+        FinishFile(job);
+    }
+}
+
+ZjumpErrorCode FileBatch::ProcessSerially(Job* job) {
+    job->in_map.Unmap();
+
+    ZjumpErrorCode ret_code;
+
+    if(mode_ == kBatchCompress) {
+        Compressor compressor;
+        ret_code = compressor.Compress(job->in_file, job->out_file);
+
+        // Unknown for pipes
+        const off_t in_end = ftello(job->in_file);
+        const off_t out_end = ftello(job->out_file);
+        if(in_end > 0) {
+            job->in_size = static_cast<size_t>(in_end);
+        }
+        job->out_size = (out_end > 0) ? static_cast<size_t>(out_end) : 0;
+    } else {
+        Decompressor decompressor;
+        ret_code = decompressor.Decompress(job->in_file, job->out_file);
+        job->in_size = decompressor.CompressedSize();
+        job->out_size = decompressor.DecompressedSize();
+    }
+
+    return ret_code;
+}
+
+ZjumpErrorCode FileBatch::StartCompression(Job* job, int thread) {
+    job->num_blocks = (job->in_map.Size() + kBlockMaxExpandedStreamSize - 1) / kBlockMaxExpandedStreamSize;
+    job->num_segments = (job->num_blocks + kBatchSegmentBlocks - 1) / kBatchSegmentBlocks;
+    job->segments.resize(job->num_segments);
+    job->segment_ready.assign(job->num_segments, false);
+    job->next_segment = 0;
+    job->segments_left = job->num_segments;
+
+    // The number of blocks is written when the file is finished
+    const uint16_t zero = 0;
+    if(fwrite(&zero, 2, 1, job->out_file) != 1) {
+        return ZJUMP_ERROR_FILE;
+    }
+    job->out_size = 2;
+
+    pool_.Add([this, job](int t) { CompressSegment(job, 0, t); }, thread);
+
+    return ZJUMP_NO_ERROR;
+}
+
+ZjumpErrorCode FileBatch::StartDecompression(Job* job, int thread) {
+    ZjumpErrorCode ret_code = job->index.Build(job->in_map.Data(), job->in_map.Size(),
+                                               contexts_[thread]->block_decomp.get());
+    if(ret_code != ZJUMP_NO_ERROR) {
+        return ret_code;
+    }
+
+    job->num_blocks = job->index.NumBlocks();
+    job->num_segments = (job->num_blocks + kBatchSegmentBlocks - 1) / kBatchSegmentBlocks;
+    job->segments_left = job->num_segments;
+
+    // Blocks are written in place, so the whole output is allocated upfront
+    if(job->out_file != nullptr) {
+        fallocate(fileno(job->out_file), 0, 0,
+                  static_cast<off_t>(job->num_blocks) * kBlockMaxExpandedStreamSize);
+    }
+
+    pool_.Add([this, job](int t) { DecompressSegment(job, 0, t); }, thread);
+
+    return ZJUMP_NO_ERROR;
+}
+
+// Every segment queues the next one before starting, so the segments of a
+// file are taken in order, and at most one per thread is in flight.
+void FileBatch::CompressSegment(Job* job, size_t segment, int thread) {
+    if(segment + 1 < job->num_segments) {
+        pool_.Add([this, job, segment](int t) { CompressSegment(job, segment + 1, t); }, thread);
+    }
+
+    ThreadContext &context = *contexts_[thread];
+    std::vector<uint8_t> &compressed = job->segments[segment];
+
+    if(!job->HasError()) {
+        const size_t in_size = job->in_map.Size();
+        const size_t first_block = segment * kBatchSegmentBlocks;
+        const size_t last_block = std::min(first_block + kBatchSegmentBlocks, job->num_blocks);
+
+        // A segment does not reuse the Huffman encodings of the previous one
+        context.block_comp->Reset();
+
+        for(size_t b=first_block; b<last_block; ++b) {
+            const size_t offset = b * kBlockMaxExpandedStreamSize;
+            const size_t size = std::min(kBlockMaxExpandedStreamSize, in_size - offset);
+            size_t out_size = 0;
+
+            std::copy(job->in_map.Data() + offset, job->in_map.Data() + offset + size, context.in);
+
+            ZjumpErrorCode ret_code = context.block_comp->Compress(context.in, size, context.out, &out_size);
+            if(ret_code != ZJUMP_NO_ERROR) {
+                job->SetError(ret_code);
+                break;
+            }
+
+            const uint32_t block_length_field = static_cast<uint32_t>(out_size);
+            const uint8_t *field = reinterpret_cast<const uint8_t*>(&block_length_field);
+            compressed.insert(compressed.end(), field, field + 3);
+            compressed.insert(compressed.end(), context.out, context.out + out_size);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->segment_ready[segment] = true;
+        WriteReadySegments(job);
+    }
+
+    FinishSegment(job);
+}
+
+void FileBatch::DecompressSegment(Job* job, size_t segment, int thread) {
+    if(segment + 1 < job->num_segments) {
+        pool_.Add([this, job, segment](int t) { DecompressSegment(job, segment + 1, t); }, thread);
+    }
+
+    ThreadContext &context = *contexts_[thread];
+
+    if(!job->HasError()) {
+        const int out_fd = (job->out_file != nullptr) ? fileno(job->out_file) : -1;
+        const size_t first_block = segment * kBatchSegmentBlocks;
+        const size_t last_block = std::min(first_block + kBatchSegmentBlocks, job->num_blocks);
+        size_t loaded_tables = kNoTablesBlock;
+
+        for(size_t b=first_block; b<last_block; ++b) {
+            size_t out_size = 0;
+
+            ZjumpErrorCode ret_code = job->index.DecompressBlock(b, context.block_decomp.get(), &loaded_tables,
+                context.in, context.out, &out_size);
+            if(ret_code != ZJUMP_NO_ERROR) {
+                job->SetError(ret_code);
+                break;
+            }
+
+            const off_t offset = static_cast<off_t>(b) * kBlockMaxExpandedStreamSize;
+            if((out_fd >= 0) && !WriteAt(out_fd, context.out, out_size, offset)) {
+                job->SetError(ZJUMP_ERROR_FILE);
+                break;
+            }
+
+            if(b + 1 == job->num_blocks) {
+                job->out_size = static_cast<size_t>(offset) + out_size;
+            }
+        }
+    }
+
+    FinishSegment(job);
+}
+
+// Writes the segments that are done, in order. The job mutex must be held.
+void FileBatch::WriteReadySegments(Job* job) {
+    while((job->next_segment < job->num_segments) && job->segment_ready[job->next_segment]) {
+        std::vector<uint8_t> &compressed = job->segments[job->next_segment];
+
+        if(job->error == ZJUMP_NO_ERROR) {
+            size_t written = fwrite(compressed.data(), 1, compressed.size(), job->out_file);
+            if(written != compressed.size()) {
+                job->error = ZJUMP_ERROR_FILE;
+            }
+            job->out_size += written;
+        }
+
+        std::vector<uint8_t>().swap(compressed);
+        ++job->next_segment;
+    }
+}
+
+void FileBatch::FinishSegment(Job* job) {
+    if(--job->segments_left == 0) {
+        FinishFile(job);
+    }
+}
+
+void FileBatch::FinishFile(Job* job) {
+    if((job->error == ZJUMP_NO_ERROR) && (job->num_segments > 0)) {
+        if(mode_ == kBatchCompress) {
+            const uint16_t num_blocks = static_cast<uint16_t>(job->num_blocks);
+
+            if((fseeko(job->out_file, 0, SEEK_SET) != 0) || (fwrite(&num_blocks, 2, 1, job->out_file) != 1)) {
+                job->error = ZJUMP_ERROR_FILE;
+            }
+        } else if( (mode_ == kBatchDecompress) &&
+                   (ftruncate(fileno(job->out_file), static_cast<off_t>(job->out_size)) != 0)) {
+            // Drops the space allocated past the last block
+            job->error = ZJUMP_ERROR_FILE;
+        }
+    }
+
+    job->in_map.Unmap();
+    job->index.Clear();
+
+    if(job->in_file != nullptr) {
+        fclose(job->in_file);
+        job->in_file = nullptr;
+    }
+
+    if(job->out_file != nullptr) {
+        if((fclose(job->out_file) != 0) && (job->error == ZJUMP_NO_ERROR)) {
+            job->error = ZJUMP_ERROR_FILE;
+        }
+        job->out_file = nullptr;
+    }
+
+    job->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - job->start).count();
+
+    if((job->error == ZJUMP_NO_ERROR) && !keep_input_ && (mode_ != kBatchTest)) {
+        if(remove(job->in_name.c_str()) != 0) {
+            perror(job->in_name.c_str());
+            job->error = ZJUMP_ERROR_FILE;
+        }
+    }
+}
@@ -0,0 +1,108 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#ifndef FILE_BATCH_H_
+#define FILE_BATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "constants.h"
+#include "work_stealing_pool.h"
+
+// Number of consecutive blocks of a file that a thread of FileBatch
+// compresses or decompresses at once. A compressed segment starts with fresh
+// Huffman encodings, so it cannot be too short.
+static const size_t kBatchSegmentBlocks = 8;
+
+typedef enum {
+    kBatchCompress,
+    kBatchDecompress,
+    // Decompresses every block and discards it
+    kBatchTest
+} BatchMode;
+
+struct BatchFileResult {
+    std::string in_name;
+    std::string out_name;
+    ZjumpErrorCode error;
+    // Bytes read and written (or, when testing, decompressed), and the time
+    // from opening the file to closing it
+    size_t in_size;
+    size_t out_size;
+    double seconds;
+};
+
+// FileBatch class
+//
+// Compresses or decompresses many files at once on a WorkStealingPool. Every
+// file is split into segments of kBatchSegmentBlocks blocks, and the
+// segments of all the files are spread over the same threads, so a large
+// file keeps every thread busy once the small ones are done, and the other
+// way round.
+//
+// The pool owns the parallelism: each thread sorts the suffixes of its blocks
+// on its own, without the OpenMP team of ParallelBwtEngine.
+//
+// When compressing, a segment is written as soon as the ones before it are.
+// When decompressing, every block is written at its final offset, and when
+// testing, it is not written at all. Files that cannot be mapped (pipes,
+// devices) or written at any offset are processed as a whole by a single
+// thread.
+class FileBatch {
+public:
+    FileBatch(BatchMode mode, int num_threads);
+
+    ~FileBatch();
+
+    // The input files are removed once processed, unless keep_input. They
+    // are always kept when testing.
+    void SetKeepInput(bool keep_input);
+
+    // out_name is not used when testing.
+    void Add(const std::string& in_name, const std::string& out_name = std::string());
+
+    // Processes every file, and returns the first error, if any. The others
+    // are in Results.
+    ZjumpErrorCode Run();
+
+    const std::vector<BatchFileResult>& Results() const;
+
+private:
+    struct Job;
+    struct ThreadContext;
+
+    BatchMode mode_;
+    bool keep_input_;
+    WorkStealingPool pool_;
+    std::vector<std::unique_ptr<Job>> jobs_;
+    std::vector<std::unique_ptr<ThreadContext>> contexts_;
+    std::vector<BatchFileResult> results_;
+
+    void OpenFile(Job* job, int thread);
+
+    ZjumpErrorCode StartCompression(Job* job, int thread);
+
+    ZjumpErrorCode StartDecompression(Job* job, int thread);
+
+    // Processes a whole file on the calling thread.
+    ZjumpErrorCode ProcessSerially(Job* job);
+
+    void CompressSegment(Job* job, size_t segment, int thread);
+
+    void DecompressSegment(Job* job, size_t segment, int thread);
+
+    void WriteReadySegments(Job* job);
+
+    void FinishSegment(Job* job);
+
+    void FinishFile(Job* job);
+};
+
+#endif // FILE_BATCH_H_
@@ -0,0 +1,443 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include "fse.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "mem.h"
+
+static const uint8_t kFseTableLogFieldSize  = 3;
+static const uint8_t kFseMaxSymbolFieldSize = 8;
+
+// Position of the highest bit set in v, which must not be zero.
+static uint8_t HighBit(uint32_t v) {
+    uint8_t bit = 0;
+    while(v >>= 1) {
+        ++bit;
+    }
+    return bit;
+}
+
+// Symbols are spread over the table with an odd step, which visits every
+// position once since the table size is a power of two.
+static void SpreadSymbols(const FseDistribution& distribution,
+                          uint8_t* spread) {
+    const uint32_t table_size = 1u << distribution.TableLog();
+    const uint32_t step = (table_size >> 1) + (table_size >> 3) + 3;
+    const uint32_t mask = table_size - 1;
+    uint32_t pos = 0;
+
+    for(uint16_t s=0; s<=distribution.MaxSymbol(); ++s) {
+        for(uint16_t i=0; i<distribution.Count(s); ++i) {
+            spread[pos] = static_cast<uint8_t>(s);
+            pos = (pos + step) & mask;
+        }
+    }
+}
+
+// Counts are written as Elias gamma codes of count + 1: as many zero bits as
+// the position of the highest bit, a one bit and the bits below it.
+static size_t GammaLength(uint32_t v) {
+    return 2u * HighBit(v) + 1u;
+}
+
+static bool WriteGamma(uint32_t v, BitStreamWriter* writer) {
+    const uint8_t high_bit = HighBit(v);
+
+    if(high_bit > 0 && writer->Append(0, high_bit) != high_bit) {
+        return false;
+    }
+
+    if(writer->Append(1, 1) != 1) {
+        return false;
+    }
+
+    if(high_bit > 0 && writer->Append(v, high_bit) != high_bit) {
+        return false;
+    }
+
+    return true;
+}
+
+static bool ReadGamma(BitStreamReader& reader, uint32_t* v) {
+    uint8_t high_bit = 0;
+    uint8_t bit = 0;
+
+    while(true) {
+        if(reader.NextPos() >= reader.Size() || reader.ReadNext(1, &bit) != 1) {
+            return false;
+        }
+
+        if(bit == 1) {
+            break;
+        }
+
+        if(++high_bit > kFseMaxTableLog + 1) {
+            return false;
+        }
+    }
+
+    uint32_t low_bits = 0;
+    if(high_bit > 0) {
+        if(reader.NextPos() >= reader.Size() ||
+           reader.ReadNext(high_bit, &low_bits) != high_bit) {
+            return false;
+        }
+    }
+
+    *v = (1u << high_bit) | low_bits;
+
+    return true;
+}
+
+// FseDistribution -------------------------------------------------------------
+
+FseDistribution::FseDistribution() {
+    table_log_ = kFseMinTableLog;
+    max_symbol_ = 0;
+    std::fill_n(counts_, kFseMaxSymbols, 0);
+}
+
+bool FseDistribution::Normalize(const uint32_t* freqs,
+                                const uint16_t num_symbols) {
+    assert(num_symbols <= kFseMaxSymbols);
+
+    uint64_t total = 0;
+    uint32_t num_used = 0;
+
+    std::fill_n(counts_, kFseMaxSymbols, 0);
+    max_symbol_ = 0;
+
+    for(uint16_t s=0; s<num_symbols; ++s) {
+        if(freqs[s] > 0) {
+            total += freqs[s];
+            ++num_used;
+            max_symbol_ = s;
+        }
+    }
+
+    if(total == 0) {
+        return false;
+    }
+
+    // a smaller table for short streams, but large enough to give every
+    // symbol some precision
+    table_log_ = kFseMaxTableLog;
+    while((table_log_ > kFseMinTableLog) && ((1ull << (table_log_ - 1)) >= total)) {
+        --table_log_;
+    }
+    while((table_log_ < kFseMaxTableLog) && ((1u << table_log_) < 4 * num_used)) {
+        ++table_log_;
+    }
+
+    const uint32_t table_size = 1u << table_log_;
+    uint32_t sum = 0;
+    uint16_t largest = 0;
+
+    for(uint16_t s=0; s<=max_symbol_; ++s) {
+        if(freqs[s] == 0) {
+            continue;
+        }
+
+        uint64_t count = (freqs[s] * static_cast<uint64_t>(table_size) + total / 2) / total;
+        counts_[s] = static_cast<uint16_t>(std::max<uint64_t>(count, 1));
+        sum += counts_[s];
+
+        if(counts_[s] > counts_[largest]) {
+            largest = s;
+        }
+    }
+
+    // rounding errors are moved to the largest counts
+    if(sum < table_size) {
+        counts_[largest] += table_size - sum;
+    }
+
+    while(sum > table_size) {
+        largest = 0;
+        for(uint16_t s=1; s<=max_symbol_; ++s) {
+            if(counts_[s] > counts_[largest]) {
+                largest = s;
+            }
+        }
+
+        const uint32_t excess = std::min<uint32_t>(sum - table_size, counts_[largest] / 2);
+        counts_[largest] -= excess;
+        sum -= excess;
+    }
+
+    return true;
+}
+
+uint8_t FseDistribution::TableLog() const {
+    return table_log_;
+}
+
+uint16_t FseDistribution::MaxSymbol() const {
+    return max_symbol_;
+}
+
+uint16_t FseDistribution::Count(const uint16_t symbol) const {
+    return counts_[symbol];
+}
+
+size_t FseDistribution::Length() const {
+    size_t length = kFseTableLogFieldSize + kFseMaxSymbolFieldSize;
+
+    for(uint16_t s=0; s<=max_symbol_; ++s) {
+        length += GammaLength(counts_[s] + 1u);
+    }
+
+    return length;
+}
+
+bool FseDistribution::Write(BitStreamWriter* writer) const {
+    if(writer->Append(table_log_ - kFseMinTableLog, kFseTableLogFieldSize) != kFseTableLogFieldSize) {
+        return false;
+    }
+
+    if(writer->Append(max_symbol_, kFseMaxSymbolFieldSize) != kFseMaxSymbolFieldSize) {
+        return false;
+    }
+
+    for(uint16_t s=0; s<=max_symbol_; ++s) {
+        if(!WriteGamma(counts_[s] + 1u, writer)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool FseDistribution::Read(BitStreamReader& reader) {
+    uint8_t table_log = 0;
+    uint16_t max_symbol = 0;
+
+    if(reader.NextPos() >= reader.Size() ||
+       reader.ReadNext(kFseTableLogFieldSize, &table_log) != kFseTableLogFieldSize) {
+        return false;
+    }
+
+    if(reader.NextPos() >= reader.Size() ||
+       reader.ReadNext(kFseMaxSymbolFieldSize, &max_symbol) != kFseMaxSymbolFieldSize) {
+        return false;
+    }
+
+    table_log_ = table_log + kFseMinTableLog;
+    max_symbol_ = max_symbol;
+
+    if(table_log_ > kFseMaxTableLog) {
+        return false;
+    }
+
+    const uint32_t table_size = 1u << table_log_;
+    uint32_t sum = 0;
+
+    std::fill_n(counts_, kFseMaxSymbols, 0);
+
+    for(uint16_t s=0; s<=max_symbol_; ++s) {
+        uint32_t v = 0;
+        if(!ReadGamma(reader, &v)) {
+            return false;
+        }
+
+        sum += v - 1u;
+        if(sum > table_size) {
+            return false;
+        }
+
+        counts_[s] = static_cast<uint16_t>(v - 1u);
+    }
+
+    return sum == table_size;
+}
+
+// FseEncoder ------------------------------------------------------------------
+
+FseEncoder::FseEncoder(const size_t max_stream_size, const ZjumpAllocator* allocator) :
+    max_stream_size_(max_stream_size),
+    allocator_(AllocatorOrDefault(allocator)) {
+    chunks_ = nullptr;
+    num_chunks_ = 0;
+    final_state_ = 0;
+}
+
+FseEncoder::~FseEncoder() {
+    Deallocate<uint32_t>(allocator_, chunks_, max_stream_size_);
+}
+
+bool FseEncoder::Build(const uint32_t* freqs,
+                       const uint16_t num_symbols) {
+    if(chunks_ == nullptr) {
+        chunks_ = Allocate<uint32_t>(allocator_, max_stream_size_);
+        if(chunks_ == nullptr) {
+            return false;
+        }
+    }
+
+    if(!distribution_.Normalize(freqs, num_symbols)) {
+        return false;
+    }
+
+    const uint8_t table_log = distribution_.TableLog();
+    const uint32_t table_size = 1u << table_log;
+    uint8_t spread[1 << kFseMaxTableLog];
+    uint32_t cumul[kFseMaxSymbols + 1];
+
+    SpreadSymbols(distribution_, spread);
+
+    cumul[0] = 0;
+    for(uint16_t s=0; s<kFseMaxSymbols; ++s) {
+        cumul[s + 1] = cumul[s] + distribution_.Count(s);
+    }
+
+    // states of every symbol, in the order they appear in the table
+    uint32_t next[kFseMaxSymbols];
+    std::copy(cumul, cumul + kFseMaxSymbols, next);
+    for(uint32_t u=0; u<table_size; ++u) {
+        state_table_[next[spread[u]]++] = static_cast<uint16_t>(table_size + u);
+    }
+
+    // A state x in [table_size, 2 * table_size) emits
+    // (x + delta_nb_bits) >> 16 bits for the symbol, and the next state is
+    // found at state_table_[(x >> num_bits) + delta_find_state].
+    for(uint16_t s=0; s<kFseMaxSymbols; ++s) {
+        const uint32_t count = distribution_.Count(s);
+
+        if(count == 0) {
+            delta_nb_bits_[s] = 0;
+            delta_find_state_[s] = 0;
+        } else if(count == 1) {
+            delta_nb_bits_[s] = (static_cast<uint32_t>(table_log) << 16) - table_size;
+            delta_find_state_[s] = static_cast<int32_t>(cumul[s]) - 1;
+        } else {
+            const uint32_t max_bits_out = table_log - HighBit(count - 1);
+            const uint32_t min_state_plus = count << max_bits_out;
+            delta_nb_bits_[s] = (max_bits_out << 16) - min_state_plus;
+            delta_find_state_[s] = static_cast<int32_t>(cumul[s]) - static_cast<int32_t>(count);
+        }
+    }
+
+    return true;
+}
+
+size_t FseEncoder::Encode(const uint8_t* stream,
+                          const size_t stream_size) {
+    assert(stream_size <= max_stream_size_);
+
+    const uint8_t table_log = distribution_.TableLog();
+    uint32_t state = 1u << table_log;
+    size_t length = table_log;
+
+    for(size_t i=stream_size; i>0; --i) {
+        const uint8_t s = stream[i - 1];
+        assert(distribution_.Count(s) > 0);
+
+        const uint32_t num_bits = (state + delta_nb_bits_[s]) >> 16;
+        chunks_[i - 1] = ((state & ((1u << num_bits) - 1u)) << 8) | num_bits;
+        length += num_bits;
+
+        state = state_table_[(state >> num_bits) + delta_find_state_[s]];
+    }
+
+    num_chunks_ = stream_size;
+    final_state_ = state - (1u << table_log);
+
+    return length;
+}
+
+size_t FseEncoder::HeaderLength() const {
+    return distribution_.Length();
+}
+
+bool FseEncoder::WriteHeader(BitStreamWriter* writer) const {
+    return distribution_.Write(writer);
+}
+
+bool FseEncoder::WriteStream(BitStreamWriter* writer) const {
+    const uint8_t table_log = distribution_.TableLog();
+
+    if(writer->Append(final_state_, table_log) != table_log) {
+        return false;
+    }
+
+    for(size_t i=0; i<num_chunks_; ++i) {
+        const uint8_t num_bits = static_cast<uint8_t>(chunks_[i]);
+        if(num_bits > 0 && writer->Append(chunks_[i] >> 8, num_bits) != num_bits) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// FseDecoder ------------------------------------------------------------------
+
+FseDecoder::FseDecoder() {
+    state_ = 0;
+}
+
+bool FseDecoder::ReadHeader(BitStreamReader& reader) {
+    if(!distribution_.Read(reader)) {
+        return false;
+    }
+
+    const uint8_t table_log = distribution_.TableLog();
+    const uint32_t table_size = 1u << table_log;
+    uint8_t spread[1 << kFseMaxTableLog];
+    uint32_t next[kFseMaxSymbols];
+
+    SpreadSymbols(distribution_, spread);
+
+    for(uint16_t s=0; s<kFseMaxSymbols; ++s) {
+        next[s] = distribution_.Count(s);
+    }
+
+    for(uint32_t u=0; u<table_size; ++u) {
+        const uint8_t s = spread[u];
+        const uint32_t x = next[s]++;
+        const uint32_t num_bits = table_log - HighBit(x);
+        const uint32_t new_state = (x << num_bits) - table_size;
+
+        table_[u] = (new_state << 16) | (num_bits << 8) | s;
+    }
+
+    return true;
+}
+
+bool FseDecoder::Start(BitStreamReader& reader) {
+    const uint8_t table_log = distribution_.TableLog();
+
+    if(reader.NextPos() + table_log > reader.Size()) {
+        return false;
+    }
+
+    return reader.ReadNext(table_log, &state_) == table_log;
+}
+
+bool FseDecoder::Decode(BitStreamReader& reader,
+                        uint8_t* symbol) {
+    const uint32_t entry = table_[state_];
+    const uint8_t num_bits = static_cast<uint8_t>(entry >> 8);
+    uint32_t bits = 0;
+
+    if(num_bits > 0) {
+        const size_t pos = reader.NextPos();
+        if(pos + num_bits > reader.Size()) {
+            return false;
+        }
+
+        reader.Read(num_bits, pos, &bits);
+        reader.MoveTo(pos + num_bits);
+    }
+
+    *symbol = static_cast<uint8_t>(entry);
+    state_ = (entry >> 16) + bits;
+
+    return true;
+}
@@ -0,0 +1,126 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#ifndef FSE_H_
+#define FSE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "bit_stream.h"
+#include "mem.h"
+
+// Table-based asymmetric numeral system (tANS) coder, as popularized by the
+// Finite State Entropy library. Symbols with a probability far above 1/2 take
+// a fraction of a bit, which a Huffman code cannot do.
+
+static const uint16_t kFseMaxSymbols  = 256;
+static const uint8_t kFseMinTableLog  = 5;
+static const uint8_t kFseMaxTableLog  = 11;
+
+// FseDistribution class
+//
+// Symbol counts normalized to add up to 1 << TableLog(). Every symbol with a
+// non-zero frequency keeps a non-zero count.
+class FseDistribution {
+public:
+    FseDistribution();
+
+    // Normalizes the frequencies of symbols [0, num_symbols). Returns false
+    // if all of them are zero.
+    bool Normalize(const uint32_t* freqs,
+                   const uint16_t num_symbols);
+
+    uint8_t TableLog() const;
+
+    uint16_t MaxSymbol() const;
+
+    uint16_t Count(const uint16_t symbol) const;
+
+    // Returns the number of bits that Write appends.
+    size_t Length() const;
+
+    bool Write(BitStreamWriter* writer) const;
+
+    // Returns false if the stream is too short or the distribution is not
+    // valid.
+    bool Read(BitStreamReader& reader);
+
+private:
+    uint8_t table_log_;
+    uint16_t max_symbol_;
+    uint16_t counts_[kFseMaxSymbols];
+};
+
+// FseEncoder class
+//
+// Symbols are coded from the last one to the first one, so that they can be
+// decoded forwards. The bits of every symbol are kept until WriteStream
+// appends them in decoding order.
+class FseEncoder {
+public:
+    // The bits of the symbols are kept in a workspace of max_stream_size
+    // elements, allocated by the first Build with allocator (the default one
+    // when it is null).
+    FseEncoder(const size_t max_stream_size, const ZjumpAllocator* allocator = nullptr);
+
+    ~FseEncoder();
+
+    // Builds the coding tables for the frequencies of symbols
+    // [0, num_symbols). Returns false if all of them are zero, or if the
+    // workspace cannot be allocated.
+    bool Build(const uint32_t* freqs,
+               const uint16_t num_symbols);
+
+    // Codes the stream, whose symbols must have a non-zero frequency in the
+    // last Build. Returns the number of bits that WriteStream appends.
+    size_t Encode(const uint8_t* stream,
+                  const size_t stream_size);
+
+    // Returns the number of bits that WriteHeader appends.
+    size_t HeaderLength() const;
+
+    bool WriteHeader(BitStreamWriter* writer) const;
+
+    // Appends the stream coded by the last Encode call.
+    bool WriteStream(BitStreamWriter* writer) const;
+
+private:
+    FseDistribution distribution_;
+    uint16_t state_table_[1 << kFseMaxTableLog];
+    uint32_t delta_nb_bits_[kFseMaxSymbols];
+    int32_t delta_find_state_[kFseMaxSymbols];
+    const size_t max_stream_size_;
+    const ZjumpAllocator *allocator_;
+    uint32_t *chunks_;
+    size_t num_chunks_;
+    uint32_t final_state_;
+};
+
+// FseDecoder class
+class FseDecoder {
+public:
+    FseDecoder();
+
+    // Reads the distribution written by FseEncoder::WriteHeader and builds
+    // the decoding table.
+    bool ReadHeader(BitStreamReader& reader);
+
+    // Reads the initial state of a stream written by FseEncoder::WriteStream.
+    bool Start(BitStreamReader& reader);
+
+    // Reads the next symbol. Returns false when the stream is too short.
+    bool Decode(BitStreamReader& reader,
+                uint8_t* symbol);
+
+private:
+    FseDistribution distribution_;
+    // entries: new state base << 16 | number of bits << 8 | symbol
+    uint32_t table_[1 << kFseMaxTableLog];
+    uint32_t state_;
+};
+
+#endif // FSE_H_
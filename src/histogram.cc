@@ -0,0 +1,68 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include "histogram.h"
+
+#include <cassert>
+
+#include "cpu_features.h"
+
+static const size_t kHistogramTables = 4;
+
+static_assert(kBlockMaxEncodingSymbols == 256, "every byte is a symbol");
+
+static ZJUMP_ALWAYS_INLINE void CountSymbolsLoop(const uint8_t* symbols,
+                                                 size_t num_symbols,
+                                                 uint32_t* freqs) {
+    uint32_t tables[kHistogramTables][kBlockMaxEncodingSymbols] = {};
+    size_t i = 0;
+
+    for(; i + kHistogramTables <= num_symbols; i += kHistogramTables) {
+        ++tables[0][symbols[i]];
+        ++tables[1][symbols[i + 1]];
+        ++tables[2][symbols[i + 2]];
+        ++tables[3][symbols[i + 3]];
+    }
+
+    for(; i<num_symbols; ++i) {
+        ++tables[0][symbols[i]];
+    }
+
+    for(uint16_t s=0; s<kBlockMaxEncodingSymbols; ++s) {
+        freqs[s] = tables[0][s] + tables[1][s] + tables[2][s] + tables[3][s];
+    }
+}
+
+static void CountSymbolsGeneric(const uint8_t* symbols,
+                                size_t num_symbols,
+                                uint32_t* freqs) {
+    CountSymbolsLoop(symbols, num_symbols, freqs);
+}
+
+#if defined(ZJUMP_CPU_DISPATCH)
+ZJUMP_TARGET("avx2")
+static void CountSymbolsAvx2(const uint8_t* symbols,
+                             size_t num_symbols,
+                             uint32_t* freqs) {
+    CountSymbolsLoop(symbols, num_symbols, freqs);
+}
+#endif
+
+void CountSymbols(const uint8_t* symbols,
+                  size_t num_symbols,
+                  uint32_t* freqs) {
+    assert(freqs != nullptr);
+
+#if defined(ZJUMP_CPU_DISPATCH)
+    static const bool use_avx2 = GetCpuFeatures().avx2;
+    if(use_avx2) {
+        CountSymbolsAvx2(symbols, num_symbols, freqs);
+        return;
+    }
+#endif
+
+    CountSymbolsGeneric(symbols, num_symbols, freqs);
+}
@@ -0,0 +1,25 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "constants.h"
+
+// Sets freqs, of kBlockMaxEncodingSymbols elements, to the number of times
+// every symbol appears in symbols.
+//
+// Consecutive symbols are counted in separate tables, so that runs of the
+// same symbol do not wait for the previous increment. The tables are merged
+// with AVX2 where the CPU has it.
+void CountSymbols(const uint8_t* symbols,
+                  size_t num_symbols,
+                  uint32_t* freqs);
+
+#endif // HISTOGRAM_H_
@@ -7,40 +7,111 @@
 #ifndef HUFFMAN_H_
 #define HUFFMAN_H_
 
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <type_traits>
 
 #include "bit_stream.h"
+#include "constants.h"
+#include "cpu_features.h"
 #include "encode.h"
 
+// Every class in this file is a template on the number of symbols of the
+// alphabet (kMaxSymbols) and on the maximum code length (kMaxBitLength). All
+// their storage is fixed-size, so they allocate nothing but themselves, and
+// their loops have constant bounds. The block codec uses the Block* types at
+// the end of the file, which are compiled once, in huffman.cc.
+
+// Maximum code length supported by the builders and the decoder
+// (EncodedSymbol::enc_value holds 16 bits).
+static const uint8_t kHuffmanMaxSupportedBitLength = 16;
+
+// Number of bits resolved by a single lookup in HuffmanDecoder.
+static const uint8_t kHuffmanDecoderTableBits = 11;
+
+// Number of bits of the field that holds a code length up to max_bit_length.
+constexpr uint8_t BitLengthFieldSize(uint8_t max_bit_length) {
+    return (max_bit_length == 0) ? 0 : 1 + BitLengthFieldSize(static_cast<uint8_t>(max_bit_length >> 1));
+}
+
+// Reverses the num_bits (at most 16) lowest bits of bits, swapping halves of
+// increasing size (http://graphics.stanford.edu/~seander/bithacks.html).
+inline uint32_t ReverseBits(uint32_t bits, uint8_t num_bits) {
+    assert(num_bits <= 16);
+
+    bits = ((bits >> 1) & 0x5555) | ((bits & 0x5555) << 1);
+    bits = ((bits >> 2) & 0x3333) | ((bits & 0x3333) << 2);
+    bits = ((bits >> 4) & 0x0F0F) | ((bits & 0x0F0F) << 4);
+    bits = ((bits >> 8) & 0x00FF) | ((bits & 0x00FF) << 8);
+
+    return (bits & 0xFFFF) >> (16 - num_bits);
+}
+
+// Moffat & Katajainen, "In-Place Calculation of Minimum-Redundancy Codes".
+// On input, a holds n frequencies sorted in ascending order. On output, a[i]
+// holds the code length of the i-th frequency. No extra memory is used.
+void CalculateMinimumRedundancy(uint32_t* a, const size_t n);
+
+// Limits the code lengths of a (sorted by ascending frequency, so the lengths
+// are non-increasing) to max_bit_length, keeping the Kraft sum equal to one.
+void LimitBitLengths(uint32_t* a,
+                     const size_t n,
+                     const uint8_t max_bit_length);
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
 class HuffmanEncoding {
 public:
-    HuffmanEncoding(const uint16_t max_symbols,
-                    const uint8_t max_bit_length);
+    static_assert(kMaxSymbols > 0, "empty alphabet");
+    static_assert(kMaxBitLength <= kHuffmanMaxSupportedBitLength, "codes too long");
 
-    ~HuffmanEncoding();
+    HuffmanEncoding();
+
+    // Removes every encoded symbol.
+    void Clear();
+
+    void SetEncodedSymbol(const EncodedSymbol& enc_symbol);
 
     void SetEncodedSymbols(const EncodedSymbol* enc_symbols,
                            const size_t num_symbols);
 
-    EncodedSymbol* GetEncodedSymbol(const uint16_t symbol) const;
+    const EncodedSymbol* GetEncodedSymbol(const uint16_t symbol) const;
+
+    // Flat encoder table, indexed by symbol. Every entry packs the code with
+    // its bits reversed (first bit in the lowest position) << 8 | its length.
+    // Symbols without a code have a zero entry.
+    const uint32_t* EncoderTable() const;
 
-    uint16_t MaxSymbols() const;
+    static constexpr uint16_t MaxSymbols() { return kMaxSymbols; }
 
-    uint8_t MaxBitLength() const;
+    static constexpr uint8_t MaxBitLength() { return kMaxBitLength; }
 
 private:
-    uint16_t max_symbols_;
-    uint8_t max_bit_length_;
-    EncodedSymbol *enc_symbols_;
+    std::array<EncodedSymbol, kMaxSymbols> enc_symbols_;
+    std::array<uint32_t, kMaxSymbols> encoder_table_;
 };
 
+// HuffmanFrequencyBuilder class
+//
+// It builds a length-limited Huffman encoding from symbol frequencies.
+//
+// The code lengths are computed in place with the Moffat-Katajainen algorithm
+// and then limited to kMaxBitLength, keeping the Kraft sum equal to one. All
+// the working memory is part of the object, so a builder can be reset and
+// reused many times without allocations. The sum of all the frequencies must
+// fit in 32 bits.
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
 class HuffmanFrequencyBuilder {
 public:
-    HuffmanFrequencyBuilder(const uint16_t max_symbols,
-                            const uint8_t max_bit_length);
+    typedef HuffmanEncoding<kMaxSymbols, kMaxBitLength> Encoding;
+
+    HuffmanFrequencyBuilder();
 
-    ~HuffmanFrequencyBuilder();
+    // Sets every symbol frequency to zero.
+    void Reset();
 
     void SetSymbolFrequency(const uint16_t symbol,
                             const uint32_t freq);
@@ -48,30 +119,103 @@ public:
     void AddSymbolFrequency(const uint16_t symbol,
                             const uint32_t freq);
 
-    HuffmanEncoding* Build();
+    // Writes the code length of every symbol (0 for absent symbols) into
+    // bit_lengths, which must hold kMaxSymbols elements.
+    void BuildBitLengths(uint8_t* bit_lengths);
+
+    // Fills encoding.
+    void Build(Encoding* encoding);
+
+    // Creates a new encoding, which must be freed eventually.
+    Encoding* Build();
 
 private:
-    uint16_t max_symbols_;
-    uint8_t max_bit_length_;
-    uint32_t *symbol_freqs_;
+    std::array<uint32_t, kMaxSymbols> symbol_freqs_;
+    std::array<uint64_t, kMaxSymbols> sort_keys_;
+    std::array<uint32_t, kMaxSymbols> code_lengths_;
+    std::array<uint8_t, kMaxSymbols> bit_lengths_;
 };
 
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
 class HuffmanBitLengthBuilder {
 public:
-    HuffmanBitLengthBuilder(const uint16_t max_symbols,
-                            const uint8_t max_bit_length);
+    typedef HuffmanEncoding<kMaxSymbols, kMaxBitLength> Encoding;
 
-    ~HuffmanBitLengthBuilder();
+    HuffmanBitLengthBuilder();
 
     void SetSymbolBitLength(const uint16_t symbol,
                             const uint8_t bit_length);
 
-    HuffmanEncoding* Build();
+    // Fills encoding.
+    void Build(Encoding* encoding);
+
+    // Creates a new encoding, which must be freed eventually.
+    Encoding* Build();
+
+private:
+    std::array<uint8_t, kMaxSymbols> bit_lengths_;
+};
+
+// HuffmanDecoder class
+//
+// Table-driven decoder of the canonical codes of a HuffmanEncoding. Codes are
+// expected with their first bit in the lowest position of the bit stream, as
+// BlockWriter appends them.
+//
+// Codes up to kHuffmanDecoderTableBits bits are decoded with a single table
+// lookup; longer ones fall back to a canonical decoding loop.
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+class HuffmanDecoder {
+public:
+    typedef HuffmanEncoding<kMaxSymbols, kMaxBitLength> Encoding;
+
+    // Smallest type that holds every symbol of the alphabet, which
+    // DecodeSymbols writes.
+    typedef typename std::conditional<(kMaxSymbols <= 256), uint8_t, uint16_t>::type Symbol;
+
+    HuffmanDecoder();
+
+    // Prepares the decoding tables for encoding.
+    void Build(const Encoding& encoding);
+
+    // Reads the next symbol. Returns false when the bits in the stream do not
+    // form a valid code.
+    bool Decode(BitStreamReader& reader,
+                uint16_t* symbol) const;
+
+    // Reads up to num_symbols symbols into symbols, and returns how many were
+    // read: fewer at the end of the stream or when the bits do not form a
+    // valid code. Bits are extracted with BMI2 where the CPU has it.
+    size_t DecodeSymbols(BitStreamReader& reader,
+                         size_t num_symbols,
+                         Symbol* symbols) const;
 
 private:
-    uint16_t max_symbols_;
-    uint8_t max_bit_length_;
-    uint8_t *bit_lengths_;
+    std::array<uint32_t, 1u << kHuffmanDecoderTableBits> table_;
+    std::array<uint16_t, kMaxSymbols> sorted_symbols_;
+    uint32_t first_code_[kHuffmanMaxSupportedBitLength + 1];
+    uint32_t first_index_[kHuffmanMaxSupportedBitLength + 1];
+    uint32_t bl_count_[kHuffmanMaxSupportedBitLength + 1];
+
+    bool DecodeLongCode(uint64_t bits,
+                        uint8_t num_bits,
+                        uint16_t* symbol,
+                        uint8_t* bit_length) const;
+
+    // Body of every version of DecodeSymbols.
+    size_t DecodeSymbolsLoop(BitStreamReader& reader,
+                             size_t num_symbols,
+                             Symbol* symbols) const;
+
+    size_t DecodeSymbolsGeneric(BitStreamReader& reader,
+                                size_t num_symbols,
+                                Symbol* symbols) const;
+
+#if defined(ZJUMP_CPU_DISPATCH)
+    size_t DecodeSymbolsBmi2(BitStreamReader& reader,
+                             size_t num_symbols,
+                             Symbol* symbols) const;
+#endif
 };
 
 // HuffmanWriter class
@@ -80,31 +224,33 @@ private:
 //
 // It evaluates 4 different encodings and uses the one that produces the more compressed
 // version or, what it is the same, the one that encodes the Huffman tree with fewer bits.
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
 class HuffmanWriter {
 public:
-    // Constructor.
-    HuffmanWriter(const HuffmanEncoding& huff_tree);
+    typedef HuffmanEncoding<kMaxSymbols, kMaxBitLength> Encoding;
 
-    // Destructor.
-    ~HuffmanWriter();
+    // Constructor.
+    HuffmanWriter(const Encoding& huff_tree);
 
     // Writes the encoded representation of the HuffmanEncoding object huff_tree_
     // on the bit stream contained in writer.
     bool Write(BitStreamWriter* writer);
 
+    // Returns the number of bits that Write appends.
+    size_t Length();
+
 private:
-    const HuffmanEncoding &huff_tree_;
+    const Encoding &huff_tree_;
     BitStreamWriter *writer_;
     uint8_t encoding_type_;
     size_t range_size_;
-    uint8_t *range_flags_;
+    std::array<uint8_t, kMaxSymbols> range_flags_;
     size_t range_flags_size_;
 
-    uint8_t EncodingType();
+    uint8_t EncodingType(size_t* flags_length);
 
-    size_t EncodingLength(size_t num_symbols,
-                          size_t range_size,
-                          size_t* sum_symbols);
+    size_t EncodingLength(size_t range_size,
+                          const size_t* sum_symbols);
 
     // Writes the encoding type.
     bool WriteEncodingType();
@@ -138,37 +284,33 @@ private:
 //
 // It reads a bit stream through a BitStreamReader object and builds a HuffmanEncoding
 // object.
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
 class HuffmanReader {
 public:
+    typedef HuffmanEncoding<kMaxSymbols, kMaxBitLength> Encoding;
+
     // Returning codes.
     static constexpr int NO_ERROR         = 0;
     static constexpr int ERROR_BIT_STREAM = 1;
     static constexpr int ERROR_HUFFMAN    = 2;
 
     // Constructor.
-    // The max_symbols and max_bit_length values must be known in order to build
-    // a HuffmanEncoding object.
-    HuffmanReader(BitStreamReader& reader,
-                  const uint16_t max_symbols,
-                  const uint8_t max_bit_length);
-
-    // Destructor.
-    ~HuffmanReader();
-
-    // Reads the bit stream and creates a HuffmanEncoding object.
-    // The object allocation is made inside this function and must be freed
-    // eventually.
+    HuffmanReader(BitStreamReader& reader);
+
+    // Reads the bit stream into huff_tree, replacing its symbols.
     // It returns an integer telling the final state of the reading. The
     // returning codes have been defined above as public constant expressions.
-    int Read(HuffmanEncoding** huff_tree);
+    int Read(Encoding* huff_tree);
+
+    // Reads the bit stream and creates a HuffmanEncoding object, which must be
+    // freed eventually. It is only created if the reading succeeds.
+    int Read(Encoding** huff_tree);
 
 private:
     BitStreamReader& reader_;
-    const uint16_t max_symbols_;
-    const uint8_t max_bit_length_;
     uint8_t encoding_type_;
-    uint16_t *symbols_;
-    uint8_t *bit_lengths_;
+    std::array<uint16_t, kMaxSymbols> symbols_;
+    std::array<uint8_t, kMaxSymbols> bit_lengths_;
     size_t num_symbols_;
 
     bool ReadEncodingType();
@@ -183,5 +325,718 @@ private:
     bool ReadSymbolBitLengths();
 };
 
-#endif // HUFFMAN_H_
+// Assigns canonical codes from the code length of every symbol: shorter codes
+// first and, for the same length, lower symbols first.
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+void SetCanonicalEncoding(const uint8_t* bit_lengths,
+                          HuffmanEncoding<kMaxSymbols, kMaxBitLength>* encoding) {
+    uint16_t bl_count[kHuffmanMaxSupportedBitLength + 1] = {0};
+    uint16_t next_code[kHuffmanMaxSupportedBitLength + 1];
+    uint32_t code = 0;
+
+    for(uint16_t s=0; s<kMaxSymbols; ++s) {
+        ++bl_count[bit_lengths[s]];
+    }
+
+    bl_count[0] = 0;
+    next_code[0] = 0;
+    for(size_t i=1; i<=kHuffmanMaxSupportedBitLength; ++i) {
+        code = (code + bl_count[i - 1]) << 1;
+        next_code[i] = static_cast<uint16_t>(code);
+    }
+
+    encoding->Clear();
+
+    for(uint16_t s=0; s<kMaxSymbols; ++s) {
+        const uint8_t len = bit_lengths[s];
+        if(len > 0) {
+            encoding->SetEncodedSymbol(EncodedSymbol(s, len, next_code[len]++));
+        }
+    }
+}
+
+// HuffmanEncoding -------------------------------------------------------------
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+HuffmanEncoding<kMaxSymbols, kMaxBitLength>::HuffmanEncoding() {
+    Clear();
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+void HuffmanEncoding<kMaxSymbols, kMaxBitLength>::Clear() {
+    for(uint16_t i=0; i<kMaxSymbols; ++i) {
+        enc_symbols_[i] = EncodedSymbol(i);
+    }
+    encoder_table_.fill(0);
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+void HuffmanEncoding<kMaxSymbols, kMaxBitLength>::SetEncodedSymbol(const EncodedSymbol& enc_symbol) {
+    assert(enc_symbol.symbol < kMaxSymbols);
+    assert(enc_symbol.enc_bit_length <= kMaxBitLength);
+    enc_symbols_[enc_symbol.symbol] = enc_symbol;
+    encoder_table_[enc_symbol.symbol] =
+        (ReverseBits(enc_symbol.enc_value, enc_symbol.enc_bit_length) << 8) |
+        enc_symbol.enc_bit_length;
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+void HuffmanEncoding<kMaxSymbols, kMaxBitLength>::SetEncodedSymbols(const EncodedSymbol* enc_symbols,
+                                                                    const size_t length) {
+    for(size_t i=0; i<length; ++i) {
+        SetEncodedSymbol(enc_symbols[i]);
+    }
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+const EncodedSymbol* HuffmanEncoding<kMaxSymbols, kMaxBitLength>::GetEncodedSymbol(const uint16_t symbol) const {
+    assert(symbol < kMaxSymbols);
+    if(enc_symbols_[symbol].enc_bit_length == 0) {
+        return nullptr;
+    }
+    return &(enc_symbols_[symbol]);
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+const uint32_t* HuffmanEncoding<kMaxSymbols, kMaxBitLength>::EncoderTable() const {
+    return encoder_table_.data();
+}
+
+// HuffmanFrequencyBuilder -----------------------------------------------------
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+HuffmanFrequencyBuilder<kMaxSymbols, kMaxBitLength>::HuffmanFrequencyBuilder() {
+    Reset();
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+void HuffmanFrequencyBuilder<kMaxSymbols, kMaxBitLength>::Reset() {
+    symbol_freqs_.fill(0);
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+void HuffmanFrequencyBuilder<kMaxSymbols, kMaxBitLength>::SetSymbolFrequency(const uint16_t symbol,
+                                                                             const uint32_t freq) {
+    assert(symbol < kMaxSymbols);
+    symbol_freqs_[symbol] = freq;
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+void HuffmanFrequencyBuilder<kMaxSymbols, kMaxBitLength>::AddSymbolFrequency(const uint16_t symbol,
+                                                                             const uint32_t freq) {
+    assert(symbol < kMaxSymbols);
+    symbol_freqs_[symbol] += freq;
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+void HuffmanFrequencyBuilder<kMaxSymbols, kMaxBitLength>::BuildBitLengths(uint8_t* bit_lengths) {
+    size_t num_symbols = 0;
+
+    // frequency in the upper bits and symbol in the lower ones, so ties are
+    // broken by symbol
+    for(uint16_t s=0; s<kMaxSymbols; ++s) {
+        if(symbol_freqs_[s]) {
+            sort_keys_[num_symbols++] = (static_cast<uint64_t>(symbol_freqs_[s]) << 16) | s;
+        }
+    }
+
+    std::sort(sort_keys_.begin(), sort_keys_.begin() + num_symbols);
+
+    for(size_t i=0; i<num_symbols; ++i) {
+        code_lengths_[i] = static_cast<uint32_t>(sort_keys_[i] >> 16);
+    }
+
+    CalculateMinimumRedundancy(code_lengths_.data(), num_symbols);
+
+    LimitBitLengths(code_lengths_.data(), num_symbols, kMaxBitLength);
+
+    std::fill_n(bit_lengths, kMaxSymbols, 0);
+
+    for(size_t i=0; i<num_symbols; ++i) {
+        bit_lengths[sort_keys_[i] & 0xffff] = static_cast<uint8_t>(code_lengths_[i]);
+    }
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+void HuffmanFrequencyBuilder<kMaxSymbols, kMaxBitLength>::Build(Encoding* encoding) {
+    assert(encoding != nullptr);
+
+    BuildBitLengths(bit_lengths_.data());
+
+    SetCanonicalEncoding(bit_lengths_.data(), encoding);
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+typename HuffmanFrequencyBuilder<kMaxSymbols, kMaxBitLength>::Encoding*
+HuffmanFrequencyBuilder<kMaxSymbols, kMaxBitLength>::Build() {
+    Encoding *encoding = new Encoding();
+
+    Build(encoding);
+
+    return encoding;
+}
+
+// HuffmanBitLengthBuilder -----------------------------------------------------
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+HuffmanBitLengthBuilder<kMaxSymbols, kMaxBitLength>::HuffmanBitLengthBuilder() {
+    bit_lengths_.fill(0);
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+void HuffmanBitLengthBuilder<kMaxSymbols, kMaxBitLength>::SetSymbolBitLength(const uint16_t symbol,
+                                                                             const uint8_t bit_length) {
+    assert(symbol < kMaxSymbols);
+    assert(bit_length <= kMaxBitLength);
+    bit_lengths_[symbol] = bit_length;
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+void HuffmanBitLengthBuilder<kMaxSymbols, kMaxBitLength>::Build(Encoding* encoding) {
+    assert(encoding != nullptr);
+
+    SetCanonicalEncoding(bit_lengths_.data(), encoding);
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+typename HuffmanBitLengthBuilder<kMaxSymbols, kMaxBitLength>::Encoding*
+HuffmanBitLengthBuilder<kMaxSymbols, kMaxBitLength>::Build() {
+    Encoding *encoding = new Encoding();
+
+    Build(encoding);
+
+    return encoding;
+}
+
+// HuffmanDecoder --------------------------------------------------------------
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+HuffmanDecoder<kMaxSymbols, kMaxBitLength>::HuffmanDecoder() {
+    table_.fill(0);
+    sorted_symbols_.fill(0);
+    std::fill_n(first_code_, kHuffmanMaxSupportedBitLength + 1, 0);
+    std::fill_n(first_index_, kHuffmanMaxSupportedBitLength + 1, 0);
+    std::fill_n(bl_count_, kHuffmanMaxSupportedBitLength + 1, 0);
+}
+
+// table_ entries: symbol << 8 | bit length. A zero bit length means that the
+// code is longer than kHuffmanDecoderTableBits or invalid.
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+void HuffmanDecoder<kMaxSymbols, kMaxBitLength>::Build(const Encoding& encoding) {
+    table_.fill(0);
+    std::fill_n(bl_count_, kHuffmanMaxSupportedBitLength + 1, 0);
+
+    for(uint16_t s=0; s<kMaxSymbols; ++s) {
+        const EncodedSymbol *enc = encoding.GetEncodedSymbol(s);
+        if(enc != nullptr) {
+            ++bl_count_[enc->enc_bit_length];
+        }
+    }
+
+    uint32_t code = 0;
+    uint32_t index = 0;
+    for(uint8_t len=1; len<=kHuffmanMaxSupportedBitLength; ++len) {
+        code = (code + bl_count_[len - 1]) << 1;
+        first_code_[len] = code;
+        first_index_[len] = index;
+        index += bl_count_[len];
+    }
+    bl_count_[0] = 0;
+
+    uint32_t next_index[kHuffmanMaxSupportedBitLength + 1];
+    std::copy_n(first_index_, kHuffmanMaxSupportedBitLength + 1, next_index);
+
+    for(uint16_t s=0; s<kMaxSymbols; ++s) {
+        const EncodedSymbol *enc = encoding.GetEncodedSymbol(s);
+        if(enc == nullptr) {
+            continue;
+        }
+
+        const uint8_t len = enc->enc_bit_length;
+        sorted_symbols_[next_index[len]++] = s;
+
+        if(len <= kHuffmanDecoderTableBits) {
+            const uint32_t entry = (static_cast<uint32_t>(s) << 8) | len;
+            const uint32_t reversed = ReverseBits(enc->enc_value, len);
+            for(uint32_t i=reversed; i<(1u << kHuffmanDecoderTableBits); i+=(1u << len)) {
+                table_[i] = entry;
+            }
+        }
+    }
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+bool HuffmanDecoder<kMaxSymbols, kMaxBitLength>::Decode(BitStreamReader& reader,
+                                                        uint16_t* symbol) const {
+    const size_t pos = reader.NextPos();
+    if(pos >= reader.Size()) {
+        return false;
+    }
+
+    uint64_t bits = 0;
+    const uint8_t num_bits = reader.Read(kMaxBitLength, pos, &bits);
+
+    const uint32_t entry = table_[bits & ((1u << kHuffmanDecoderTableBits) - 1)];
+    uint8_t bit_length = static_cast<uint8_t>(entry);
+
+    if(bit_length != 0) {
+        *symbol = static_cast<uint16_t>(entry >> 8);
+    } else if(!DecodeLongCode(bits, num_bits, symbol, &bit_length)) {
+        return false;
+    }
+
+    if(bit_length > num_bits) {
+        return false;
+    }
+
+    reader.MoveTo(pos + bit_length);
+
+    return true;
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+bool HuffmanDecoder<kMaxSymbols, kMaxBitLength>::DecodeLongCode(uint64_t bits,
+                                                                uint8_t num_bits,
+                                                                uint16_t* symbol,
+                                                                uint8_t* bit_length) const {
+    uint32_t code = 0;
 
+    for(uint8_t len=1; (len<=kMaxBitLength) && (len<=num_bits); ++len) {
+        code = (code << 1) | (bits & 1);
+        bits >>= 1;
+
+        const uint32_t offset = code - first_code_[len];
+        if((code >= first_code_[len]) && (offset < bl_count_[len])) {
+            *symbol = sorted_symbols_[first_index_[len] + offset];
+            *bit_length = len;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+size_t HuffmanDecoder<kMaxSymbols, kMaxBitLength>::DecodeSymbols(BitStreamReader& reader,
+                                                                 size_t num_symbols,
+                                                                 Symbol* symbols) const {
+#if defined(ZJUMP_CPU_DISPATCH)
+    static const bool use_bmi2 = GetCpuFeatures().bmi2;
+    if(use_bmi2) {
+        return DecodeSymbolsBmi2(reader, num_symbols, symbols);
+    }
+#endif
+
+    return DecodeSymbolsGeneric(reader, num_symbols, symbols);
+}
+
+// The same steps as Decode, with the bits extracted in place instead of
+// through BitStreamReader::Read, so that they can be compiled to shrx/bzhi.
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+ZJUMP_ALWAYS_INLINE size_t HuffmanDecoder<kMaxSymbols, kMaxBitLength>::DecodeSymbolsLoop(BitStreamReader& reader,
+                                                                                         size_t num_symbols,
+                                                                                         Symbol* symbols) const {
+    const uint8_t *bytes = reader.Data();
+    const size_t size = reader.Size();
+    size_t pos = reader.NextPos();
+    size_t i = 0;
+
+    for(; (i < num_symbols) && (pos < size); ++i) {
+        const uint8_t num_bits = static_cast<uint8_t>(std::min<size_t>(kMaxBitLength, size - pos));
+
+        uint64_t value;
+        memcpy(&value, bytes + (pos >> 3), sizeof(value));
+        const uint64_t bits = (value >> (pos & 7)) & ((1ULL << num_bits) - 1ULL);
+
+        const uint32_t entry = table_[bits & ((1u << kHuffmanDecoderTableBits) - 1)];
+        uint8_t bit_length = static_cast<uint8_t>(entry);
+
+        uint16_t symbol = static_cast<uint16_t>(entry >> 8);
+
+        if((bit_length == 0) && !DecodeLongCode(bits, num_bits, &symbol, &bit_length)) {
+            break;
+        }
+
+        if(bit_length > num_bits) {
+            break;
+        }
+
+        symbols[i] = static_cast<Symbol>(symbol);
+        pos += bit_length;
+    }
+
+    reader.MoveTo(pos);
+
+    return i;
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+size_t HuffmanDecoder<kMaxSymbols, kMaxBitLength>::DecodeSymbolsGeneric(BitStreamReader& reader,
+                                                                        size_t num_symbols,
+                                                                        Symbol* symbols) const {
+    return DecodeSymbolsLoop(reader, num_symbols, symbols);
+}
+
+#if defined(ZJUMP_CPU_DISPATCH)
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+ZJUMP_TARGET("bmi2")
+size_t HuffmanDecoder<kMaxSymbols, kMaxBitLength>::DecodeSymbolsBmi2(BitStreamReader& reader,
+                                                                     size_t num_symbols,
+                                                                     Symbol* symbols) const {
+    return DecodeSymbolsLoop(reader, num_symbols, symbols);
+}
+#endif
+
+// HuffmanWriter ---------------------------------------------------------------
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+HuffmanWriter<kMaxSymbols, kMaxBitLength>::HuffmanWriter(const Encoding& huff_tree) :
+    huff_tree_(huff_tree) {
+    writer_ = nullptr;
+    encoding_type_ = 0;
+    range_size_ = kMaxSymbols;
+    range_flags_size_ = 0;
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+bool HuffmanWriter<kMaxSymbols, kMaxBitLength>::Write(BitStreamWriter* writer) {
+    assert(writer != nullptr);
+
+    writer_ = writer;
+    range_flags_size_ = 0;
+
+    size_t flags_length;
+    encoding_type_ = EncodingType(&flags_length);
+
+    return WriteEncodingType() &&
+           WriteFlags() &&
+           WriteSymbolBitLengths();
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+size_t HuffmanWriter<kMaxSymbols, kMaxBitLength>::Length() {
+    size_t num_symbols = 0;
+    size_t flags_length;
+
+    EncodingType(&flags_length);
+
+    for(uint16_t s=0; s<kMaxSymbols; ++s) {
+        num_symbols += (huff_tree_.GetEncodedSymbol(s) != nullptr);
+    }
+
+    return 2 + flags_length + num_symbols * BitLengthFieldSize(kMaxBitLength);
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+uint8_t HuffmanWriter<kMaxSymbols, kMaxBitLength>::EncodingType(size_t* flags_length) {
+    std::array<size_t, kMaxSymbols + 1> sum;
+
+    sum[0] = 0;
+
+    for(uint16_t i=0; i<kMaxSymbols; ++i) {
+        sum[i + 1] = sum[i] + (huff_tree_.GetEncodedSymbol(i) != nullptr);
+    }
+
+    size_t enc_type = 0;
+    size_t enc_len = kMaxSymbols;
+
+    size_t enc_len_1 = EncodingLength(8, sum.data());
+    if(enc_len_1 < enc_len) {
+        enc_type = 1;
+        enc_len = enc_len_1;
+    }
+
+    size_t enc_len_2 = EncodingLength(16, sum.data());
+    if(enc_len_2 < enc_len) {
+        enc_type = 2;
+        enc_len = enc_len_2;
+    }
+
+    size_t enc_len_3 = EncodingLength(32, sum.data());
+    if(enc_len_3 < enc_len) {
+        enc_type = 3;
+        enc_len = enc_len_3;
+    }
+
+    *flags_length = enc_len;
+
+    return enc_type;
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+size_t HuffmanWriter<kMaxSymbols, kMaxBitLength>::EncodingLength(size_t range_size,
+                                                                 const size_t* sum_symbols) {
+    size_t enc_len = (kMaxSymbols / range_size) + ((kMaxSymbols % range_size) > 0);
+
+    for(size_t i=0; i<=kMaxSymbols; i+=range_size) {
+        size_t remaining = (i + range_size > kMaxSymbols) ? (kMaxSymbols - i) : range_size;
+        size_t symbols_in_range = sum_symbols[i + remaining] - sum_symbols[i];
+        enc_len += remaining * (symbols_in_range > 0);
+    }
+
+    return enc_len;
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+bool HuffmanWriter<kMaxSymbols, kMaxBitLength>::WriteEncodingType() {
+    if(writer_->Append(encoding_type_, 2) == 2) {
+        return true;
+    } else {
+        return false;
+    }
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+bool HuffmanWriter<kMaxSymbols, kMaxBitLength>::WriteFlags() {
+    switch(encoding_type_) {
+        case 0:
+            return WriteSymbolFlags(0, kMaxSymbols);
+        case 1:
+            range_size_ = 8;
+            return WriteRangeFlags() &&
+                   WriteSymbolFlags();
+        case 2:
+            range_size_ = 16;
+            return WriteRangeFlags() &&
+                   WriteSymbolFlags();
+        case 3:
+            range_size_ = 32;
+            return WriteRangeFlags() &&
+                   WriteSymbolFlags();
+    }
+
+    return false;
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+bool HuffmanWriter<kMaxSymbols, kMaxBitLength>::WriteRangeFlags() {
+    for(size_t i=0; i<kMaxSymbols; ) {
+        uint8_t flag = 0;
+
+        for(size_t j=0; (i<kMaxSymbols && j<range_size_); ++j, ++i) {
+            flag = flag | static_cast<uint8_t>(huff_tree_.GetEncodedSymbol(i) != nullptr);
+        }
+
+        if(writer_->Append(flag, 1) != 1) {
+            return false;
+        }
+
+        range_flags_[range_flags_size_++] = flag;
+    }
+
+    return true;
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+bool HuffmanWriter<kMaxSymbols, kMaxBitLength>::WriteSymbolFlags() {
+    for(size_t i=0; i<range_flags_size_; ++i) {
+        if(range_flags_[i]) {
+            if(!WriteSymbolFlags(i * range_size_, range_size_)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+bool HuffmanWriter<kMaxSymbols, kMaxBitLength>::WriteSymbolFlags(size_t start,
+                                                                 size_t length) {
+    size_t end = start + length;
+    if(end > kMaxSymbols) {
+        end = kMaxSymbols;
+    }
+
+    for(size_t s=start; s<end; ++s) {
+        uint8_t flag = static_cast<uint8_t>(huff_tree_.GetEncodedSymbol(s) != nullptr);
+        if(writer_->Append(flag, 1) != 1) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+bool HuffmanWriter<kMaxSymbols, kMaxBitLength>::WriteSymbolBitLengths() {
+    // minimum size to encode a symbol bit length
+    const uint8_t bit_length_field_size = BitLengthFieldSize(kMaxBitLength);
+
+    for(uint16_t s=0; s<kMaxSymbols; ++s) {
+        const EncodedSymbol *enc = huff_tree_.GetEncodedSymbol(s);
+        if(enc != nullptr) {
+            uint8_t written = writer_->Append(enc->enc_bit_length, bit_length_field_size);
+            if(written != bit_length_field_size) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// HuffmanReader ---------------------------------------------------------------
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+constexpr int HuffmanReader<kMaxSymbols, kMaxBitLength>::NO_ERROR;
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+constexpr int HuffmanReader<kMaxSymbols, kMaxBitLength>::ERROR_BIT_STREAM;
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+constexpr int HuffmanReader<kMaxSymbols, kMaxBitLength>::ERROR_HUFFMAN;
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+HuffmanReader<kMaxSymbols, kMaxBitLength>::HuffmanReader(BitStreamReader& reader) :
+    reader_(reader) {
+    static_assert(kMaxBitLength > 0, "codes too short");
+    encoding_type_ = 0;
+    num_symbols_ = 0;
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+int HuffmanReader<kMaxSymbols, kMaxBitLength>::Read(Encoding* huff_tree) {
+    assert(huff_tree != nullptr);
+
+    num_symbols_ = 0;
+
+    if(!ReadEncodingType()) {
+        return ERROR_BIT_STREAM;
+    }
+
+    if(!ReadFlags()) {
+        return ERROR_BIT_STREAM;
+    }
+
+    if(!ReadSymbolBitLengths()) {
+        return ERROR_BIT_STREAM;
+    }
+
+    HuffmanBitLengthBuilder<kMaxSymbols, kMaxBitLength> builder;
+
+    for(size_t i=0; i<num_symbols_; ++i) {
+        builder.SetSymbolBitLength(symbols_[i], bit_lengths_[i]);
+    }
+
+    builder.Build(huff_tree);
+
+    return NO_ERROR;
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+int HuffmanReader<kMaxSymbols, kMaxBitLength>::Read(Encoding** huff_tree) {
+    assert(huff_tree != nullptr);
+
+    Encoding *encoding = new Encoding();
+
+    int ret_code = Read(encoding);
+    if(ret_code != NO_ERROR) {
+        delete encoding;
+        encoding = nullptr;
+    }
+
+    *huff_tree = encoding;
+
+    return ret_code;
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+bool HuffmanReader<kMaxSymbols, kMaxBitLength>::ReadEncodingType() {
+    return (reader_.ReadNext(2, &encoding_type_) == 2);
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+bool HuffmanReader<kMaxSymbols, kMaxBitLength>::ReadFlags() {
+    switch(encoding_type_) {
+        case 0:
+            return ReadSymbolFlags(0, kMaxSymbols);
+        case 1:
+            return ReadRangeFlags(8);
+        case 2:
+            return ReadRangeFlags(16);
+        case 3:
+            return ReadRangeFlags(32);
+    }
+
+    return false;
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+bool HuffmanReader<kMaxSymbols, kMaxBitLength>::ReadRangeFlags(size_t range_size) {
+    const size_t num_range_flags = (kMaxSymbols / range_size) + ((kMaxSymbols % range_size) > 0);
+    size_t range_flags_pos = reader_.NextPos();
+
+    // move the next-position-to-read to the position from where symbol flags
+    // are going to be read.
+    reader_.MoveTo(range_flags_pos + num_range_flags);
+
+    for(size_t i=0, j=0; i<num_range_flags; ++i, j+=range_size) {
+        uint8_t flag = 0;
+        if(reader_.Read(1, range_flags_pos, &flag) != 1) {
+            return false;
+        }
+
+        if((flag == 1) && (!ReadSymbolFlags(j, range_size))) {
+            return false;
+        }
+
+        ++range_flags_pos;
+    }
+
+    return true;
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+bool HuffmanReader<kMaxSymbols, kMaxBitLength>::ReadSymbolFlags(size_t start,
+                                                                size_t length) {
+    size_t end = start + length;
+    if(end > kMaxSymbols) {
+        end = kMaxSymbols;
+    }
+
+    for(size_t s=start; s<end; ++s) {
+        uint8_t flag;
+
+        if(reader_.ReadNext(1, &flag) != 1) {
+            return false;
+        }
+
+        if(flag == 1) {
+            symbols_[num_symbols_++] = s;
+        }
+    }
+
+    return true;
+}
+
+template <uint16_t kMaxSymbols, uint8_t kMaxBitLength>
+bool HuffmanReader<kMaxSymbols, kMaxBitLength>::ReadSymbolBitLengths() {
+    const uint8_t bit_length_field_size = BitLengthFieldSize(kMaxBitLength);
+
+    for(size_t i=0; i<num_symbols_; ++i) {
+        if(reader_.ReadNext(bit_length_field_size, &bit_lengths_[i]) != bit_length_field_size) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Block codec -----------------------------------------------------------------
+
+typedef HuffmanEncoding<kBlockMaxEncodingSymbols, kBlockMaxEncodingBitLength> BlockHuffmanEncoding;
+typedef HuffmanFrequencyBuilder<kBlockMaxEncodingSymbols, kBlockMaxEncodingBitLength> BlockHuffmanFrequencyBuilder;
+typedef HuffmanBitLengthBuilder<kBlockMaxEncodingSymbols, kBlockMaxEncodingBitLength> BlockHuffmanBitLengthBuilder;
+typedef HuffmanDecoder<kBlockMaxEncodingSymbols, kBlockMaxEncodingBitLength> BlockHuffmanDecoder;
+typedef HuffmanWriter<kBlockMaxEncodingSymbols, kBlockMaxEncodingBitLength> BlockHuffmanWriter;
+typedef HuffmanReader<kBlockMaxEncodingSymbols, kBlockMaxEncodingBitLength> BlockHuffmanReader;
+
+extern template class HuffmanEncoding<kBlockMaxEncodingSymbols, kBlockMaxEncodingBitLength>;
+extern template class HuffmanFrequencyBuilder<kBlockMaxEncodingSymbols, kBlockMaxEncodingBitLength>;
+extern template class HuffmanBitLengthBuilder<kBlockMaxEncodingSymbols, kBlockMaxEncodingBitLength>;
+extern template class HuffmanDecoder<kBlockMaxEncodingSymbols, kBlockMaxEncodingBitLength>;
+extern template class HuffmanWriter<kBlockMaxEncodingSymbols, kBlockMaxEncodingBitLength>;
+extern template class HuffmanReader<kBlockMaxEncodingSymbols, kBlockMaxEncodingBitLength>;
+
+#endif // HUFFMAN_H_
@@ -0,0 +1,368 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include "io_ring.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef ZJUMP_USE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
+bool SupportsPositionalIo(FILE* file) {
+    const int fd = fileno(file);
+    struct stat st;
+
+    if((fd < 0) || (fstat(fd, &st) != 0) || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+
+    const int flags = fcntl(fd, F_GETFL);
+    if((flags < 0) || ((flags & O_APPEND) != 0)) {
+        return false;
+    }
+
+    return ftello(file) >= 0;
+}
+
+bool WriteAt(int fd, const uint8_t* data, size_t size, off_t offset) {
+    while(size > 0) {
+        ssize_t written = pwrite(fd, data, size, offset);
+
+        if(written < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        data += written;
+        size -= static_cast<size_t>(written);
+        offset += written;
+    }
+
+    return true;
+}
+
+IoRequest::IoRequest() {
+    fd = -1;
+    data = nullptr;
+    size = 0;
+    offset = 0;
+    buffer_index = -1;
+    write = false;
+    done = 0;
+    pending = false;
+    error = 0;
+}
+
+IoRing::IoRing() {
+    fd_ = -1;
+    entries_ = 0;
+    in_flight_ = 0;
+    failing_submits_ = 0;
+    buffers_registered_ = false;
+    sq_ring_ = nullptr;
+    sq_ring_size_ = 0;
+    cq_ring_ = nullptr;
+    cq_ring_size_ = 0;
+    sqes_ = nullptr;
+    sqes_size_ = 0;
+    sq_head_ = nullptr;
+    sq_tail_ = nullptr;
+    sq_mask_ = nullptr;
+    sq_array_ = nullptr;
+    cq_head_ = nullptr;
+    cq_tail_ = nullptr;
+    cq_mask_ = nullptr;
+    cqes_ = nullptr;
+}
+
+IoRing::~IoRing() {
+    Close();
+}
+
+#ifdef ZJUMP_USE_IO_URING
+
+template<typename T>
+static T* RingField(void* ring, uint32_t offset) {
+    return reinterpret_cast<T*>(static_cast<uint8_t*>(ring) + offset);
+}
+
+bool IoRing::Init(unsigned entries) {
+    assert(entries > 0);
+    Close();
+
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if(fd < 0) {
+        return false;
+    }
+
+    fd_ = fd;
+    entries_ = params.sq_entries;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    fd_, IORING_OFF_SQ_RING);
+    if(sq_ring_ == MAP_FAILED) {
+        sq_ring_ = nullptr;
+        Close();
+        return false;
+    }
+
+    if((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+        cq_ring_ = sq_ring_;
+    } else {
+        cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        fd_, IORING_OFF_CQ_RING);
+        if(cq_ring_ == MAP_FAILED) {
+            cq_ring_ = nullptr;
+            Close();
+            return false;
+        }
+    }
+
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                 fd_, IORING_OFF_SQES);
+    if(sqes_ == MAP_FAILED) {
+        sqes_ = nullptr;
+        Close();
+        return false;
+    }
+
+    sq_head_ = RingField<unsigned>(sq_ring_, params.sq_off.head);
+    sq_tail_ = RingField<unsigned>(sq_ring_, params.sq_off.tail);
+    sq_mask_ = RingField<unsigned>(sq_ring_, params.sq_off.ring_mask);
+    sq_array_ = RingField<unsigned>(sq_ring_, params.sq_off.array);
+    cq_head_ = RingField<unsigned>(cq_ring_, params.cq_off.head);
+    cq_tail_ = RingField<unsigned>(cq_ring_, params.cq_off.tail);
+    cq_mask_ = RingField<unsigned>(cq_ring_, params.cq_off.ring_mask);
+    cqes_ = RingField<void>(cq_ring_, params.cq_off.cqes);
+
+    return true;
+}
+
+bool IoRing::RegisterBuffers(const struct iovec* buffers, unsigned num_buffers) {
+    assert(IsOpen());
+    assert(!buffers_registered_);
+
+    buffers_registered_ = syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS,
+                                  buffers, num_buffers) == 0;
+    return buffers_registered_;
+}
+
+// The kernel only reads the submission queue during io_uring_enter, so an
+// entry it did not take is withdrawn. Left in the ring, it would be submitted
+// by the next call, for a request its caller has already given up on.
+bool IoRing::Queue(IoRequest* request) {
+    if(in_flight_ >= entries_) {
+        return false;
+    }
+
+    const unsigned tail = *sq_tail_;
+    assert(__atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) == tail);
+
+    const unsigned index = tail & *sq_mask_;
+    struct io_uring_sqe *sqe = static_cast<struct io_uring_sqe*>(sqes_) + index;
+
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = request->fd;
+    sqe->addr = reinterpret_cast<uint64_t>(request->data + request->done);
+    sqe->len = static_cast<uint32_t>(request->size - request->done);
+    sqe->off = static_cast<uint64_t>(request->offset) + request->done;
+    sqe->user_data = reinterpret_cast<uint64_t>(request);
+
+    if(buffers_registered_ && (request->buffer_index >= 0)) {
+        sqe->opcode = request->write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->buf_index = static_cast<uint16_t>(request->buffer_index);
+    } else {
+        sqe->opcode = request->write ? IORING_OP_WRITE : IORING_OP_READ;
+    }
+
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+    if(failing_submits_ > 0) {
+        --failing_submits_;
+    } else {
+        int submitted = -1;
+        do {
+            submitted = static_cast<int>(syscall(__NR_io_uring_enter, fd_, 1, 0, 0, nullptr, 0));
+        } while((submitted < 0) && (errno == EINTR));
+    }
+
+    // Whatever io_uring_enter returned, the entry is in flight once the
+    // kernel has moved the head past it
+    if(__atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) == tail) {
+        __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+        return false;
+    }
+
+    ++in_flight_;
+    return true;
+}
+
+bool IoRing::Reap() {
+    unsigned head = *cq_head_;
+
+    while(head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+        int ret = static_cast<int>(syscall(__NR_io_uring_enter, fd_, 0, 1, IORING_ENTER_GETEVENTS,
+                                           nullptr, 0));
+        if((ret < 0) && (errno != EINTR)) {
+            return false;
+        }
+    }
+
+    const struct io_uring_cqe *cqe = static_cast<struct io_uring_cqe*>(cqes_) + (head & *cq_mask_);
+    IoRequest *request = reinterpret_cast<IoRequest*>(cqe->user_data);
+    const int result = cqe->res;
+
+    __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+    --in_flight_;
+
+    Complete(request, result);
+    return true;
+}
+
+#else
+
+bool IoRing::Init(unsigned entries) {
+    (void)entries;
+    return false;
+}
+
+bool IoRing::RegisterBuffers(const struct iovec* buffers, unsigned num_buffers) {
+    (void)buffers;
+    (void)num_buffers;
+    return false;
+}
+
+bool IoRing::Queue(IoRequest* request) {
+    (void)request;
+    return false;
+}
+
+bool IoRing::Reap() {
+    return false;
+}
+
+#endif // ZJUMP_USE_IO_URING
+
+void IoRing::Close() {
+    if(sqes_ != nullptr) {
+        munmap(sqes_, sqes_size_);
+    }
+    if((cq_ring_ != nullptr) && (cq_ring_ != sq_ring_)) {
+        munmap(cq_ring_, cq_ring_size_);
+    }
+    if(sq_ring_ != nullptr) {
+        munmap(sq_ring_, sq_ring_size_);
+    }
+    if(fd_ >= 0) {
+        close(fd_);
+    }
+
+    fd_ = -1;
+    entries_ = 0;
+    in_flight_ = 0;
+    buffers_registered_ = false;
+    sq_ring_ = nullptr;
+    cq_ring_ = nullptr;
+    sqes_ = nullptr;
+}
+
+bool IoRing::IsOpen() const {
+    return fd_ >= 0;
+}
+
+bool IoRing::Start(IoRequest* request) {
+    assert(IsOpen());
+    assert(request != nullptr);
+    assert(!request->pending);
+
+    request->done = 0;
+    request->error = 0;
+
+    if(request->size == 0) {
+        return true;
+    }
+
+    request->pending = Queue(request);
+
+    if(!request->pending) {
+        request->error = EIO;
+    }
+
+    return request->pending;
+}
+
+bool IoRing::Wait(IoRequest* request) {
+    assert(request != nullptr);
+
+    while(request->pending) {
+        if(!Reap()) {
+            request->pending = false;
+            request->error = EIO;
+        }
+    }
+
+    return request->error == 0;
+}
+
+unsigned IoRing::InFlight() const {
+    return in_flight_;
+}
+
+void IoRing::FailSubmitsForTesting(unsigned count) {
+    failing_submits_ = count;
+}
+
+// Short transfers are resumed where they stopped, unless a read reaches the
+// end of the file.
+void IoRing::Complete(IoRequest* request, int result) {
+    if((result == -EINTR) || (result == -EAGAIN)) {
+        result = 0;
+    } else if(result < 0) {
+        request->error = -result;
+        request->pending = false;
+        return;
+    } else if(result == 0) {
+        if(request->write) {
+            request->error = EIO;
+        }
+        request->pending = false;
+        return;
+    }
+
+    request->done += static_cast<size_t>(result);
+
+    if(request->done >= request->size) {
+        request->pending = false;
+        return;
+    }
+
+    if(!Queue(request)) {
+        request->error = EIO;
+        request->pending = false;
+    }
+}
@@ -0,0 +1,116 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#ifndef IO_RING_H_
+#define IO_RING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// Number of blocks whose reads and writes Compressor and Decompressor keep in
+// flight through an IoRing.
+static const unsigned kIoRingBlocks = 4;
+
+// Whether file is a regular file that can be read and written at any offset
+// (e.g. not opened for appending), from its current position.
+bool SupportsPositionalIo(FILE* file);
+
+// Writes size bytes of data at offset of fd, whatever its file position is.
+bool WriteAt(int fd, const uint8_t* data, size_t size, off_t offset);
+
+// A read or write of size bytes of data at offset of fd. The ring completes
+// it even when the kernel transfers it in several pieces, so it is only
+// left short by the end of the file.
+struct IoRequest {
+    int fd;
+    uint8_t *data;
+    size_t size;
+    off_t offset;
+    // Index of the registered buffer that holds data, or -1
+    int buffer_index;
+    bool write;
+    // Set by the ring
+    size_t done;
+    bool pending;
+    int error;
+
+    IoRequest();
+};
+
+// IoRing class
+//
+// Asynchronous file I/O through io_uring, used by Compressor and
+// Decompressor to keep the reads and writes of several blocks in flight
+// while they process another one. It only works in builds with
+// ZJUMP_USE_IO_URING (CMake option, IO_URING=1 in make), on kernels that
+// support it; otherwise Init fails and files must be read and written as
+// usual.
+//
+// Requests are submitted as soon as they are started, and their completions
+// are reaped while waiting for any of them.
+class IoRing {
+public:
+    IoRing();
+
+    ~IoRing();
+
+    // Sets up a ring for up to entries requests in flight.
+    bool Init(unsigned entries);
+
+    void Close();
+
+    bool IsOpen() const;
+
+    // Registers buffers with the kernel, so their pages are not pinned again
+    // for every request. Requests on unregistered buffers (buffer_index -1)
+    // work anyway.
+    bool RegisterBuffers(const struct iovec* buffers, unsigned num_buffers);
+
+    // Starts request, which must be left alone until it is completed.
+    bool Start(IoRequest* request);
+
+    // Waits for request to complete. Returns false if it failed.
+    bool Wait(IoRequest* request);
+
+    unsigned InFlight() const;
+
+    // The next count submissions fail as if io_uring_enter had failed, so
+    // tests can check that nothing is left queued.
+    void FailSubmitsForTesting(unsigned count);
+
+private:
+    int fd_;
+    unsigned entries_;
+    unsigned in_flight_;
+    unsigned failing_submits_;
+    bool buffers_registered_;
+    void *sq_ring_;
+    size_t sq_ring_size_;
+    void *cq_ring_;
+    size_t cq_ring_size_;
+    void *sqes_;
+    size_t sqes_size_;
+    unsigned *sq_head_;
+    unsigned *sq_tail_;
+    unsigned *sq_mask_;
+    unsigned *sq_array_;
+    unsigned *cq_head_;
+    unsigned *cq_tail_;
+    unsigned *cq_mask_;
+    void *cqes_;
+
+    bool Queue(IoRequest* request);
+
+    // Reaps one completion, waiting for it if there is none yet.
+    bool Reap();
+
+    void Complete(IoRequest* request, int result);
+};
+
+#endif // IO_RING_H_
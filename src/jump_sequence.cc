@@ -12,6 +12,44 @@
 
 static const uint32_t kJSeqExtraSize = 8 + kStaticBitLengths[kEndOfSequenceSymbol];
 
+JstStats::JstStats() {
+    Clear();
+}
+
+void JstStats::Clear() {
+    passes.clear();
+    stream_size = 0;
+    padding_literals_size = 0;
+}
+
+uint32_t JstStats::NumJSeqs() const {
+    uint32_t n = 0;
+    for(size_t i=0; i<passes.size(); ++i) {
+        n += passes[i].num_jseqs;
+    }
+    return n;
+}
+
+uint32_t JstStats::NumSkipChunks() const {
+    uint32_t n = 0;
+    for(size_t i=0; i<passes.size(); ++i) {
+        n += passes[i].num_skip_chunks;
+    }
+    return n;
+}
+
+size_t JstStats::BytesMoved() const {
+    size_t n = 0;
+    for(size_t i=0; i<passes.size(); ++i) {
+        n += passes[i].bytes_moved;
+    }
+    return n;
+}
+
+double JstStats::PaddingLiteralFraction() const {
+    return (stream_size > 0) ? static_cast<double>(padding_literals_size) / stream_size : 0;
+}
+
 struct Jst::SearchingStepContext {
     uint8_t byte;
     uint32_t index;
@@ -67,9 +105,10 @@ struct Jst::SearchingContext {
     SearchingStepContext last_byte_step_ctx[256];
     SearchingStepContext best_step_ctx;
 
-    SearchingContext(uint32_t n_steps) {
+    // prev_step_index holds, at least, n_steps elements
+    SearchingContext(uint32_t n_steps, uint32_t* prev_step_index_workspace) {
         num_steps = n_steps;
-        prev_step_index = SecureAlloc<uint32_t>(n_steps);
+        prev_step_index = prev_step_index_workspace;
 
         prev_step_index[0] = 0;
 
@@ -80,10 +119,6 @@ struct Jst::SearchingContext {
         best_step_ctx.Init(0, 0);
     }
 
-    ~SearchingContext() {
-        SecureFree<uint32_t>(prev_step_index);
-    }
-
     void Update(uint8_t byte, uint32_t index) {
         if((index - last_byte_step_ctx[byte].index) > kMaxJumpSize) {
             last_byte_step_ctx[byte] = best_step_ctx;
@@ -108,36 +143,76 @@ Jst::Jst(uint8_t* stream, size_t stream_size) {
     block_ = nullptr;
 }
 
-ZjumpErrorCode Jst::Transform(ZjumpBlock* block) {
+ZjumpErrorCode Jst::Transform(ZjumpBlock* block, JstStats* stats) {
     assert(block != nullptr);
 
     block_ = block;
 
+    if(stats != nullptr) {
+        stats->Clear();
+        stats->stream_size = stream_size_;
+    }
+
+    if(!block_->ReserveMaxSizes()) {
+        return ZJUMP_ERROR_MEMORY_ALLOC;
+    }
+
+    // Every pass searches a smaller stream, so the workspace of the first
+    // one is reused by the rest
+    const size_t num_steps = stream_size_ + 1;
+    uint32_t *prev_step_index = Allocate<uint32_t>(block_->allocator, num_steps);
+    if(prev_step_index == nullptr) {
+        return ZJUMP_ERROR_MEMORY_ALLOC;
+    }
+
+    const size_t first_jseq_stream_size = block_->jseq_stream_size;
+
     while(stream_size_) {
-        SearchingContext search_ctx(stream_size_ + 1);
+        SearchingContext search_ctx(stream_size_ + 1, prev_step_index);
 
         SearchJumpSequences(&search_ctx);
 
-        if( search_ctx.best_step_ctx.jseqs_so_far == 0 ||
-            search_ctx.best_step_ctx.Reduction() <= 0) {
+        const SearchingStepContext &best = search_ctx.best_step_ctx;
+
+        if(best.jseqs_so_far == 0 || best.Reduction() <= 0) {
             break;
         }
 
-        uint16_t *jseq_stream = &block_->jseq_stream[block_->jseq_stream_size];
+        JstPassStats pass_stats;
+        pass_stats.stream_size = stream_size_;
+        pass_stats.num_jseqs = best.jseqs_so_far;
+        // Every symbol is a jump, a skip chunk or the end of a sequence
+        pass_stats.num_skip_chunks = best.symbols_so_far - best.bytes_so_far - best.jseqs_so_far;
+        pass_stats.reduction = best.Reduction();
+
+        uint8_t *jseq_stream = &block_->jseq_stream[block_->jseq_stream_size];
         size_t jseq_stream_size = AppendJumpSequences(search_ctx);
 
-        ShrinkStream(jseq_stream, jseq_stream_size);
+        pass_stats.bytes_moved = ShrinkStream(jseq_stream, jseq_stream_size);
 
         block_->jseq_stream[block_->jseq_stream_size++] = kShrinkStreamSymbol;
+
+        if(stats != nullptr) {
+            stats->passes.push_back(pass_stats);
+        }
     }
 
-    // remove the last kShrinkStreamSymbol, it is unnecesary
-    --block_->jseq_stream_size;
+    Deallocate<uint32_t>(block_->allocator, prev_step_index, num_steps);
+
+    // remove the last kShrinkStreamSymbol, it is unnecesary (there is none
+    // if no jump sequence was found)
+    if(block_->jseq_stream_size > first_jseq_stream_size) {
+        --block_->jseq_stream_size;
+    }
 
     // the remaining data is copied as padding literals
     std::copy_n(stream_, stream_size_, &(block_->padding_literals[block_->padding_literals_size]));
     block_->padding_literals_size += stream_size_;
 
+    if(stats != nullptr) {
+        stats->padding_literals_size = stream_size_;
+    }
+
     return ZJUMP_NO_ERROR;
 }
 
@@ -150,7 +225,7 @@ void Jst::SearchJumpSequences(SearchingContext *search_ctx) {
 size_t Jst::AppendJumpSequences(const SearchingContext& search_ctx) {
     size_t jseq_stream_len = search_ctx.best_step_ctx.symbols_so_far;
     size_t jseq_lit_len = search_ctx.best_step_ctx.jseqs_so_far;
-    uint16_t *jseq_stream_ptr = &block_->jseq_stream[block_->jseq_stream_size + jseq_stream_len - 1];
+    uint8_t *jseq_stream_ptr = &block_->jseq_stream[block_->jseq_stream_size + jseq_stream_len - 1];
     uint8_t *jseq_lit_ptr = &block_->jseq_literals[block_->jseq_literals_size + jseq_lit_len - 1];
     uint32_t cur_index = search_ctx.best_step_ctx.index;
 
@@ -168,23 +243,23 @@ size_t Jst::AppendJumpSequences(const SearchingContext& search_ctx) {
 
 void Jst::AddJumpSequenceBackward(const uint8_t byte,
                                   const SearchingContext& search_ctx,
-                                  uint16_t** jseq_stream_ptr,
+                                  uint8_t** jseq_stream_ptr,
                                   uint32_t* index) {
-    uint16_t *data = *jseq_stream_ptr;
+    uint8_t *data = *jseq_stream_ptr;
     uint32_t idx = *index;
 
     *(data--) = kEndOfSequenceSymbol;
 
     while(idx && (stream_[idx - 1] == byte)) {
         uint32_t jump = idx - search_ctx.prev_step_index[idx];
-        uint16_t *jump_pos_ptr = data--;
+        uint8_t *jump_pos_ptr = data--;
 
         while(jump > kMaxJumpSize) {
             *(data--) = kSkipChunkSymbol;
             jump -= kMaxJumpSize;
         }
 
-        *jump_pos_ptr = static_cast<uint16_t>(jump);
+        *jump_pos_ptr = static_cast<uint8_t>(jump);
 
         idx = search_ctx.prev_step_index[idx];
     }
@@ -193,8 +268,9 @@ void Jst::AddJumpSequenceBackward(const uint8_t byte,
     *index = idx;
 }
 
-void Jst::ShrinkStream(const uint16_t* jseq_stream,
-                       const size_t jseq_stream_size) {
+// Returns the number of bytes copied.
+size_t Jst::ShrinkStream(const uint8_t* jseq_stream,
+                         const size_t jseq_stream_size) {
     size_t i = 0;
     size_t n = 0;
 
@@ -226,19 +302,47 @@ void Jst::ShrinkStream(const uint16_t* jseq_stream,
     n += sz;
 
     stream_size_ = n;
+
+    return n;
 }
 
 InverseJst::InverseJst(const ZjumpBlock& block) : block_(block) {
+    max_output_size_ = std::min(block.padding_literals_size + block.jseq_stream_size,
+                                kBlockMaxExpandedStreamSize);
+}
+
+size_t InverseJst::MaxOutputSize() const {
+    return max_output_size_;
 }
 
 ZjumpErrorCode InverseJst::Transform(uint8_t* stream,
-                                     size_t* stream_size) {
+                                     size_t* stream_size,
+                                     JstStats* stats,
+                                     uint8_t* workspace) {
     assert(stream != nullptr);
     assert(stream_size != nullptr);
 
-    uint8_t *in = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+    if(stats != nullptr) {
+        stats->Clear();
+        stats->padding_literals_size = block_.padding_literals_size;
+    }
+
+    if(block_.padding_literals_size > max_output_size_) {
+        return ZJUMP_ERROR_RECONSTRUCTING_STREAM;
+    }
+
+    const bool own_workspace = (workspace == nullptr);
+    const size_t workspace_size = std::max<size_t>(max_output_size_, 1);
+    if(own_workspace) {
+        workspace = Allocate<uint8_t>(block_.allocator, workspace_size);
+        if(workspace == nullptr) {
+            return ZJUMP_ERROR_MEMORY_ALLOC;
+        }
+    }
+
+    uint8_t *in = workspace;
     size_t in_size = 0;
-    uint8_t *out = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+    uint8_t *out = stream;
     size_t out_size = 0;
 
     // The padding literals are copied into the output stream
@@ -251,7 +355,7 @@ ZjumpErrorCode InverseJst::Transform(uint8_t* stream,
         // Find the next piece of block_.jseq_stream that is going to be added to the stream
         // These pieces are separated by kShrinkStreamSymbol symbols
         // The pieces are processed in reverse order
-        uint16_t *jseq_stream = nullptr;
+        uint8_t *jseq_stream = nullptr;
         size_t jseq_stream_size = 0;
         uint8_t *jseq_literals = nullptr;
         size_t jseq_literals_size = 0;
@@ -284,37 +388,59 @@ ZjumpErrorCode InverseJst::Transform(uint8_t* stream,
 
         // Enlarge stream
         if(!EnlargeStream(jseq_literals, jseq_literals_size, jseq_stream, jseq_stream_size,
-                in, in_size, out, &out_size)) {
-            SecureFree<uint8_t>(in);
-            SecureFree<uint8_t>(out);
+                in, in_size, out, max_output_size_, &out_size)) {
+            if(own_workspace) {
+                Deallocate<uint8_t>(block_.allocator, workspace, workspace_size);
+            }
             return ZJUMP_ERROR_RECONSTRUCTING_STREAM;
         }
+
+        if(stats != nullptr) {
+            JstPassStats pass_stats;
+            pass_stats.stream_size = out_size;
+            pass_stats.num_jseqs = static_cast<uint32_t>(jseq_literals_size);
+            pass_stats.num_skip_chunks = static_cast<uint32_t>(
+                std::count(jseq_stream, jseq_stream + jseq_stream_size, kSkipChunkSymbol));
+            pass_stats.bytes_moved = out_size;
+            pass_stats.reduction = 0;
+            stats->passes.push_back(pass_stats);
+        }
     }
 
     if((i != 0) || (j != 0)) {
-        SecureFree<uint8_t>(in);
-        SecureFree<uint8_t>(out);
+        if(own_workspace) {
+            Deallocate<uint8_t>(block_.allocator, workspace, workspace_size);
+        }
         return ZJUMP_ERROR_RECONSTRUCTING_STREAM;
     }
 
     // Finally, the output params are set
-    std::copy_n(out, out_size, stream);
+    if(out != stream) {
+        std::copy_n(out, out_size, stream);
+    }
     *stream_size = out_size;
 
-    // Free the allocated variables
-    SecureFree<uint8_t>(in);
-    SecureFree<uint8_t>(out);
+    if(stats != nullptr) {
+        // The passes are undone from the last one to the first one
+        std::reverse(stats->passes.begin(), stats->passes.end());
+        stats->stream_size = out_size;
+    }
+
+    if(own_workspace) {
+        Deallocate<uint8_t>(block_.allocator, workspace, workspace_size);
+    }
 
     return ZJUMP_NO_ERROR;
 }
 
 bool InverseJst::EnlargeStream(const uint8_t* jseq_literals,
                                const size_t jseq_literals_size,
-                               const uint16_t* jseq_stream,
+                               const uint8_t* jseq_stream,
                                const size_t jseq_stream_size,
                                const uint8_t* in_data,
                                const size_t in_data_size,
                                uint8_t* out_data,
+                               const size_t out_data_capacity,
                                size_t* out_data_size) {
     size_t n = 0;
     size_t m = 0;
@@ -329,14 +455,22 @@ bool InverseJst::EnlargeStream(const uint8_t* jseq_literals,
             continue;
         }
 
+        if(j >= jseq_literals_size) {
+            return false;
+        }
+
         size_t sz = 0;
-        while(jseq_stream[i] == kSkipChunkSymbol) {
+        while((i < jseq_stream_size) && (jseq_stream[i] == kSkipChunkSymbol)) {
             sz += kMaxJumpSize;
             ++i;
         }
+
+        if(i == jseq_stream_size) {
+            return false;
+        }
         sz += jseq_stream[i] - 1u;
 
-        if((m + sz) > in_data_size) {
+        if(((m + sz) > in_data_size) || ((n + sz) >= out_data_capacity)) {
             return false;
         }
 
@@ -348,6 +482,9 @@ bool InverseJst::EnlargeStream(const uint8_t* jseq_literals,
     }
 
     size_t sz = in_data_size - m;
+    if((n + sz) > out_data_capacity) {
+        return false;
+    }
     std::copy_n(in_data+m, sz, out_data+n);
     n += sz;
     m += sz;
@@ -9,17 +9,56 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <vector>
 
 #include "block.h"
 #include "constants.h"
 
+// Counters of one pass of the transform, that is, one search of jump
+// sequences followed by a shrink (or an enlargement, when inverting) of the
+// stream.
+struct JstPassStats {
+    // Size of the stream before the pass shrinks it
+    size_t stream_size;
+    uint32_t num_jseqs;
+    uint32_t num_skip_chunks;
+    // Bytes copied by ShrinkStream (EnlargeStream when inverting)
+    size_t bytes_moved;
+    // Estimated number of bits saved by the pass (0 when inverting)
+    int reduction;
+};
+
+// Counters of the transform of a block.
+struct JstStats {
+    std::vector<JstPassStats> passes;
+    size_t stream_size;
+    size_t padding_literals_size;
+
+    JstStats();
+
+    void Clear();
+
+    uint32_t NumJSeqs() const;
+
+    uint32_t NumSkipChunks() const;
+
+    size_t BytesMoved() const;
+
+    // Fraction of the block that is left as padding literals.
+    double PaddingLiteralFraction() const;
+};
+
 // Jump Sequence Transform (Jst).
 // It turns a byte stream into a ZjumpBlock object.
+//
+// The arrays of the block are reserved with their largest sizes, and the
+// workspace of the search is allocated with the allocator of the block.
 class Jst {
 public:
     Jst(uint8_t* stream, size_t stream_size);
 
-    ZjumpErrorCode Transform(ZjumpBlock* block);
+    // The counters of the transform are stored in stats, if it is given.
+    ZjumpErrorCode Transform(ZjumpBlock* block, JstStats* stats = nullptr);
 
 private:
     struct SearchingContext;
@@ -35,32 +74,49 @@ private:
 
     void AddJumpSequenceBackward(const uint8_t byte,
                                  const SearchingContext& search_ctx,
-                                 uint16_t** jseq_stream_ptr,
+                                 uint8_t** jseq_stream_ptr,
                                  uint32_t* index);
 
-    void ShrinkStream(const uint16_t* jseq_stream,
-                      const size_t jseq_stream_size);
+    size_t ShrinkStream(const uint8_t* jseq_stream,
+                        const size_t jseq_stream_size);
 };
 
 // Inverse Jump Sequence Transform.
 // It produces a data stream from a ZjumpBlock object.
+//
+// Every pass enlarges the stream of the previous one, so the passes take
+// turns writing into the output stream and into a workspace of
+// MaxOutputSize() bytes.
 class InverseJst {
 public:
     InverseJst(const ZjumpBlock& block);
 
+    // Upper bound of the size of the stream that Transform produces: every
+    // jump adds a byte to the padding literals, and there are no more jumps
+    // than symbols in the jseq stream.
+    size_t MaxOutputSize() const;
+
+    // The counters of the transform are stored in stats, if it is given.
+    // Both stream and workspace, if given, must hold MaxOutputSize() bytes.
+    // Otherwise, a workspace is allocated for the call, with the allocator of
+    // the block.
     ZjumpErrorCode Transform(uint8_t* stream,
-                             size_t* stream_size);
+                             size_t* stream_size,
+                             JstStats* stats = nullptr,
+                             uint8_t* workspace = nullptr);
 
 private:
     const ZjumpBlock &block_;
+    size_t max_output_size_;
 
     bool EnlargeStream(const uint8_t* jseq_literals,
                        const size_t jseq_literals_size,
-                       const uint16_t* jseq_stream,
+                       const uint8_t* jseq_stream,
                        const size_t jseq_stream_size,
                        const uint8_t* in_data,
                        const size_t in_data_size,
                        uint8_t* out_data,
+                       const size_t out_data_capacity,
                        size_t* out_data_size);
 };
 
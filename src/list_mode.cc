@@ -0,0 +1,240 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include "list_mode.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "block.h"
+#include "block_index.h"
+#include "mem.h"
+
+StreamListing::StreamListing() {
+    compressed_size = 0;
+    uncompressed_size = 0;
+}
+
+double StreamListing::Ratio() const {
+    return (compressed_size > 0) ? static_cast<double>(uncompressed_size) / compressed_size : 0;
+}
+
+void StreamListing::BlockSizeRange(uint32_t* min_size, uint32_t* median_size, uint32_t* max_size) const {
+    if(block_sizes.empty()) {
+        *min_size = *median_size = *max_size = 0;
+        return;
+    }
+
+    std::vector<uint32_t> sorted(block_sizes);
+    std::sort(sorted.begin(), sorted.end());
+
+    *min_size = sorted.front();
+    *median_size = sorted[sorted.size() / 2];
+    *max_size = sorted.back();
+}
+
+StreamLister::StreamLister() {
+    in_file_ = nullptr;
+    seekable_ = false;
+    in_stream_ = SecureAlloc<uint8_t>(kBlockMaxCompressedStreamSize);
+    tables_stream_ = SecureAlloc<uint8_t>(kBlockMaxCompressedStreamSize);
+    out_stream_ = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+}
+
+StreamLister::~StreamLister() {
+    SecureFree<uint8_t>(in_stream_);
+    SecureFree<uint8_t>(tables_stream_);
+    SecureFree<uint8_t>(out_stream_);
+}
+
+ZjumpErrorCode StreamLister::List(FILE* in_file, StreamListing* listing) {
+    assert(in_file != nullptr);
+    assert(listing != nullptr);
+
+    in_file_ = in_file;
+    seekable_ = (fseeko(in_file, 0, SEEK_CUR) == 0);
+    *listing = StreamListing();
+    block_decomp_.Reset();
+
+    uint16_t num_blocks = 0;
+    ZjumpErrorCode ret_code = ReadInput(&num_blocks, 2);
+    if(ret_code != ZJUMP_NO_ERROR) {
+        return ret_code;
+    }
+
+    if(num_blocks == 0) {
+        return ZJUMP_ERROR_FORMAT_NUM_BLOCKS;
+    }
+
+    listing->compressed_size = 2;
+    listing->block_sizes.reserve(num_blocks);
+
+    ZjumpBlock header;
+    // The last block that carried Huffman encodings. Its offset is enough
+    // when the input can be read again; otherwise it is kept in
+    // tables_stream_.
+    bool has_tables = false;
+    off_t tables_offset = 0;
+    size_t tables_size = 0;
+    size_t block_size = 0;
+
+    for(uint16_t i=0; i<num_blocks; ++i) {
+        uint32_t block_length_field = 0;
+
+        ret_code = ReadInput(&block_length_field, 3);
+        if(ret_code != ZJUMP_NO_ERROR) {
+            return ret_code;
+        }
+
+        block_size = block_length_field;
+        if((block_size == 0) || (block_size > kBlockMaxCompressedStreamSize)) {
+            return ZJUMP_ERROR_FORMAT_BLOCK_LENGTH;
+        }
+
+        listing->compressed_size += 3 + block_size;
+        listing->block_sizes.push_back(block_length_field);
+
+        // The last block is decompressed below
+        if(i + 1 == num_blocks) {
+            ret_code = ReadInput(in_stream_, block_size);
+            if(ret_code != ZJUMP_NO_ERROR) {
+                return ret_code;
+            }
+            break;
+        }
+
+        const size_t header_size = std::min(block_size, kBlockMaxHeaderBytes);
+        ret_code = ReadInput(in_stream_, header_size);
+        if(ret_code != ZJUMP_NO_ERROR) {
+            return ret_code;
+        }
+
+        ret_code = block_decomp_.ReadHeader(in_stream_, header_size, &header);
+        if(ret_code != ZJUMP_NO_ERROR) {
+            return ret_code;
+        }
+
+        // FSE coded blocks leave the Huffman encodings as they are
+        if(header.huff_repeat && !has_tables) {
+            return ZJUMP_ERROR_FORMAT_HUFFMAN_REPEAT;
+        }
+
+        const bool carries_tables = !header.huff_repeat && !header.fse_coded;
+        if(carries_tables) {
+            has_tables = true;
+            tables_size = block_size;
+        }
+
+        if(carries_tables && !seekable_) {
+            std::memcpy(tables_stream_, in_stream_, header_size);
+            ret_code = ReadInput(tables_stream_ + header_size, block_size - header_size);
+        } else {
+            if(carries_tables) {
+                tables_offset = ftello(in_file_) - static_cast<off_t>(header_size);
+            }
+            ret_code = SkipInput(block_size - header_size);
+        }
+
+        if(ret_code != ZJUMP_NO_ERROR) {
+            return ret_code;
+        }
+    }
+
+    uint8_t single_byte;
+    if(fread(&single_byte, 1, 1, in_file_) == 1) {
+        return ZJUMP_ERROR_FORMAT_STREAM_TOO_LARGE;
+    }
+
+    ret_code = block_decomp_.ReadHeader(in_stream_, block_size, &header);
+    if(ret_code != ZJUMP_NO_ERROR) {
+        return ret_code;
+    }
+
+    if(header.huff_repeat) {
+        if(!has_tables) {
+            return ZJUMP_ERROR_FORMAT_HUFFMAN_REPEAT;
+        }
+
+        if(seekable_) {
+            if(fseeko(in_file_, tables_offset, SEEK_SET) != 0) {
+                return ZJUMP_ERROR_FILE;
+            }
+
+            ret_code = ReadInput(tables_stream_, tables_size);
+            if(ret_code != ZJUMP_NO_ERROR) {
+                return ret_code;
+            }
+        }
+
+        ret_code = block_decomp_.LoadTables(tables_stream_, tables_size);
+        if(ret_code != ZJUMP_NO_ERROR) {
+            return ret_code;
+        }
+    }
+
+    size_t out_size = 0;
+    ret_code = block_decomp_.Decompress(in_stream_, block_size, out_stream_, &out_size);
+    if(ret_code != ZJUMP_NO_ERROR) {
+        return ret_code;
+    }
+
+    listing->uncompressed_size = (num_blocks - 1) * kBlockMaxExpandedStreamSize + out_size;
+
+    return ZJUMP_NO_ERROR;
+}
+
+ZjumpErrorCode StreamLister::ReadInput(void* data, size_t size) {
+    size_t read = fread(data, 1, size, in_file_);
+
+    if(read != size) {
+        if(ferror(in_file_)) {
+            return ZJUMP_ERROR_FILE;
+        } else {
+            return ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT;
+        }
+    }
+
+    return ZJUMP_NO_ERROR;
+}
+
+// Seeking past the end of a file succeeds, so a truncated stream is only
+// noticed when the next length field cannot be read.
+ZjumpErrorCode StreamLister::SkipInput(size_t size) {
+    if(seekable_) {
+        if(fseeko(in_file_, static_cast<off_t>(size), SEEK_CUR) != 0) {
+            return ZJUMP_ERROR_FILE;
+        }
+        return ZJUMP_NO_ERROR;
+    }
+
+    while(size > 0) {
+        const size_t chunk = std::min(size, kBlockMaxExpandedStreamSize);
+
+        ZjumpErrorCode ret_code = ReadInput(out_stream_, chunk);
+        if(ret_code != ZJUMP_NO_ERROR) {
+            return ret_code;
+        }
+        size -= chunk;
+    }
+
+    return ZJUMP_NO_ERROR;
+}
+
+void PrintStreamListingHeader(FILE* file) {
+    fprintf(file, "%8s %14s %14s %7s %27s  %s\n",
+            "blocks", "compressed", "uncompressed", "ratio",
+            "block size (min/med/max)", "name");
+}
+
+void PrintStreamListing(FILE* file, const char* name, const StreamListing& listing) {
+    uint32_t min_size, median_size, max_size;
+    listing.BlockSizeRange(&min_size, &median_size, &max_size);
+
+    fprintf(file, "%8zu %14zu %14zu %7.3f %8u %8u %9u  %s\n",
+            listing.block_sizes.size(), listing.compressed_size, listing.uncompressed_size,
+            listing.Ratio(), min_size, median_size, max_size, name);
+}
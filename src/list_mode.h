@@ -0,0 +1,72 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#ifndef LIST_MODE_H_
+#define LIST_MODE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <sys/types.h>
+#include <vector>
+
+#include "block_decompressor.h"
+#include "constants.h"
+
+// Sizes of a compressed stream.
+struct StreamListing {
+    size_t compressed_size;
+    size_t uncompressed_size;
+    // Compressed size of every block
+    std::vector<uint32_t> block_sizes;
+
+    StreamListing();
+
+    double Ratio() const;
+
+    // Smallest, median and largest compressed block.
+    void BlockSizeRange(uint32_t* min_size, uint32_t* median_size, uint32_t* max_size) const;
+};
+
+// StreamLister class
+//
+// Reads the sizes of a stream from its block length fields, skipping the
+// payloads: with seeks when the input supports them, or by reading and
+// dropping them otherwise.
+//
+// Every block but the last one expands to kBlockMaxExpandedStreamSize bytes,
+// but the size of the last one is not recorded anywhere, so that single
+// block is decompressed, after loading the Huffman encodings it repeats, if
+// any.
+class StreamLister {
+public:
+    StreamLister();
+
+    ~StreamLister();
+
+    ZjumpErrorCode List(FILE* in_file, StreamListing* listing);
+
+private:
+    FILE *in_file_;
+    bool seekable_;
+    uint8_t *in_stream_;
+    uint8_t *tables_stream_;
+    uint8_t *out_stream_;
+    BlockDecompressor block_decomp_;
+
+    // Reads size bytes of the input into data.
+    ZjumpErrorCode ReadInput(void* data, size_t size);
+
+    ZjumpErrorCode SkipInput(size_t size);
+};
+
+// Prints the column names of PrintStreamListing.
+void PrintStreamListingHeader(FILE* file);
+
+// Prints a row with the sizes of a stream.
+void PrintStreamListing(FILE* file, const char* name, const StreamListing& listing);
+
+#endif // LIST_MODE_H_
@@ -0,0 +1,75 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile() {
+    map_ = nullptr;
+    map_size_ = 0;
+    offset_ = 0;
+}
+
+MappedFile::~MappedFile() {
+    Unmap();
+}
+
+bool MappedFile::Map(FILE* file) {
+    Unmap();
+
+    const int fd = fileno(file);
+    struct stat st;
+
+    if((fd < 0) || (fstat(fd, &st) != 0) || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+
+    const off_t pos = ftello(file);
+    if((pos < 0) || (pos >= st.st_size)) {
+        return false;
+    }
+
+    const size_t size = static_cast<size_t>(st.st_size);
+    void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(p == MAP_FAILED) {
+        return false;
+    }
+
+    madvise(p, size, MADV_SEQUENTIAL);
+    posix_fadvise(fd, pos, 0, POSIX_FADV_SEQUENTIAL);
+
+    map_ = static_cast<uint8_t*>(p);
+    map_size_ = size;
+    offset_ = static_cast<size_t>(pos);
+
+    return true;
+}
+
+void MappedFile::Unmap() {
+    if(map_ != nullptr) {
+        munmap(map_, map_size_);
+    }
+
+    map_ = nullptr;
+    map_size_ = 0;
+    offset_ = 0;
+}
+
+bool MappedFile::IsMapped() const {
+    return map_ != nullptr;
+}
+
+const uint8_t* MappedFile::Data() const {
+    return map_ + offset_;
+}
+
+size_t MappedFile::Size() const {
+    return map_size_ - offset_;
+}
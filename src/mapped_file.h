@@ -0,0 +1,45 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// MappedFile class
+//
+// Read-only memory mapping of the rest of a regular file, from the current
+// position of its FILE object, which is left untouched. The kernel is told
+// that the mapping is read sequentially, so it reads ahead aggressively and
+// drops the pages already read first.
+class MappedFile {
+public:
+    MappedFile();
+
+    ~MappedFile();
+
+    // Maps file. Returns false if it is not a regular file or it cannot be
+    // mapped, in which case it must be read with stdio.
+    bool Map(FILE* file);
+
+    void Unmap();
+
+    bool IsMapped() const;
+
+    // Data from the position file had when it was mapped.
+    const uint8_t* Data() const;
+
+    size_t Size() const;
+
+private:
+    uint8_t *map_;
+    size_t map_size_;
+    size_t offset_;
+};
+
+#endif // MAPPED_FILE_H_
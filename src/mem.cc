@@ -0,0 +1,86 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include "mem.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <sys/mman.h>
+
+static size_t HugePageLength(size_t size) {
+    return ((size + kHugePageSize - 1) / kHugePageSize) * kHugePageSize;
+}
+
+// The memory is backed by huge pages when the system has them reserved
+// (MAP_HUGETLB). Otherwise, transparent huge pages are requested for it.
+// Regular mappings are only aligned to pages, so alignment bytes more are
+// mapped and the parts before and after the first aligned length bytes are
+// unmapped.
+static void* LargePageAlloc(size_t size, size_t alignment) {
+    const size_t length = HugePageLength(size);
+
+    void *p = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(p != MAP_FAILED) {
+        if(reinterpret_cast<uintptr_t>(p) % alignment == 0) {
+            return p;
+        }
+        munmap(p, length);
+    }
+
+    p = mmap(nullptr, length + alignment, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(p == MAP_FAILED) {
+        return nullptr;
+    }
+
+    uint8_t *start = static_cast<uint8_t*>(p);
+    uint8_t *aligned = reinterpret_cast<uint8_t*>(
+        (reinterpret_cast<uintptr_t>(start) + alignment - 1) & ~(alignment - 1));
+    const size_t head = static_cast<size_t>(aligned - start);
+
+    if(head > 0) {
+        munmap(start, head);
+    }
+    munmap(aligned + length, alignment - head);
+
+    madvise(aligned, length, MADV_HUGEPAGE);
+
+    return aligned;
+}
+
+static void* DefaultAlloc(void* opaque, size_t size, size_t alignment) {
+    (void)opaque;
+
+    if(alignment >= kHugePageSize) {
+        return LargePageAlloc(size, alignment);
+    }
+
+    if(alignment <= alignof(std::max_align_t)) {
+        return malloc(size);
+    }
+
+    void *p = nullptr;
+    if(posix_memalign(&p, alignment, size) != 0) {
+        return nullptr;
+    }
+    return p;
+}
+
+static void DefaultFree(void* opaque, void* address, size_t size, size_t alignment) {
+    (void)opaque;
+
+    if(alignment >= kHugePageSize) {
+        munmap(address, HugePageLength(size));
+    } else {
+        free(address);
+    }
+}
+
+const ZjumpAllocator* DefaultAllocator() {
+    static const ZjumpAllocator allocator = {DefaultAlloc, DefaultFree, nullptr};
+    return &allocator;
+}
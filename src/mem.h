@@ -7,13 +7,105 @@
 #ifndef MEM_H_
 #define MEM_H_
 
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <cstdlib>
 #include <new>
+#include <utility>
 
 #include "constants.h"
 
+// ZjumpAllocator struct
+//
+// Callbacks through which compression and decompression contexts get their
+// memory. alloc returns size bytes aligned to alignment (a power of two), or
+// nullptr when they cannot be allocated, which makes the call that needed
+// them fail with ZJUMP_ERROR_MEMORY_ALLOC. free is given back the same size
+// and alignment. opaque is passed to both of them.
+//
+// Large workspaces that are accessed randomly, such as the suffix array of
+// the BWT, are requested with kHugePageSize alignment, so they can be backed
+// by huge pages.
+struct ZjumpAllocator {
+    void* (*alloc)(void* opaque, size_t size, size_t alignment);
+    void (*free)(void* opaque, void* address, size_t size, size_t alignment);
+    void *opaque;
+};
+
+static const size_t kHugePageSize = 2 * 1024 * 1024;
+
+// Allocator used when none is given: the heap, and for kHugePageSize aligned
+// requests, huge pages when the system has them reserved (MAP_HUGETLB), or
+// transparent huge pages otherwise.
+const ZjumpAllocator* DefaultAllocator();
+
+// allocator, or the default one when it is null.
+inline const ZjumpAllocator* AllocatorOrDefault(const ZjumpAllocator* allocator) {
+    return (allocator != nullptr) ? allocator : DefaultAllocator();
+}
+
+// Allocates an array of size elements through allocator. Returns nullptr
+// when it cannot be allocated.
+template<typename T>
+T* Allocate(const ZjumpAllocator* allocator, size_t size, size_t alignment = alignof(T)) {
+    assert(size > 0);
+    return static_cast<T*>(allocator->alloc(allocator->opaque, size * sizeof(T), alignment));
+}
+
+// Frees an array returned by Allocate, given the same size and alignment.
+template<typename T>
+void Deallocate(const ZjumpAllocator* allocator, T* address, size_t size, size_t alignment = alignof(T)) {
+    if(address != nullptr) {
+        allocator->free(allocator->opaque, address, size * sizeof(T), alignment);
+    }
+}
+
+// Makes *address, an array of *capacity elements (none when it is null), hold
+// at least size elements. When it has to be reallocated, its first used
+// elements are kept and *capacity is set to size. Returns false, leaving the
+// array as it was, when it cannot be reallocated.
+template<typename T>
+bool Grow(const ZjumpAllocator* allocator, T** address, size_t* capacity, size_t used, size_t size) {
+    assert(used <= *capacity);
+    if(size <= *capacity) {
+        return true;
+    }
+
+    T *p = Allocate<T>(allocator, size);
+    if(p == nullptr) {
+        return false;
+    }
+
+    std::copy_n(*address, used, p);
+    Deallocate<T>(allocator, *address, *capacity);
+    *address = p;
+    *capacity = size;
+
+    return true;
+}
+
+// Creates an object through allocator, passing args to its constructor.
+// Returns nullptr when it cannot be allocated.
+template<typename T, typename... Args>
+T* NewObject(const ZjumpAllocator* allocator, Args&&... args) {
+    void *p = allocator->alloc(allocator->opaque, sizeof(T), alignof(T));
+    if(p == nullptr) {
+        return nullptr;
+    }
+    return new (p) T(std::forward<Args>(args)...);
+}
+
+template<typename T>
+void DeleteObject(const ZjumpAllocator* allocator, T* object) {
+    if(object != nullptr) {
+        object->~T();
+        allocator->free(allocator->opaque, object, sizeof(T), alignof(T));
+    }
+}
+
+// Allocation for the command line tool, which exits when there is no memory
+// left. Library code goes through a ZjumpAllocator instead.
 template<typename T>
 T* SecureAlloc(size_t size) {
     assert(size > 0);
@@ -10,7 +10,7 @@
 
 #include "constants.h"
 
-static void AppendRle1(uint32_t length, uint16_t* stream, size_t* stream_size) {
+static void AppendRle1(uint32_t length, uint8_t* stream, size_t* stream_size) {
     uint32_t run_a = 1;
     uint32_t run_b = 2;
     size_t n = *stream_size;
@@ -32,7 +32,7 @@ static void AppendRle1(uint32_t length, uint16_t* stream, size_t* stream_size) {
 }
 
 static void AppendOnes(const uint32_t length,
-                       uint16_t* stream,
+                       uint8_t* stream,
                        size_t* stream_size) {
     size_t n = *stream_size;
 
@@ -43,9 +43,9 @@ static void AppendOnes(const uint32_t length,
     *stream_size = n;
 }
 
-static uint32_t EncodeOnes(const uint16_t* in,
+static uint32_t EncodeOnes(const uint8_t* in,
                            const size_t in_size,
-                           uint16_t* out,
+                           uint8_t* out,
                            size_t* out_size) {
     uint32_t length = 0;
 
@@ -58,37 +58,36 @@ static uint32_t EncodeOnes(const uint16_t* in,
     return length;
 }
 
-static uint32_t DecodeRle1(const uint16_t* in,
-                           const size_t in_size,
-                           uint16_t* out,
-                           size_t* out_size) {
+// Reads the run of RUNA/RUNB symbols at the start of in into length, and
+// returns the number of symbols it takes.
+static uint32_t ReadRle1Run(const uint8_t* in,
+                            const size_t in_size,
+                            uint32_t* length) {
     uint32_t p = 1;
-    uint32_t length = 0;
     uint32_t i = 0;
 
+    *length = 0;
+
     for(; i<in_size; ++i) {
         if(in[i] == kRUNASymbol) {
-            length += p;
+            *length += p;
         } else if(in[i] == kRUNBSymbol) {
-            length += (p << 1);
+            *length += (p << 1);
         } else {
             break;
         }
         p <<= 1;
     }
 
-    AppendOnes(length, out, out_size);
-
     return i;
 }
 
-void Rle1(const uint16_t* in,
+void Rle1(const uint8_t* in,
           const size_t in_size,
-          uint16_t* out,
+          uint8_t* out,
           size_t* out_size) {
     assert(in != nullptr);
     assert(out != nullptr);
-    assert(in_size > 0);
 
     size_t n = 0;
 
@@ -104,26 +103,55 @@ void Rle1(const uint16_t* in,
     *out_size = n;
 }
 
-void InverseRle1(const uint16_t* in,
+bool InverseRle1(const uint8_t* in,
                  const size_t in_size,
-                 uint16_t* out,
+                 uint8_t* out,
+                 const size_t out_capacity,
                  size_t* out_size) {
-    assert(in != nullptr);
-    assert(out != nullptr);
-    assert(in_size > 0);
-    assert(in != out);
+    assert((in != nullptr) || (in_size == 0));
+    assert((out != nullptr) || (out_capacity == 0));
+    assert((in != out) || (in == nullptr));
 
     size_t n = 0;
 
     for(size_t i=0; i<in_size; ) {
-        uint32_t len = DecodeRle1(&(in[i]), (in_size - i), out, &n);
+        uint32_t length = 0;
+        uint32_t len = ReadRle1Run(&(in[i]), (in_size - i), &length);
         if(len) {
+            if(length > out_capacity - n) {
+                return false;
+            }
+            AppendOnes(length, out, &n);
             i += len;
         } else {
+            if(n == out_capacity) {
+                return false;
+            }
             out[n++] = in[i++];
         }
     }
 
     *out_size = n;
+
+    return true;
 }
 
+size_t InverseRle1Size(const uint8_t* in, const size_t in_size) {
+    assert((in != nullptr) || (in_size == 0));
+
+    size_t n = 0;
+
+    for(size_t i=0; i<in_size; ) {
+        uint32_t length = 0;
+        uint32_t len = ReadRle1Run(&(in[i]), (in_size - i), &length);
+        if(len) {
+            i += len;
+            n += length;
+        } else {
+            ++n;
+            ++i;
+        }
+    }
+
+    return n;
+}
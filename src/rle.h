@@ -10,15 +10,21 @@
 #include <cstddef>
 #include <cstdint>
 
-void Rle1(const uint16_t* in,
+void Rle1(const uint8_t* in,
           const size_t in_size,
-          uint16_t* out,
+          uint8_t* out,
           size_t* out_size);
 
-void InverseRle1(const uint16_t* in,
+// Returns false, leaving out incomplete, when the expanded stream does not fit
+// in the out_capacity symbols of out.
+bool InverseRle1(const uint8_t* in,
                  const size_t in_size,
-                 uint16_t* out,
+                 uint8_t* out,
+                 const size_t out_capacity,
                  size_t* out_size);
 
+// Number of symbols that InverseRle1 expands in to.
+size_t InverseRle1Size(const uint8_t* in, const size_t in_size);
+
 #endif // RLE_H_
 
@@ -0,0 +1,195 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include "stats.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+const char* StatsStageName(StatsStage stage) {
+    switch(stage) {
+        case kStatsStageIo:             return "I/O";
+        case kStatsStageBwt:            return "BWT";
+        case kStatsStageJst:            return "JST";
+        case kStatsStageJSeqCoding:     return "jseq coding";
+        case kStatsStageRle:            return "RLE";
+        case kStatsStageEntropyTables:  return "entropy tables";
+        case kStatsStageBitStream:      return "bit stream";
+        default:                        return "unknown";
+    }
+}
+
+BlockStats::BlockStats() {
+    Clear();
+}
+
+void BlockStats::Clear() {
+    std::memset(stage_nanos, 0, sizeof(stage_nanos));
+    jst.Clear();
+}
+
+uint64_t BlockStats::TotalNanos() const {
+    uint64_t total = 0;
+    for(int s=0; s<kNumStatsStages; ++s) {
+        total += stage_nanos[s];
+    }
+    return total;
+}
+
+StreamStats::StreamStats() {}
+
+void StreamStats::Clear() {
+    blocks_.clear();
+}
+
+void StreamStats::AddBlock(const BlockStats& block_stats) {
+    blocks_.push_back(block_stats);
+}
+
+size_t StreamStats::NumBlocks() const {
+    return blocks_.size();
+}
+
+uint64_t StreamStats::TotalNanos(StatsStage stage) const {
+    uint64_t total = 0;
+    for(size_t i=0; i<blocks_.size(); ++i) {
+        total += blocks_[i].stage_nanos[stage];
+    }
+    return total;
+}
+
+// Nearest-rank percentile.
+template<typename T>
+static T Percentile(std::vector<T> values, double percentile) {
+    assert((percentile >= 0) && (percentile <= 100));
+
+    if(values.empty()) {
+        return 0;
+    }
+
+    std::sort(values.begin(), values.end());
+
+    size_t rank = static_cast<size_t>(std::ceil(percentile / 100 * values.size()));
+    if(rank > 0) {
+        --rank;
+    }
+
+    return values[rank];
+}
+
+uint64_t StreamStats::PercentileNanos(StatsStage stage, double percentile) const {
+    std::vector<uint64_t> nanos(blocks_.size());
+    for(size_t i=0; i<blocks_.size(); ++i) {
+        nanos[i] = blocks_[i].stage_nanos[stage];
+    }
+
+    return Percentile(nanos, percentile);
+}
+
+const BlockStats& StreamStats::Block(size_t index) const {
+    assert(index < blocks_.size());
+    return blocks_[index];
+}
+
+size_t StreamStats::MemoryFootprint() const {
+    return sizeof(*this) + blocks_.capacity() * sizeof(BlockStats);
+}
+
+static void PrintJstCounter(FILE* file,
+                            const char* name,
+                            const std::vector<double>& values) {
+    double total = 0;
+    for(size_t i=0; i<values.size(); ++i) {
+        total += values[i];
+    }
+
+    fprintf(file, "%-22s %14.0f %10.1f %10.1f %10.1f %10.1f\n",
+            name, total,
+            Percentile(values, 50), Percentile(values, 90),
+            Percentile(values, 99), Percentile(values, 100));
+}
+
+static void PrintJstStats(FILE* file, const StreamStats& stats) {
+    const size_t num_blocks = stats.NumBlocks();
+    std::vector<double> passes(num_blocks);
+    std::vector<double> jseqs(num_blocks);
+    std::vector<double> skip_chunks(num_blocks);
+    std::vector<double> bytes_moved(num_blocks);
+    std::vector<double> reduction(num_blocks);
+    std::vector<double> padding(num_blocks);
+    size_t stream_size = 0;
+    size_t padding_literals_size = 0;
+    bool has_reduction = false;
+
+    for(size_t i=0; i<num_blocks; ++i) {
+        const JstStats &jst = stats.Block(i).jst;
+
+        passes[i] = static_cast<double>(jst.passes.size());
+        jseqs[i] = jst.NumJSeqs();
+        skip_chunks[i] = jst.NumSkipChunks();
+        bytes_moved[i] = static_cast<double>(jst.BytesMoved());
+        padding[i] = 100 * jst.PaddingLiteralFraction();
+
+        reduction[i] = 0;
+        for(size_t p=0; p<jst.passes.size(); ++p) {
+            reduction[i] += jst.passes[p].reduction / 8.0;
+            has_reduction = has_reduction || (jst.passes[p].reduction != 0);
+        }
+
+        stream_size += jst.stream_size;
+        padding_literals_size += jst.padding_literals_size;
+    }
+
+    fprintf(file, "%-22s %14s %10s %10s %10s %10s\n",
+            "jst (per block)", "total", "p50", "p90", "p99", "max");
+    PrintJstCounter(file, "passes", passes);
+    PrintJstCounter(file, "jump sequences", jseqs);
+    PrintJstCounter(file, "skip chunks", skip_chunks);
+    PrintJstCounter(file, "bytes moved", bytes_moved);
+    // The inverse transform estimates nothing, so decompressed streams have
+    // no reduction to show
+    if(has_reduction) {
+        PrintJstCounter(file, "est. reduction (bytes)", reduction);
+    }
+    fprintf(file, "%-22s %13.1f%% %9.1f%% %9.1f%% %9.1f%% %9.1f%%\n",
+            "padding literals",
+            (stream_size > 0) ? 100.0 * padding_literals_size / stream_size : 0.0,
+            Percentile(padding, 50), Percentile(padding, 90),
+            Percentile(padding, 99), Percentile(padding, 100));
+}
+
+void PrintStreamStats(FILE* file, const StreamStats& stats) {
+    uint64_t total = 0;
+    for(int s=0; s<kNumStatsStages; ++s) {
+        total += stats.TotalNanos(static_cast<StatsStage>(s));
+    }
+
+    fprintf(file, "%zu blocks, %.3f ms\n", stats.NumBlocks(), total / 1e6);
+    fprintf(file, "%-16s %12s %7s %10s %10s %10s %10s\n",
+            "stage", "total (ms)", "share", "p50 (us)", "p90 (us)", "p99 (us)", "max (us)");
+
+    for(int s=0; s<kNumStatsStages; ++s) {
+        const StatsStage stage = static_cast<StatsStage>(s);
+        const uint64_t stage_total = stats.TotalNanos(stage);
+
+        if(stage_total == 0) {
+            continue;
+        }
+
+        fprintf(file, "%-16s %12.3f %6.1f%% %10.1f %10.1f %10.1f %10.1f\n",
+                StatsStageName(stage),
+                stage_total / 1e6,
+                (total > 0) ? 100.0 * stage_total / total : 0.0,
+                stats.PercentileNanos(stage, 50) / 1e3,
+                stats.PercentileNanos(stage, 90) / 1e3,
+                stats.PercentileNanos(stage, 99) / 1e3,
+                stats.PercentileNanos(stage, 100) / 1e3);
+    }
+
+    PrintJstStats(file, stats);
+}
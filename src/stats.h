@@ -0,0 +1,127 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "jump_sequence.h"
+
+// Per-stage timing of compression and decompression.
+//
+// Stage timers are only compiled in when ZJUMP_STATS is defined (-DZJUMP_STATS=ON
+// in CMake, STATS=1 in make). Otherwise StageTimer is an empty policy class
+// whose methods compile to nothing.
+
+// Reading the tables of a block is part of the bit stream stage when
+// decompressing.
+typedef enum {
+    kStatsStageIo,
+    kStatsStageBwt,
+    kStatsStageJst,
+    kStatsStageJSeqCoding,
+    kStatsStageRle,
+    kStatsStageEntropyTables,
+    kStatsStageBitStream,
+    kNumStatsStages
+} StatsStage;
+
+const char* StatsStageName(StatsStage stage);
+
+// Nanoseconds spent on every stage of a block, and the counters of its Jst.
+struct BlockStats {
+    uint64_t stage_nanos[kNumStatsStages];
+    JstStats jst;
+
+    BlockStats();
+
+    void Clear();
+
+    uint64_t TotalNanos() const;
+};
+
+// Timer that charges the time elapsed since the previous lap (or since it was
+// started) to a stage of a BlockStats.
+class ChronoStageTimer {
+public:
+    static const bool kEnabled = true;
+
+    explicit ChronoStageTimer(BlockStats* stats) :
+        stats_(stats),
+        last_(std::chrono::steady_clock::now()) {}
+
+    void Restart() {
+        last_ = std::chrono::steady_clock::now();
+    }
+
+    void Lap(StatsStage stage) {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        stats_->stage_nanos[stage] += static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_).count());
+        last_ = now;
+    }
+
+private:
+    BlockStats *stats_;
+    std::chrono::steady_clock::time_point last_;
+};
+
+class NullStageTimer {
+public:
+    static const bool kEnabled = false;
+
+    explicit NullStageTimer(BlockStats*) {}
+
+    void Restart() {}
+
+    void Lap(StatsStage) {}
+};
+
+#ifdef ZJUMP_STATS
+typedef ChronoStageTimer StageTimer;
+#else
+typedef NullStageTimer StageTimer;
+#endif
+
+// StreamStats class
+//
+// Collects the stats of every block of a stream.
+class StreamStats {
+public:
+    StreamStats();
+
+    void Clear();
+
+    void AddBlock(const BlockStats& block_stats);
+
+    size_t NumBlocks() const;
+
+    uint64_t TotalNanos(StatsStage stage) const;
+
+    // Returns the time spent on stage by the block at the given percentile
+    // (0 to 100) of the blocks, sorted by that time.
+    uint64_t PercentileNanos(StatsStage stage, double percentile) const;
+
+    const BlockStats& Block(size_t index) const;
+
+    // Bytes of the object and the stats of its blocks.
+    size_t MemoryFootprint() const;
+
+private:
+    std::vector<BlockStats> blocks_;
+};
+
+// Prints the total time of every stage, its share of the whole stream and
+// the per-block percentiles, followed by the Jst counters. The estimated
+// reduction is only printed for compressed streams.
+void PrintStreamStats(FILE* file, const StreamStats& stats);
+
+#endif // STATS_H_
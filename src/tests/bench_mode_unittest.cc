@@ -0,0 +1,45 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../bench_mode.h"
+#include "../constants.h"
+#include "test_data.h"
+
+TEST(InMemoryBenchTest, SeveralBlocks) {
+    std::vector<uint8_t> data = MakeWordData(120000, 5);
+    InMemoryBench bench(data.data(), data.size());
+    BenchResult result;
+
+    ASSERT_EQ(ZJUMP_NO_ERROR, bench.Run(50000, 1, 2, &result));
+
+    EXPECT_EQ(50000u, result.block_size);
+    EXPECT_EQ(1, result.num_threads);
+    EXPECT_EQ(data.size(), result.in_size);
+    EXPECT_GT(result.compressed_size, 0u);
+    EXPECT_LT(result.compressed_size, data.size());
+    EXPECT_LE(result.min_compress_time, result.median_compress_time);
+    EXPECT_LE(result.min_decompress_time, result.median_decompress_time);
+    EXPECT_GT(result.Ratio(), 1.0);
+}
+
+TEST(InMemoryBenchTest, BlockSizes) {
+    std::vector<uint8_t> data = MakeWordData(kBlockMaxExpandedStreamSize + 1000, 5);
+    InMemoryBench bench(data.data(), data.size());
+    BenchResult small_blocks;
+    BenchResult large_blocks;
+
+    ASSERT_EQ(ZJUMP_NO_ERROR, bench.Run(1000, 1, 1, &small_blocks));
+    ASSERT_EQ(ZJUMP_NO_ERROR, bench.Run(kBlockMaxExpandedStreamSize, 1, 1, &large_blocks));
+
+    // The headers of a .zjump file: 2 bytes, plus 3 bytes per block.
+    EXPECT_GT(small_blocks.compressed_size, 2 + 3 * 202u);
+    EXPECT_LT(large_blocks.compressed_size, small_blocks.compressed_size);
+}
@@ -0,0 +1,144 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include <cstdint>
+#include <cstring>
+
+#include "gtest/gtest.h"
+
+#include "../block_compressor.h"
+#include "../block_decompressor.h"
+#include "../constants.h"
+#include "../mem.h"
+
+// Fills data with words drawn from a different vocabulary in each half, so
+// that the jseq stream of a block is not uniform.
+static void FillMixedText(uint8_t* data, const size_t data_size, uint32_t seed) {
+    static const char *kWords[] = {
+        "alpha ", "beta ", "gamma ", "delta ", "epsilon ", "zeta ",
+        "0x1F3A ", "0x0042 ", "=> ", "[ok] ", "[err] ", "12:30:45 "
+    };
+    size_t i = 0;
+
+    while(i < data_size) {
+        seed = seed * 1103515245u + 12345u;
+        const size_t base = (i < data_size / 2) ? 0 : 6;
+        const char *word = kWords[base + (seed >> 16) % 6];
+
+        for(size_t j=0; (word[j] != '\0') && (i < data_size); ++j) {
+            data[i++] = static_cast<uint8_t>(word[j]);
+        }
+    }
+}
+
+static void ExpectBlocksRestored(BlockCompressor* comp,
+                                 BlockDecompressor* decomp,
+                                 const size_t num_blocks,
+                                 const size_t block_size) {
+    uint8_t *data = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+    uint8_t *compressed = SecureAlloc<uint8_t>(kBlockMaxCompressedStreamSize);
+    uint8_t *restored = SecureAlloc<uint8_t>(kBlockMaxCompressedStreamSize);
+
+    comp->Reset();
+    decomp->Reset();
+
+    for(size_t b=0; b<num_blocks; ++b) {
+        size_t compressed_size = 0;
+        size_t restored_size = 0;
+
+        FillMixedText(data, block_size, static_cast<uint32_t>(b));
+        std::memcpy(restored, data, block_size);
+
+        ASSERT_EQ(ZJUMP_NO_ERROR, comp->Compress(restored, block_size, compressed, &compressed_size));
+        ASSERT_EQ(ZJUMP_NO_ERROR, decomp->Decompress(compressed, compressed_size, restored, &restored_size));
+        ASSERT_EQ(block_size, restored_size);
+        EXPECT_EQ(0, std::memcmp(data, restored, block_size));
+    }
+
+    SecureFree<uint8_t>(data);
+    SecureFree<uint8_t>(compressed);
+    SecureFree<uint8_t>(restored);
+}
+
+TEST(BlockCompressorTest, SmallBlocks) {
+    BlockCompressor comp;
+    BlockDecompressor decomp;
+
+    ExpectBlocksRestored(&comp, &decomp, 4, 1000);
+}
+
+TEST(BlockCompressorTest, LargeBlocks) {
+    BlockCompressor comp;
+    BlockDecompressor decomp;
+
+    ExpectBlocksRestored(&comp, &decomp, 3, kBlockMaxExpandedStreamSize);
+}
+
+TEST(BlockCompressorTest, StreamsAfterReset) {
+    BlockCompressor comp;
+    BlockDecompressor decomp;
+
+    ExpectBlocksRestored(&comp, &decomp, 2, 50000);
+    ExpectBlocksRestored(&comp, &decomp, 2, 50000);
+}
+
+// Compresses block_size bytes of data as the first block of a stream and
+// checks that they are restored. The block is left in comp->LastBlock().
+static void ExpectBlockRestored(BlockCompressor* comp, const uint8_t* data, const size_t block_size) {
+    BlockDecompressor decomp;
+    uint8_t *compressed = SecureAlloc<uint8_t>(kBlockMaxCompressedStreamSize);
+    uint8_t *restored = SecureAlloc<uint8_t>(kBlockMaxCompressedStreamSize);
+    size_t compressed_size = 0;
+    size_t restored_size = 0;
+
+    std::memcpy(restored, data, block_size);
+    comp->Reset();
+
+    ASSERT_EQ(ZJUMP_NO_ERROR, comp->Compress(restored, block_size, compressed, &compressed_size));
+    ASSERT_EQ(ZJUMP_NO_ERROR, decomp.Decompress(compressed, compressed_size, restored, &restored_size));
+    ASSERT_EQ(block_size, restored_size);
+    EXPECT_EQ(0, std::memcmp(data, restored, block_size));
+
+    SecureFree<uint8_t>(compressed);
+    SecureFree<uint8_t>(restored);
+}
+
+// Two vocabularies give the jseq stream regions with different statistics,
+// which a single Huffman encoding codes worse than several.
+TEST(BlockCompressorTest, MixedStatisticsUseSeveralEncodings) {
+    uint8_t *data = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+    FillMixedText(data, kBlockMaxExpandedStreamSize, 1);
+
+    BlockCompressor comp;
+    ExpectBlockRestored(&comp, data, kBlockMaxExpandedStreamSize);
+
+    const ZjumpBlock &block = comp.LastBlock();
+    EXPECT_FALSE(block.fse_coded);
+    EXPECT_GT(block.num_huff_encodings, 1);
+    EXPECT_EQ((block.jseq_stream_size + kBlockHuffmanGroupSize - 1) / kBlockHuffmanGroupSize,
+              block.num_huff_selectors);
+
+    SecureFree<uint8_t>(data);
+}
+
+// When a byte makes 90% of the block, most symbols would take a full bit
+// with Huffman codes, and FSE codes them with less.
+TEST(BlockCompressorTest, SkewedAlphabetIsFseCoded) {
+    const size_t block_size = 100000;
+    uint8_t *data = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+    uint32_t seed = 1;
+
+    for(size_t i=0; i<block_size; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        data[i] = ((seed >> 16) % 10 == 0) ? static_cast<uint8_t>(seed >> 24) : 'a';
+    }
+
+    BlockCompressor comp;
+    ExpectBlockRestored(&comp, data, block_size);
+    EXPECT_TRUE(comp.LastBlock().fse_coded);
+
+    SecureFree<uint8_t>(data);
+}
@@ -0,0 +1,153 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../block_decompressor.h"
+#include "../block_index.h"
+#include "../compress.h"
+#include "../constants.h"
+#include "test_data.h"
+
+// Compressed blocks of data, without their length fields.
+static std::vector<std::vector<uint8_t> > CompressBlocks(const std::vector<uint8_t>& data) {
+    FILE *out_file = CompressToFile(data);
+    std::vector<std::vector<uint8_t> > blocks;
+    uint16_t num_blocks = 0;
+
+    EXPECT_EQ(1u, fread(&num_blocks, 2, 1, out_file));
+
+    for(uint16_t i=0; i<num_blocks; ++i) {
+        uint32_t block_size = 0;
+        EXPECT_EQ(3u, fread(&block_size, 1, 3, out_file));
+
+        // Room for the bytes that bit stream readers load past the end, which
+        // is kept by moving the block instead of copying it
+        std::vector<uint8_t> block(block_size + kBlockReadPaddingBytes);
+        EXPECT_EQ(block_size, fread(block.data(), 1, block_size, out_file));
+        block.resize(block_size);
+        blocks.push_back(std::move(block));
+    }
+
+    fclose(out_file);
+    return blocks;
+}
+
+static void ExpectBlockRestores(BlockDecompressor* block_decomp,
+                                std::vector<uint8_t>* block,
+                                const uint8_t* expected,
+                                size_t expected_size) {
+    uint8_t *out = nullptr;
+    size_t out_size = 0;
+
+    ASSERT_EQ(ZJUMP_NO_ERROR, block_decomp->Decompress(block->data(), block->size(), &out, &out_size));
+    ASSERT_EQ(expected_size, out_size);
+    EXPECT_EQ(0, std::memcmp(expected, out, out_size));
+}
+
+TEST(DecoderScratchTest, GrowsWithTheBlocks) {
+    const std::vector<uint8_t> small_data = MakeWordData(1000, 3);
+    std::vector<std::vector<uint8_t> > small_blocks = CompressBlocks(small_data);
+    const std::vector<uint8_t> large_data = MakeWordData(kBlockMaxExpandedStreamSize, 5);
+    std::vector<std::vector<uint8_t> > large_blocks = CompressBlocks(large_data);
+    ASSERT_EQ(1u, small_blocks.size());
+    ASSERT_EQ(1u, large_blocks.size());
+
+    DecoderScratch scratch;
+    BlockDecompressor block_decomp(&scratch);
+    EXPECT_EQ(sizeof(DecoderScratch), scratch.MemoryFootprint());
+
+    ExpectBlockRestores(&block_decomp, &small_blocks[0], small_data.data(), small_data.size());
+    const size_t small_footprint = scratch.MemoryFootprint();
+    EXPECT_LT(small_footprint, sizeof(DecoderScratch) + 32 * 1024);
+
+    block_decomp.Reset();
+    ExpectBlockRestores(&block_decomp, &large_blocks[0], large_data.data(), large_data.size());
+    EXPECT_GT(scratch.MemoryFootprint(), small_footprint + 4 * kBlockMaxExpandedStreamSize);
+
+    // The buffers are kept for the next blocks
+    const size_t large_footprint = scratch.MemoryFootprint();
+    block_decomp.Reset();
+    ExpectBlockRestores(&block_decomp, &small_blocks[0], small_data.data(), small_data.size());
+    EXPECT_EQ(large_footprint, scratch.MemoryFootprint());
+}
+
+TEST(DecoderScratchTest, SharedByInterleavedStreams) {
+    const std::vector<uint8_t> data1 = MakeWordData(5 * kBlockMaxExpandedStreamSize + 777, 7);
+    std::vector<std::vector<uint8_t> > blocks1 = CompressBlocks(data1);
+    const std::vector<uint8_t> data2 = MakeWordData(4 * kBlockMaxExpandedStreamSize + 99, 9);
+    std::vector<std::vector<uint8_t> > blocks2 = CompressBlocks(data2);
+
+    DecoderScratch scratch;
+    BlockDecompressor block_decomp1(&scratch);
+    BlockDecompressor block_decomp2(&scratch);
+
+    size_t num_repeats = 0;
+    for(size_t i=0; i<blocks1.size(); ++i) {
+        ZjumpBlock header;
+        ASSERT_EQ(ZJUMP_NO_ERROR, block_decomp1.ReadHeader(blocks1[i].data(), blocks1[i].size(), &header));
+        num_repeats += header.huff_repeat ? 1 : 0;
+    }
+    ASSERT_GT(num_repeats, 0u);
+
+    // Every stream keeps its own Huffman decoders, so the blocks that
+    // repeat them are decoded right after a block of the other stream
+    for(size_t i=0; (i < blocks1.size()) || (i < blocks2.size()); ++i) {
+        if(i < blocks1.size()) {
+            const size_t offset = i * kBlockMaxExpandedStreamSize;
+            const size_t size = std::min(kBlockMaxExpandedStreamSize, data1.size() - offset);
+            ExpectBlockRestores(&block_decomp1, &blocks1[i], data1.data() + offset, size);
+        }
+
+        if(i < blocks2.size()) {
+            const size_t offset = i * kBlockMaxExpandedStreamSize;
+            const size_t size = std::min(kBlockMaxExpandedStreamSize, data2.size() - offset);
+            ExpectBlockRestores(&block_decomp2, &blocks2[i], data2.data() + offset, size);
+        }
+    }
+
+    EXPECT_LE(block_decomp1.MemoryFootprint(),
+              sizeof(BlockDecompressor) + kBlockMaxHuffmanEncodings * sizeof(BlockHuffmanDecoder));
+}
+
+TEST(BlockDecompressorTest, RejectsBadEntryPoints) {
+    const std::vector<uint8_t> data = MakeWordData(1000, 3);
+    std::vector<std::vector<uint8_t> > blocks = CompressBlocks(data);
+    ASSERT_EQ(1u, blocks.size());
+
+    BlockDecompressor block_decomp;
+    ZjumpBlock header;
+    ASSERT_EQ(ZJUMP_NO_ERROR, block_decomp.ReadHeader(blocks[0].data(), blocks[0].size(), &header));
+    ASSERT_GT(header.bwt_num_entry_points, 0);
+
+    // The first entry point follows the primary index and the number of
+    // entry points. All ones is past the largest block.
+    std::vector<uint8_t> out_of_range = blocks[0];
+    out_of_range.resize(out_of_range.size() + kBlockReadPaddingBytes);
+    const size_t first_bit = kBlockBwtPrimaryIndexFieldSize + kBlockBwtNumEntryPointsFieldSize;
+    for(size_t bit=first_bit; bit<first_bit+kBlockBwtEntryPointFieldSize; ++bit) {
+        out_of_range[bit / 8] |= static_cast<uint8_t>(1u << (bit % 8));
+    }
+
+    uint8_t *out = nullptr;
+    size_t out_size = 0;
+    EXPECT_EQ(ZJUMP_ERROR_FORMAT_BWT_ENTRY_POINTS,
+              block_decomp.ReadHeader(out_of_range.data(), blocks[0].size(), &header));
+    EXPECT_EQ(ZJUMP_ERROR_FORMAT_BWT_ENTRY_POINTS,
+              block_decomp.Decompress(out_of_range.data(), blocks[0].size(), &out, &out_size));
+
+    // A block cut within the entry points is just too short
+    const size_t truncated_size = (first_bit + kBlockBwtEntryPointFieldSize - 1) / 8;
+    EXPECT_EQ(ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT,
+              block_decomp.ReadHeader(blocks[0].data(), truncated_size, &header));
+}
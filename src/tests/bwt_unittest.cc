@@ -0,0 +1,190 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <divsufsort.h>
+
+#include "gtest/gtest.h"
+
+#include "../bwt.h"
+#include "../constants.h"
+#include "../mem.h"
+
+static void ExpectInverseBwtRestores(const uint8_t* data, const size_t data_size) {
+    uint8_t *stream = SecureAlloc<uint8_t>(data_size);
+    std::memcpy(stream, data, data_size);
+
+    int pidx = divbwt(stream, stream, nullptr, data_size);
+    ASSERT_GE(pidx, 0);
+
+    InverseBwt inverse_bwt;
+    EXPECT_EQ(ZJUMP_NO_ERROR, inverse_bwt.Transform(stream, data_size, pidx));
+
+    for(size_t i=0; i<data_size; ++i) {
+        EXPECT_EQ(data[i], stream[i]);
+    }
+
+    SecureFree<uint8_t>(stream);
+}
+
+TEST(InverseBwtTest, SingleByte) {
+    const uint8_t data[] = {'x'};
+    ExpectInverseBwtRestores(data, sizeof(data));
+}
+
+TEST(InverseBwtTest, ShortText) {
+    const char *text = "abracadabra";
+    ExpectInverseBwtRestores(reinterpret_cast<const uint8_t*>(text), strlen(text));
+}
+
+TEST(InverseBwtTest, RepeatedByte) {
+    const size_t data_size = 1000;
+    uint8_t data[data_size];
+    std::memset(data, 7, data_size);
+    ExpectInverseBwtRestores(data, data_size);
+}
+
+TEST(InverseBwtTest, MaxBlockSize) {
+    const size_t data_size = kBlockMaxExpandedStreamSize;
+    uint8_t *data = SecureAlloc<uint8_t>(data_size);
+    uint32_t x = 12345;
+    for(size_t i=0; i<data_size; ++i) {
+        x = x * 1103515245u + 12345u;
+        data[i] = static_cast<uint8_t>((x >> 16) % 16);
+    }
+
+    ExpectInverseBwtRestores(data, data_size);
+
+    SecureFree<uint8_t>(data);
+}
+
+TEST(InverseBwtTest, ReusedAcrossStreams) {
+    const char *text1 = "mississippi";
+    const char *text2 = "banana";
+    uint8_t stream1[16];
+    uint8_t stream2[16];
+    std::memcpy(stream1, text1, strlen(text1));
+    std::memcpy(stream2, text2, strlen(text2));
+
+    int pidx1 = divbwt(stream1, stream1, nullptr, strlen(text1));
+    int pidx2 = divbwt(stream2, stream2, nullptr, strlen(text2));
+
+    InverseBwt inverse_bwt;
+    EXPECT_EQ(ZJUMP_NO_ERROR, inverse_bwt.Transform(stream1, strlen(text1), pidx1));
+    EXPECT_EQ(ZJUMP_NO_ERROR, inverse_bwt.Transform(stream2, strlen(text2), pidx2));
+
+    EXPECT_EQ(0, std::memcmp(stream1, text1, strlen(text1)));
+    EXPECT_EQ(0, std::memcmp(stream2, text2, strlen(text2)));
+}
+
+static void ExpectBwtRoundTrip(const uint8_t* data,
+                               const size_t data_size,
+                               const uint8_t num_entry_points) {
+    uint8_t *expected = SecureAlloc<uint8_t>(data_size);
+    uint8_t *stream = SecureAlloc<uint8_t>(data_size);
+    std::memcpy(expected, data, data_size);
+    std::memcpy(stream, data, data_size);
+
+    int expected_pidx = divbwt(expected, expected, nullptr, data_size);
+    ASSERT_GE(expected_pidx, 0);
+
+    Bwt bwt;
+    uint32_t pidx = 0;
+    uint32_t entry_points[kBlockMaxBwtEntryPoints];
+    uint8_t n_entry_points = num_entry_points;
+    EXPECT_EQ(ZJUMP_NO_ERROR, bwt.Transform(stream, data_size, &pidx, entry_points, &n_entry_points));
+
+    // the transform must not depend on the number of entry points
+    EXPECT_EQ(static_cast<uint32_t>(expected_pidx), pidx);
+    EXPECT_EQ(0, std::memcmp(expected, stream, data_size));
+    EXPECT_LT(n_entry_points, data_size);
+
+    InverseBwt inverse_bwt;
+    EXPECT_EQ(ZJUMP_NO_ERROR, inverse_bwt.Transform(stream, data_size, pidx, entry_points, n_entry_points));
+    EXPECT_EQ(0, std::memcmp(data, stream, data_size));
+
+    SecureFree<uint8_t>(expected);
+    SecureFree<uint8_t>(stream);
+}
+
+TEST(BwtTest, EntryPoints) {
+    const char *text = "abracadabra abracadabra";
+    const uint8_t *data = reinterpret_cast<const uint8_t*>(text);
+
+    for(uint8_t k=0; k<=kBlockMaxBwtEntryPoints; ++k) {
+        ExpectBwtRoundTrip(data, strlen(text), k);
+    }
+}
+
+TEST(BwtTest, EntryPointsInShortStream) {
+    const uint8_t data[] = {'z', 'j'};
+    ExpectBwtRoundTrip(data, sizeof(data), kBlockMaxBwtEntryPoints);
+}
+
+TEST(BwtTest, EntryPointsInMaxBlockSize) {
+    const size_t data_size = kBlockMaxExpandedStreamSize;
+    uint8_t *data = SecureAlloc<uint8_t>(data_size);
+    for(size_t i=0; i<data_size; ++i) {
+        data[i] = static_cast<uint8_t>((i * i) >> 7);
+    }
+
+    ExpectBwtRoundTrip(data, data_size, kBlockDefaultBwtEntryPoints);
+    ExpectBwtRoundTrip(data, data_size, kBlockMaxBwtEntryPoints);
+
+    SecureFree<uint8_t>(data);
+}
+
+TEST(BwtTest, SerialAndParallelEnginesMatch) {
+    const size_t data_size = kBlockMaxExpandedStreamSize;
+    uint8_t *serial = SecureAlloc<uint8_t>(data_size);
+    uint8_t *parallel = SecureAlloc<uint8_t>(data_size);
+    for(size_t i=0; i<data_size; ++i) {
+        serial[i] = parallel[i] = static_cast<uint8_t>((i * 7919) % 251) & 0x1f;
+    }
+
+    SerialBwtEngine serial_engine;
+    ParallelBwtEngine parallel_engine(4);
+    uint32_t serial_pidx = 0;
+    uint32_t parallel_pidx = 0;
+    uint32_t serial_entry_points[kBlockMaxBwtEntryPoints];
+    uint32_t parallel_entry_points[kBlockMaxBwtEntryPoints];
+    uint8_t serial_n_entry_points = kBlockDefaultBwtEntryPoints;
+    uint8_t parallel_n_entry_points = kBlockDefaultBwtEntryPoints;
+
+    Bwt bwt;
+    bwt.SetEngine(&serial_engine);
+    EXPECT_EQ(ZJUMP_NO_ERROR, bwt.Transform(serial, data_size, &serial_pidx,
+        serial_entry_points, &serial_n_entry_points));
+    bwt.SetEngine(&parallel_engine);
+    EXPECT_EQ(ZJUMP_NO_ERROR, bwt.Transform(parallel, data_size, &parallel_pidx,
+        parallel_entry_points, &parallel_n_entry_points));
+
+    EXPECT_EQ(serial_pidx, parallel_pidx);
+    EXPECT_EQ(serial_n_entry_points, parallel_n_entry_points);
+    EXPECT_EQ(0, std::memcmp(serial_entry_points, parallel_entry_points,
+        serial_n_entry_points * sizeof(uint32_t)));
+    EXPECT_EQ(0, std::memcmp(serial, parallel, data_size));
+
+    SecureFree<uint8_t>(serial);
+    SecureFree<uint8_t>(parallel);
+}
+
+TEST(InverseBwtTest, WrongEntryPoint) {
+    uint8_t stream[] = {'a', 'b', 'c', 'd'};
+    const uint32_t entry_points[] = {0};
+    InverseBwt inverse_bwt;
+
+    EXPECT_EQ(ZJUMP_ERROR_BWT, inverse_bwt.Transform(stream, sizeof(stream), 1, entry_points, 1));
+}
+
+TEST(InverseBwtTest, WrongPrimaryIndex) {
+    uint8_t stream[] = {'a', 'b', 'c'};
+    InverseBwt inverse_bwt;
+
+    EXPECT_EQ(ZJUMP_ERROR_BWT, inverse_bwt.Transform(stream, sizeof(stream), 0));
+    EXPECT_EQ(ZJUMP_ERROR_BWT, inverse_bwt.Transform(stream, sizeof(stream), 4));
+}
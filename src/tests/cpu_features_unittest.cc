@@ -0,0 +1,56 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../constants.h"
+#include "../cpu_features.h"
+#include "../histogram.h"
+
+TEST(CpuFeaturesTest, Names) {
+    CpuFeatures features;
+    EXPECT_EQ("generic", features.Names());
+
+    features.avx2 = true;
+    features.bmi2 = true;
+    EXPECT_EQ("avx2 bmi2", features.Names());
+}
+
+TEST(CpuFeaturesTest, GenericCanBeForced) {
+    setenv("ZJUMP_CPU", "generic", 1);
+    const CpuFeatures features = DetectCpuFeatures();
+    unsetenv("ZJUMP_CPU");
+
+    EXPECT_EQ("generic", features.Names());
+}
+
+TEST(HistogramTest, CountSymbols) {
+    for(size_t num_symbols : {0, 1, 3, 4, 5, 1000, 4099}) {
+        std::vector<uint8_t> symbols(num_symbols);
+        uint32_t expected[kBlockMaxEncodingSymbols] = {0};
+        uint32_t seed = 9;
+
+        for(size_t i=0; i<num_symbols; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            // Runs of the same symbol as well
+            symbols[i] = (i % 7 < 3) ? 254 : static_cast<uint8_t>((seed >> 16) % kBlockMaxEncodingSymbols);
+            ++expected[symbols[i]];
+        }
+
+        uint32_t freqs[kBlockMaxEncodingSymbols];
+        std::fill_n(freqs, kBlockMaxEncodingSymbols, 12345u);
+        CountSymbols(symbols.data(), num_symbols, freqs);
+
+        for(uint16_t s=0; s<kBlockMaxEncodingSymbols; ++s) {
+            EXPECT_EQ(expected[s], freqs[s]);
+        }
+    }
+}
@@ -0,0 +1,129 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../compress.h"
+#include "../constants.h"
+#include "../decompress.h"
+#include "test_data.h"
+
+// Several blocks of text and random bytes, so that some blocks carry new
+// Huffman encodings and others repeat the ones of an earlier block.
+static std::vector<uint8_t> MakeMixedData() {
+    return MakeWordData(7 * kBlockMaxExpandedStreamSize + 12345, 7);
+}
+
+TEST(DecompressorTest, ParallelOutputMatchesInput) {
+    const std::vector<uint8_t> data = MakeMixedData();
+    FILE *compressed = CompressToFile(data);
+
+    for(int num_threads : {1, 2, 3, 8}) {
+        FILE *out_file = tmpfile();
+
+        rewind(compressed);
+        Decompressor decompressor;
+        decompressor.SetNumThreads(num_threads);
+        ASSERT_EQ(ZJUMP_NO_ERROR, decompressor.Decompress(compressed, out_file));
+
+        // The file position is left at the end of the output
+        EXPECT_EQ(static_cast<long>(data.size()), ftell(out_file));
+        EXPECT_TRUE(ReadFrom(out_file, 0) == data) << num_threads << " threads";
+
+        fclose(out_file);
+    }
+
+    fclose(compressed);
+}
+
+TEST(DecompressorTest, ParallelOutputStartsAtFilePosition) {
+    const std::vector<uint8_t> data = MakeMixedData();
+    FILE *compressed = CompressToFile(data);
+    FILE *out_file = tmpfile();
+    ASSERT_EQ(4u, fwrite("head", 1, 4, out_file));
+
+    Decompressor decompressor;
+    decompressor.SetNumThreads(4);
+    ASSERT_EQ(ZJUMP_NO_ERROR, decompressor.Decompress(compressed, out_file));
+
+    EXPECT_TRUE(ReadFrom(out_file, 4) == data);
+    EXPECT_EQ(static_cast<long>(data.size() + 4), ftell(out_file));
+
+    fclose(out_file);
+    fclose(compressed);
+}
+
+TEST(DecompressorTest, ParallelRejectsTruncatedStream) {
+    const std::vector<uint8_t> data = MakeMixedData();
+    FILE *compressed = CompressToFile(data);
+    std::vector<uint8_t> stream = ReadFrom(compressed, 0);
+    fclose(compressed);
+
+    stream.resize(stream.size() / 2);
+    FILE *truncated = TempFileWith(stream);
+
+    FILE *out_file = tmpfile();
+    Decompressor decompressor;
+    decompressor.SetNumThreads(4);
+    EXPECT_EQ(ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT, decompressor.Decompress(truncated, out_file));
+
+    fclose(out_file);
+    fclose(truncated);
+}
+
+TEST(DecompressorTest, TestsWithoutOutput) {
+    const std::vector<uint8_t> data = MakeMixedData();
+    FILE *compressed = CompressToFile(data);
+    const std::vector<uint8_t> stream = ReadFrom(compressed, 0);
+
+    for(int num_threads : {1, 3}) {
+        rewind(compressed);
+        Decompressor decompressor;
+        decompressor.SetNumThreads(num_threads);
+        ASSERT_EQ(ZJUMP_NO_ERROR, decompressor.Decompress(compressed, nullptr));
+
+        EXPECT_EQ(stream.size(), decompressor.CompressedSize());
+        EXPECT_EQ(data.size(), decompressor.DecompressedSize());
+    }
+
+    FILE *truncated = TempFileWith(std::vector<uint8_t>(stream.begin(), stream.begin() + stream.size() / 2));
+
+    for(int num_threads : {1, 3}) {
+        rewind(truncated);
+        Decompressor decompressor;
+        decompressor.SetNumThreads(num_threads);
+        EXPECT_EQ(ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT, decompressor.Decompress(truncated, nullptr));
+    }
+
+    fclose(truncated);
+    fclose(compressed);
+}
+
+TEST(DecompressorTest, MemoryFootprintLeavesOutTheBlocks) {
+    const std::vector<uint8_t> data = MakeMixedData();
+    FILE *compressed = CompressToFile(data);
+    FILE *out_file = tmpfile();
+
+    Decompressor decompressor;
+    EXPECT_EQ(sizeof(Decompressor), decompressor.MemoryFootprint());
+
+    ASSERT_EQ(ZJUMP_NO_ERROR, decompressor.Decompress(compressed, out_file));
+
+    // Only the Huffman decoders are kept (about 54 KB with all of them), and
+    // the stats of every block in builds with ZJUMP_STATS. The io_uring ring
+    // buffers are gone once Decompress returns.
+    const size_t stats_size = 2 * decompressor.Stats().NumBlocks() * sizeof(BlockStats);
+    EXPECT_GT(decompressor.MemoryFootprint(), sizeof(Decompressor));
+    EXPECT_LE(decompressor.MemoryFootprint(),
+              sizeof(Decompressor) + kBlockMaxHuffmanEncodings * sizeof(BlockHuffmanDecoder) + stats_size);
+
+    fclose(out_file);
+    fclose(compressed);
+}
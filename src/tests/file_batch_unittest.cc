@@ -0,0 +1,196 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../constants.h"
+#include "../decompress.h"
+#include "../file_batch.h"
+#include "test_data.h"
+
+// Text with stretches of random bytes, so that segments mix Huffman and FSE
+// coded blocks.
+static std::vector<uint8_t> MakeData(size_t size, uint32_t seed) {
+    return MakeWordData(size, seed, 70000, 4);
+}
+
+static std::string TempName() {
+    char name[] = "/tmp/zjump_batch_XXXXXX";
+    int fd = mkstemp(name);
+    EXPECT_NE(-1, fd);
+    close(fd);
+    return name;
+}
+
+static void WriteFile(const std::string& name, const std::vector<uint8_t>& data) {
+    FILE *file = fopen(name.c_str(), "wb");
+    ASSERT_NE(nullptr, file);
+    EXPECT_EQ(data.size(), fwrite(data.data(), 1, data.size(), file));
+    fclose(file);
+}
+
+static std::vector<uint8_t> ReadFile(const std::string& name) {
+    FILE *file = fopen(name.c_str(), "rb");
+    EXPECT_NE(nullptr, file);
+    if(file == nullptr) {
+        return std::vector<uint8_t>();
+    }
+
+    const std::vector<uint8_t> data = ReadFrom(file);
+    fclose(file);
+
+    return data;
+}
+
+static bool FileExists(const std::string& name) {
+    return access(name.c_str(), F_OK) == 0;
+}
+
+class FileBatchTest : public ::testing::Test {
+protected:
+    std::vector<std::vector<uint8_t>> data_;
+    std::vector<std::string> names_;
+
+    void SetUp() override {
+        // Short, single block, and more than one segment
+        const size_t sizes[] = {
+            1,
+            1000,
+            kBlockMaxExpandedStreamSize,
+            (kBatchSegmentBlocks + 3) * kBlockMaxExpandedStreamSize + 777
+        };
+
+        for(size_t i=0; i<sizeof(sizes)/sizeof(sizes[0]); ++i) {
+            data_.push_back(MakeData(sizes[i], static_cast<uint32_t>(i + 1)));
+            names_.push_back(TempName());
+            WriteFile(names_.back(), data_.back());
+        }
+    }
+
+    void TearDown() override {
+        for(const std::string& name : names_) {
+            remove(name.c_str());
+            remove((name + ".zjump").c_str());
+            remove((name + ".out").c_str());
+        }
+    }
+};
+
+TEST_F(FileBatchTest, CompressesAndDecompressesEveryFile) {
+    for(int num_threads : {1, 3}) {
+        FileBatch compress_batch(kBatchCompress, num_threads);
+        compress_batch.SetKeepInput(true);
+        for(const std::string& name : names_) {
+            compress_batch.Add(name, name + ".zjump");
+        }
+        ASSERT_EQ(ZJUMP_NO_ERROR, compress_batch.Run());
+        ASSERT_EQ(names_.size(), compress_batch.Results().size());
+
+        // The serial decompressor reads what the batch wrote
+        for(size_t i=0; i<names_.size(); ++i) {
+            EXPECT_EQ(ZJUMP_NO_ERROR, compress_batch.Results()[i].error);
+
+            FILE *in_file = fopen((names_[i] + ".zjump").c_str(), "rb");
+            FILE *out_file = fopen((names_[i] + ".out").c_str(), "wb+");
+            ASSERT_NE(nullptr, in_file);
+            ASSERT_NE(nullptr, out_file);
+
+            Decompressor decompressor;
+            EXPECT_EQ(ZJUMP_NO_ERROR, decompressor.Decompress(in_file, out_file));
+            fclose(in_file);
+            fclose(out_file);
+
+            EXPECT_EQ(data_[i], ReadFile(names_[i] + ".out"));
+        }
+
+        FileBatch decompress_batch(kBatchDecompress, num_threads);
+        decompress_batch.SetKeepInput(true);
+        for(const std::string& name : names_) {
+            decompress_batch.Add(name + ".zjump", name + ".out");
+        }
+        ASSERT_EQ(ZJUMP_NO_ERROR, decompress_batch.Run());
+
+        for(size_t i=0; i<names_.size(); ++i) {
+            EXPECT_EQ(data_[i], ReadFile(names_[i] + ".out"));
+        }
+    }
+}
+
+TEST_F(FileBatchTest, RemovesInputUnlessKept) {
+    FileBatch batch(kBatchCompress, 2);
+    for(const std::string& name : names_) {
+        batch.Add(name, name + ".zjump");
+    }
+    ASSERT_EQ(ZJUMP_NO_ERROR, batch.Run());
+
+    for(const std::string& name : names_) {
+        EXPECT_FALSE(FileExists(name));
+        EXPECT_TRUE(FileExists(name + ".zjump"));
+    }
+}
+
+TEST_F(FileBatchTest, ReportsFilesThatFail) {
+    const std::string missing = names_[0] + ".missing";
+
+    FileBatch batch(kBatchDecompress, 2);
+    batch.SetKeepInput(true);
+    batch.Add(missing, names_[0] + ".out");
+    // Not a compressed stream
+    batch.Add(names_[3], names_[3] + ".out");
+
+    EXPECT_NE(ZJUMP_NO_ERROR, batch.Run());
+    ASSERT_EQ(2u, batch.Results().size());
+    EXPECT_NE(ZJUMP_NO_ERROR, batch.Results()[0].error);
+    EXPECT_NE(ZJUMP_NO_ERROR, batch.Results()[1].error);
+    EXPECT_EQ(missing, batch.Results()[0].in_name);
+
+    // Inputs that fail are never removed
+    EXPECT_TRUE(FileExists(names_[3]));
+}
+
+TEST_F(FileBatchTest, TestsWithoutWriting) {
+    FileBatch compress_batch(kBatchCompress, 2);
+    compress_batch.SetKeepInput(true);
+    for(const std::string& name : names_) {
+        compress_batch.Add(name, name + ".zjump");
+    }
+    ASSERT_EQ(ZJUMP_NO_ERROR, compress_batch.Run());
+
+    // Cut the last file in half
+    std::vector<uint8_t> stream = ReadFile(names_[3] + ".zjump");
+    stream.resize(stream.size() / 2);
+    WriteFile(names_[3] + ".zjump", stream);
+
+    FileBatch test_batch(kBatchTest, 3);
+    for(const std::string& name : names_) {
+        test_batch.Add(name + ".zjump");
+    }
+    EXPECT_EQ(ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT, test_batch.Run());
+    ASSERT_EQ(names_.size(), test_batch.Results().size());
+
+    for(size_t i=0; i<names_.size(); ++i) {
+        const BatchFileResult &result = test_batch.Results()[i];
+
+        // Nothing is written or removed
+        EXPECT_TRUE(FileExists(names_[i] + ".zjump"));
+        EXPECT_FALSE(FileExists(names_[i] + ".out"));
+
+        if(i < 3) {
+            EXPECT_EQ(ZJUMP_NO_ERROR, result.error);
+            EXPECT_EQ(ReadFile(names_[i] + ".zjump").size(), result.in_size);
+            EXPECT_EQ(data_[i].size(), result.out_size);
+        } else {
+            EXPECT_EQ(ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT, result.error);
+        }
+    }
+}
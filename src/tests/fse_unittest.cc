@@ -0,0 +1,117 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include <cstdint>
+
+#include "gtest/gtest.h"
+#include "../bit_stream.h"
+#include "../fse.h"
+
+static void ExpectFseRestores(const uint8_t* stream, const size_t stream_size) {
+    const size_t data_size = 4096;
+    uint8_t data[data_size] = {0};
+    uint32_t freqs[kFseMaxSymbols] = {0};
+
+    for(size_t i=0; i<stream_size; ++i) {
+        ++freqs[stream[i]];
+    }
+
+    FseEncoder encoder(stream_size);
+    ASSERT_TRUE(encoder.Build(freqs, kFseMaxSymbols));
+    const size_t stream_length = encoder.Encode(stream, stream_size);
+
+    BitStreamWriter writer(data, data_size);
+    ASSERT_TRUE(encoder.WriteHeader(&writer));
+    EXPECT_EQ(writer.Get().size, encoder.HeaderLength());
+    ASSERT_TRUE(encoder.WriteStream(&writer));
+    EXPECT_EQ(writer.Get().size, encoder.HeaderLength() + stream_length);
+
+    BitStreamReader reader(data, data_size);
+    FseDecoder decoder;
+    ASSERT_TRUE(decoder.ReadHeader(reader));
+    ASSERT_TRUE(decoder.Start(reader));
+
+    for(size_t i=0; i<stream_size; ++i) {
+        uint8_t symbol;
+        ASSERT_TRUE(decoder.Decode(reader, &symbol));
+        EXPECT_EQ(stream[i], symbol);
+    }
+
+    EXPECT_EQ(reader.NextPos(), writer.Get().size);
+}
+
+TEST(FseDistributionTest, Normalize) {
+    uint32_t freqs[8] = {1000, 3, 0, 1, 500, 0, 0, 7};
+
+    FseDistribution distribution;
+    ASSERT_TRUE(distribution.Normalize(freqs, 8));
+
+    uint32_t sum = 0;
+    for(uint16_t s=0; s<8; ++s) {
+        EXPECT_EQ(freqs[s] == 0, distribution.Count(s) == 0);
+        sum += distribution.Count(s);
+    }
+
+    EXPECT_EQ(sum, 1u << distribution.TableLog());
+    EXPECT_EQ(distribution.MaxSymbol(), 7);
+}
+
+TEST(FseDistributionTest, NormalizeWithNoSymbol) {
+    uint32_t freqs[8] = {0};
+
+    FseDistribution distribution;
+    EXPECT_FALSE(distribution.Normalize(freqs, 8));
+}
+
+TEST(FseDistributionTest, ReadRejectsWrongSum) {
+    // table log 5, max symbol 1, counts 1 and 2: they do not add up to 32
+    uint8_t data[8] = {0};
+    BitStreamWriter writer(data, sizeof(data));
+    writer.Append(0, 3);
+    writer.Append(1, 8);
+    writer.Append(0x2, 3);
+    writer.Append(0x3, 3);
+
+    BitStreamReader reader(data, sizeof(data));
+    FseDistribution distribution;
+    EXPECT_FALSE(distribution.Read(reader));
+}
+
+TEST(FseCoderTest, SkewedStream) {
+    const size_t stream_size = 2000;
+    uint8_t stream[stream_size];
+    uint32_t seed = 7;
+
+    for(size_t i=0; i<stream_size; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        const uint32_t r = (seed >> 16) % 100;
+        stream[i] = (r < 90) ? 1 : (r < 97) ? 0 : static_cast<uint8_t>(2 + r % 40);
+    }
+
+    ExpectFseRestores(stream, stream_size);
+}
+
+TEST(FseCoderTest, SingleSymbol) {
+    const size_t stream_size = 100;
+    uint8_t stream[stream_size];
+
+    for(size_t i=0; i<stream_size; ++i) {
+        stream[i] = 254;
+    }
+
+    ExpectFseRestores(stream, stream_size);
+}
+
+TEST(FseCoderTest, AllSymbols) {
+    const size_t stream_size = 3 * kFseMaxSymbols;
+    uint8_t stream[stream_size];
+
+    for(size_t i=0; i<stream_size; ++i) {
+        stream[i] = static_cast<uint8_t>((i * 7) % kFseMaxSymbols);
+    }
+
+    ExpectFseRestores(stream, stream_size);
+}
@@ -4,16 +4,18 @@
     See LICENSE file in the project root for full license information.
 */
 
+#include <algorithm>
 #include <cstdint>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "../encode.h"
 #include "../huffman.h"
 
 TEST(HuffmanEncodingTest, MaxSymbols) {
-    HuffmanEncoding he4(4, 16);
-    HuffmanEncoding he16(16, 16);
-    HuffmanEncoding he256(256, 16);
+    HuffmanEncoding<4, 16> he4;
+    HuffmanEncoding<16, 16> he16;
+    HuffmanEncoding<256, 16> he256;
 
     EXPECT_EQ(4, he4.MaxSymbols());
     EXPECT_EQ(16, he16.MaxSymbols());
@@ -21,9 +23,9 @@ TEST(HuffmanEncodingTest, MaxSymbols) {
 }
 
 TEST(HuffmanEncodingTest, MaxBitLength) {
-    HuffmanEncoding he1(16, 4);
-    HuffmanEncoding he2(16, 8);
-    HuffmanEncoding he3(16, 16);
+    HuffmanEncoding<16, 4> he1;
+    HuffmanEncoding<16, 8> he2;
+    HuffmanEncoding<16, 16> he3;
 
     EXPECT_EQ(4, he1.MaxBitLength());
     EXPECT_EQ(8, he2.MaxBitLength());
@@ -41,7 +43,7 @@ TEST(HuffmanEncodingTest, SetEncodedSymbols) {
     };
     const size_t n_symbols = sizeof(enc_symbols) / sizeof(enc_symbols[0]);
 
-    HuffmanEncoding he(8, 16);
+    HuffmanEncoding<8, 16> he;
     he.SetEncodedSymbols(enc_symbols, n_symbols);
 
     for(size_t i=0; i<n_symbols; ++i) {
@@ -54,13 +56,28 @@ TEST(HuffmanEncodingTest, SetEncodedSymbols) {
 }
 
 TEST(HuffmanEncodingTest, SymbolIsNotAvailable) {
-    HuffmanEncoding he(16, 16);
+    HuffmanEncoding<16, 16> he;
 
     for(uint16_t i=0; i<16; ++i) {
         EXPECT_TRUE(nullptr == he.GetEncodedSymbol(i));
     }
 }
 
+TEST(HuffmanEncodingTest, EncoderTable) {
+    HuffmanEncoding<8, 15> he;
+    he.SetEncodedSymbol(EncodedSymbol(1, 3, 0x6));
+    he.SetEncodedSymbol(EncodedSymbol(4, 15, 0x4001));
+
+    const uint32_t *table = he.EncoderTable();
+    EXPECT_EQ(table[0], 0u);
+    EXPECT_EQ(table[1], (0x3u << 8) | 3);
+    EXPECT_EQ(table[4], (0x4001u << 8) | 15);
+
+    he.Clear();
+    EXPECT_EQ(table[1], 0u);
+    EXPECT_EQ(table[4], 0u);
+}
+
 TEST(HuffmanFrequencyBuilderTest, Build) {
     const uint16_t symbols[] = {1, 2, 3, 4, 5, 6};
     const uint32_t freqs[] = {5, 7, 10, 15, 20, 45};
@@ -74,12 +91,12 @@ TEST(HuffmanFrequencyBuilderTest, Build) {
         {6, 1, 0}
     };
 
-    HuffmanFrequencyBuilder builder(8, 16);
+    HuffmanFrequencyBuilder<8, 16> builder;
     for(size_t i=0; i<n_symbols; ++i) {
         builder.SetSymbolFrequency(symbols[i], freqs[i]);
     }
 
-    HuffmanEncoding *encoding = builder.Build();
+    HuffmanEncoding<8, 16> *encoding = builder.Build();
     ASSERT_TRUE(encoding != nullptr);
 
     for(size_t i=0; i<n_symbols; ++i) {
@@ -102,12 +119,12 @@ TEST(HuffmanFrequencyBuilderTest, BuildWithOneSymbolOnly) {
         {0, 1, 0}
     };
 
-    HuffmanFrequencyBuilder builder(8, 16);
+    HuffmanFrequencyBuilder<8, 16> builder;
     for(size_t i=0; i<n_symbols; ++i) {
         builder.SetSymbolFrequency(symbols[i], freqs[i]);
     }
 
-    HuffmanEncoding *encoding = builder.Build();
+    HuffmanEncoding<8, 16> *encoding = builder.Build();
     ASSERT_TRUE(encoding != nullptr);
 
     for(size_t i=0; i<n_symbols; ++i) {
@@ -123,8 +140,8 @@ TEST(HuffmanFrequencyBuilderTest, BuildWithOneSymbolOnly) {
 }
 
 TEST(HuffmanFrequencyBuilderTest, BuildWithNoSymbol) {
-    HuffmanFrequencyBuilder builder(8, 8);
-    HuffmanEncoding *encoding = builder.Build();
+    HuffmanFrequencyBuilder<8, 8> builder;
+    HuffmanEncoding<8, 8> *encoding = builder.Build();
 
     for(uint16_t i=0; i<8; ++i) {
         const EncodedSymbol *enc = encoding->GetEncodedSymbol(i);
@@ -134,6 +151,70 @@ TEST(HuffmanFrequencyBuilderTest, BuildWithNoSymbol) {
     delete encoding;
 }
 
+TEST(HuffmanFrequencyBuilderTest, BuildWithLimitedBitLength) {
+    const uint16_t n_symbols = 24;
+    const uint8_t max_bit_length = 8;
+    uint32_t freq_a = 1;
+    uint32_t freq_b = 1;
+
+    // Fibonacci frequencies produce the deepest possible tree
+    HuffmanFrequencyBuilder<32, max_bit_length> builder;
+    for(uint16_t s=0; s<n_symbols; ++s) {
+        builder.SetSymbolFrequency(s, freq_a);
+        uint32_t next = freq_a + freq_b;
+        freq_a = freq_b;
+        freq_b = next;
+    }
+
+    uint8_t bit_lengths[32];
+    builder.BuildBitLengths(bit_lengths);
+
+    uint32_t kraft = 0;
+    for(uint16_t s=0; s<32; ++s) {
+        if(s < n_symbols) {
+            EXPECT_GT(bit_lengths[s], 0);
+            EXPECT_LE(bit_lengths[s], max_bit_length);
+            kraft += 1u << (max_bit_length - bit_lengths[s]);
+        } else {
+            EXPECT_EQ(bit_lengths[s], 0);
+        }
+    }
+
+    EXPECT_EQ(kraft, 1u << max_bit_length);
+
+    // more frequent symbols never get longer codes
+    for(uint16_t s=1; s<n_symbols; ++s) {
+        EXPECT_LE(bit_lengths[s], bit_lengths[s - 1]);
+    }
+}
+
+TEST(HuffmanFrequencyBuilderTest, BuildAfterReset) {
+    HuffmanFrequencyBuilder<8, 16> builder;
+    HuffmanEncoding<8, 16> encoding;
+
+    builder.SetSymbolFrequency(0, 10);
+    builder.SetSymbolFrequency(1, 20);
+    builder.SetSymbolFrequency(2, 30);
+    builder.Build(&encoding);
+    EXPECT_TRUE(encoding.GetEncodedSymbol(0) != nullptr);
+
+    builder.Reset();
+    builder.SetSymbolFrequency(5, 1);
+    builder.SetSymbolFrequency(6, 1);
+    builder.Build(&encoding);
+
+    for(uint16_t s=0; s<8; ++s) {
+        const EncodedSymbol *enc = encoding.GetEncodedSymbol(s);
+        if((s == 5) || (s == 6)) {
+            ASSERT_TRUE(enc != nullptr);
+            EXPECT_EQ(enc->enc_bit_length, 1);
+            EXPECT_EQ(enc->enc_value, s - 5);
+        } else {
+            EXPECT_TRUE(enc == nullptr);
+        }
+    }
+}
+
 TEST(HuffmanBitLengthBuilderTest, Build) {
     const uint16_t symbols[] = {1, 2, 3, 4, 5, 6};
     const uint8_t bit_lengths[] = {4, 4, 3, 3, 3, 1};
@@ -147,12 +228,12 @@ TEST(HuffmanBitLengthBuilderTest, Build) {
         {6, 1, 0}
     };
 
-    HuffmanBitLengthBuilder builder(8, 16);
+    HuffmanBitLengthBuilder<8, 16> builder;
     for(size_t i=0; i<n_symbols; ++i) {
         builder.SetSymbolBitLength(symbols[i], bit_lengths[i]);
     }
 
-    HuffmanEncoding *encoding = builder.Build();
+    HuffmanEncoding<8, 16> *encoding = builder.Build();
     ASSERT_TRUE(encoding != nullptr);
 
     for(size_t i=0; i<n_symbols; ++i) {
@@ -175,12 +256,12 @@ TEST(HuffmanBitLengthBuilderTest, BuildWithOneSymbolOnly) {
         {0, 1, 0}
     };
 
-    HuffmanBitLengthBuilder builder(8, 16);
+    HuffmanBitLengthBuilder<8, 16> builder;
     for(size_t i=0; i<n_symbols; ++i) {
         builder.SetSymbolBitLength(symbols[i], bit_lengths[i]);
     }
 
-    HuffmanEncoding *encoding = builder.Build();
+    HuffmanEncoding<8, 16> *encoding = builder.Build();
     ASSERT_TRUE(encoding != nullptr);
 
     for(size_t i=0; i<n_symbols; ++i) {
@@ -196,8 +277,8 @@ TEST(HuffmanBitLengthBuilderTest, BuildWithOneSymbolOnly) {
 }
 
 TEST(HuffmanBitLengthBuilderTest, BuildWithNoSymbol) {
-    HuffmanBitLengthBuilder builder(8, 8);
-    HuffmanEncoding *encoding = builder.Build();
+    HuffmanBitLengthBuilder<8, 8> builder;
+    HuffmanEncoding<8, 8> *encoding = builder.Build();
 
     for(uint16_t i=0; i<8; ++i) {
         const EncodedSymbol *enc = encoding->GetEncodedSymbol(i);
@@ -212,17 +293,17 @@ TEST(HuffmanWriterTest, EncodingType0) {
     uint8_t data[data_size] = {0};
     uint8_t expected[data_size] = {0x8C, 0xCA, 0x4C, 0x00, 0x00};
 
-    HuffmanFrequencyBuilder huff_builder(8, 15);
+    HuffmanFrequencyBuilder<8, 15> huff_builder;
     huff_builder.SetSymbolFrequency(0, 10);
     huff_builder.SetSymbolFrequency(1, 4);
     huff_builder.SetSymbolFrequency(5, 6);
     huff_builder.SetSymbolFrequency(7, 12);
-    HuffmanEncoding *huff_enc = huff_builder.Build();
+    HuffmanEncoding<8, 15> *huff_enc = huff_builder.Build();
     ASSERT_TRUE(huff_enc != nullptr);
 
     BitStreamWriter bit_stream_writer(data, data_size);
 
-    HuffmanWriter huff_writer(*huff_enc);
+    HuffmanWriter<8, 15> huff_writer(*huff_enc);
     EXPECT_TRUE(huff_writer.Write(&bit_stream_writer));
 
     // encoding type: 2 first bits
@@ -238,22 +319,44 @@ TEST(HuffmanWriterTest, EncodingType0) {
     delete huff_enc;
 }
 
+TEST(HuffmanWriterTest, Length) {
+    const size_t data_size = 5;
+    uint8_t data[data_size] = {0};
+
+    HuffmanFrequencyBuilder<8, 15> huff_builder;
+    huff_builder.SetSymbolFrequency(0, 10);
+    huff_builder.SetSymbolFrequency(1, 4);
+    huff_builder.SetSymbolFrequency(5, 6);
+    huff_builder.SetSymbolFrequency(7, 12);
+    HuffmanEncoding<8, 15> *huff_enc = huff_builder.Build();
+    ASSERT_TRUE(huff_enc != nullptr);
+
+    BitStreamWriter bit_stream_writer(data, data_size);
+
+    HuffmanWriter<8, 15> huff_writer(*huff_enc);
+    EXPECT_EQ(huff_writer.Length(), 26u);
+    EXPECT_TRUE(huff_writer.Write(&bit_stream_writer));
+    EXPECT_EQ(bit_stream_writer.Get().size, huff_writer.Length());
+
+    delete huff_enc;
+}
+
 TEST(HuffmanWriterTest, EncodingType1) {
     const size_t data_size = 5;
     uint8_t data[data_size] = {0};
     uint8_t expected[data_size] = {0x35, 0x2A, 0x33, 0x01, 0x00};
 
-    HuffmanFrequencyBuilder huff_builder(16, 15);
+    HuffmanFrequencyBuilder<16, 15> huff_builder;
     huff_builder.SetSymbolFrequency(0, 10);
     huff_builder.SetSymbolFrequency(1, 4);
     huff_builder.SetSymbolFrequency(5, 6);
     huff_builder.SetSymbolFrequency(7, 12);
-    HuffmanEncoding *huff_enc = huff_builder.Build();
+    HuffmanEncoding<16, 15> *huff_enc = huff_builder.Build();
     ASSERT_TRUE(huff_enc != nullptr);
 
     BitStreamWriter bit_stream_writer(data, data_size);
 
-    HuffmanWriter huff_writer(*huff_enc);
+    HuffmanWriter<16, 15> huff_writer(*huff_enc);
     EXPECT_TRUE(huff_writer.Write(&bit_stream_writer));
 
     // encoding type: 2 first bits
@@ -274,17 +377,17 @@ TEST(HuffmanWriterTest, EncodingType2) {
     uint8_t data[data_size] = {0};
     uint8_t expected[data_size] = {0x0A, 0xA3, 0x20, 0x33, 0x01};
 
-    HuffmanFrequencyBuilder huff_builder(32, 15);
+    HuffmanFrequencyBuilder<32, 15> huff_builder;
     huff_builder.SetSymbolFrequency(20, 10);
     huff_builder.SetSymbolFrequency(21, 4);
     huff_builder.SetSymbolFrequency(25, 6);
     huff_builder.SetSymbolFrequency(27, 12);
-    HuffmanEncoding *huff_enc = huff_builder.Build();
+    HuffmanEncoding<32, 15> *huff_enc = huff_builder.Build();
     ASSERT_TRUE(huff_enc != nullptr);
 
     BitStreamWriter bit_stream_writer(data, data_size);
 
-    HuffmanWriter huff_writer(*huff_enc);
+    HuffmanWriter<32, 15> huff_writer(*huff_enc);
     EXPECT_TRUE(huff_writer.Write(&bit_stream_writer));
 
     // encoding type: 2 first bits
@@ -305,17 +408,17 @@ TEST(HuffmanWriterTest, EncodingType3) {
     uint8_t data[data_size] = {0};
     uint8_t expected[data_size] = {0x1B, 0x10, 0x40, 0x00, 0x21, 0x33, 0x01, 0x00};
 
-    HuffmanFrequencyBuilder huff_builder(64, 15);
+    HuffmanFrequencyBuilder<64, 15> huff_builder;
     huff_builder.SetSymbolFrequency(32, 10);
     huff_builder.SetSymbolFrequency(40, 4);
     huff_builder.SetSymbolFrequency(50, 6);
     huff_builder.SetSymbolFrequency(60, 12);
-    HuffmanEncoding *huff_enc = huff_builder.Build();
+    HuffmanEncoding<64, 15> *huff_enc = huff_builder.Build();
     ASSERT_TRUE(huff_enc != nullptr);
 
     BitStreamWriter bit_stream_writer(data, data_size);
 
-    HuffmanWriter huff_writer(*huff_enc);
+    HuffmanWriter<64, 15> huff_writer(*huff_enc);
     EXPECT_TRUE(huff_writer.Write(&bit_stream_writer));
 
     // encoding type: 2 first bits
@@ -336,7 +439,7 @@ TEST(HuffmanReaderTest, EncodingType0) {
     uint8_t data[data_size] = {0x8C, 0xCA, 0x4C, 0x00};
     const uint16_t max_symbols = 8;
     const uint8_t max_symbol_bit_length = 15;
-    HuffmanEncoding *huff_tree = nullptr;
+    HuffmanEncoding<max_symbols, max_symbol_bit_length> *huff_tree = nullptr;
     const size_t num_symbols = 4;
     const EncodedSymbol expected_enc[num_symbols] = {
         {0, 2, 2},
@@ -347,8 +450,8 @@ TEST(HuffmanReaderTest, EncodingType0) {
 
     BitStreamReader bit_reader(data, data_size);
 
-    HuffmanReader huff_reader(bit_reader, max_symbols, max_symbol_bit_length);
-    EXPECT_EQ(huff_reader.Read(&huff_tree), HuffmanReader::NO_ERROR);
+    HuffmanReader<max_symbols, max_symbol_bit_length> huff_reader(bit_reader);
+    EXPECT_EQ(huff_reader.Read(&huff_tree), huff_reader.NO_ERROR);
     ASSERT_TRUE(huff_tree != nullptr);
 
     EXPECT_EQ(huff_tree->MaxSymbols(), max_symbols);
@@ -370,7 +473,7 @@ TEST(HuffmanReaderTest, EncodingType1) {
     uint8_t data[data_size] = {0x35, 0x2A, 0x33, 0x01};
     const uint16_t max_symbols = 16;
     const uint8_t max_symbol_bit_length = 15;
-    HuffmanEncoding *huff_tree = nullptr;
+    HuffmanEncoding<max_symbols, max_symbol_bit_length> *huff_tree = nullptr;
     const size_t num_symbols = 4;
     const EncodedSymbol expected_enc[num_symbols] = {
         {0, 2, 2},
@@ -381,8 +484,8 @@ TEST(HuffmanReaderTest, EncodingType1) {
 
     BitStreamReader bit_reader(data, data_size);
 
-    HuffmanReader huff_reader(bit_reader, max_symbols, max_symbol_bit_length);
-    EXPECT_EQ(huff_reader.Read(&huff_tree), HuffmanReader::NO_ERROR);
+    HuffmanReader<max_symbols, max_symbol_bit_length> huff_reader(bit_reader);
+    EXPECT_EQ(huff_reader.Read(&huff_tree), huff_reader.NO_ERROR);
     ASSERT_TRUE(huff_tree != nullptr);
 
     EXPECT_EQ(huff_tree->MaxSymbols(), max_symbols);
@@ -404,7 +507,7 @@ TEST(HuffmanReaderTest, EncodingType2) {
     uint8_t data[data_size] = {0x0A, 0xA3, 0x20, 0x33, 0x01};
     const uint16_t max_symbols = 32;
     const uint8_t max_symbol_bit_length = 15;
-    HuffmanEncoding *huff_tree = nullptr;
+    HuffmanEncoding<max_symbols, max_symbol_bit_length> *huff_tree = nullptr;
     const size_t num_symbols = 4;
     const EncodedSymbol expected_enc[num_symbols] = {
         {20, 2, 2},
@@ -415,8 +518,8 @@ TEST(HuffmanReaderTest, EncodingType2) {
 
     BitStreamReader bit_reader(data, data_size);
 
-    HuffmanReader huff_reader(bit_reader, max_symbols, max_symbol_bit_length);
-    EXPECT_EQ(huff_reader.Read(&huff_tree), HuffmanReader::NO_ERROR);
+    HuffmanReader<max_symbols, max_symbol_bit_length> huff_reader(bit_reader);
+    EXPECT_EQ(huff_reader.Read(&huff_tree), huff_reader.NO_ERROR);
     ASSERT_TRUE(huff_tree != nullptr);
 
     EXPECT_EQ(huff_tree->MaxSymbols(), max_symbols);
@@ -438,7 +541,7 @@ TEST(HuffmanReaderTest, EncodingType3) {
     uint8_t data[data_size] = {0x1B, 0x10, 0x40, 0x00, 0x21, 0x33, 0x01, 0x00};
     const uint16_t max_symbols = 64;
     const uint8_t max_symbol_bit_length = 15;
-    HuffmanEncoding *huff_tree = nullptr;
+    HuffmanEncoding<max_symbols, max_symbol_bit_length> *huff_tree = nullptr;
     const size_t num_symbols = 4;
     const EncodedSymbol expected_enc[num_symbols] = {
         {32, 2, 2},
@@ -449,8 +552,8 @@ TEST(HuffmanReaderTest, EncodingType3) {
 
     BitStreamReader bit_reader(data, data_size);
 
-    HuffmanReader huff_reader(bit_reader, max_symbols, max_symbol_bit_length);
-    EXPECT_EQ(huff_reader.Read(&huff_tree), HuffmanReader::NO_ERROR);
+    HuffmanReader<max_symbols, max_symbol_bit_length> huff_reader(bit_reader);
+    EXPECT_EQ(huff_reader.Read(&huff_tree), huff_reader.NO_ERROR);
     ASSERT_TRUE(huff_tree != nullptr);
 
     EXPECT_EQ(huff_tree->MaxSymbols(), max_symbols);
@@ -467,3 +570,143 @@ TEST(HuffmanReaderTest, EncodingType3) {
     delete huff_tree;
 }
 
+
+TEST(HuffmanReaderTest, ReadIntoEncoding) {
+    const size_t data_size = 512;
+    uint8_t data[data_size] = {0};
+
+    BlockHuffmanFrequencyBuilder builder;
+    for(uint16_t s=0; s<kBlockMaxEncodingSymbols; s+=3) {
+        builder.SetSymbolFrequency(s, 1 + s % 7);
+    }
+    BlockHuffmanEncoding expected;
+    builder.Build(&expected);
+
+    BitStreamWriter bit_writer(data, data_size);
+    BlockHuffmanWriter huff_writer(expected);
+    ASSERT_TRUE(huff_writer.Write(&bit_writer));
+
+    // Symbols already in the encoding are replaced
+    BlockHuffmanEncoding encoding;
+    encoding.SetEncodedSymbol(EncodedSymbol(1, 1, 0));
+    encoding.SetEncodedSymbol(EncodedSymbol(2, 1, 1));
+
+    BitStreamReader bit_reader(data, data_size);
+    BlockHuffmanReader huff_reader(bit_reader);
+    EXPECT_EQ(huff_reader.Read(&encoding), huff_reader.NO_ERROR);
+    EXPECT_EQ(bit_reader.NextPos(), huff_writer.Length());
+
+    for(uint16_t s=0; s<kBlockMaxEncodingSymbols; ++s) {
+        EXPECT_EQ(encoding.EncoderTable()[s], expected.EncoderTable()[s]);
+    }
+}
+
+TEST(HuffmanDecoderTest, Decode) {
+    const size_t data_size = 2048;
+    uint8_t data[data_size] = {0};
+    const uint16_t max_symbols = 32;
+    const uint8_t max_bit_length = 15;
+
+    // fibonacci frequencies make codes longer than the decoding table
+    HuffmanFrequencyBuilder<max_symbols, max_bit_length> builder;
+    uint32_t f0 = 1;
+    uint32_t f1 = 1;
+    for(uint16_t s=0; s<max_symbols; ++s) {
+        builder.SetSymbolFrequency(s, f0);
+        f1 += f0;
+        f0 = f1 - f0;
+    }
+    HuffmanEncoding<max_symbols, max_bit_length> *huff_enc = builder.Build();
+    ASSERT_TRUE(huff_enc != nullptr);
+    ASSERT_EQ(huff_enc->GetEncodedSymbol(0)->enc_bit_length, max_bit_length);
+
+    // codes are appended with their first bit in the lowest position
+    BitStreamWriter bit_writer(data, data_size);
+    for(uint16_t s=0; s<max_symbols; ++s) {
+        const EncodedSymbol *enc = huff_enc->GetEncodedSymbol(s);
+        ASSERT_TRUE(enc != nullptr);
+
+        uint16_t reversed = 0;
+        for(uint8_t i=0; i<enc->enc_bit_length; ++i) {
+            reversed |= ((enc->enc_value >> i) & 1) << (enc->enc_bit_length - i - 1);
+        }
+        ASSERT_EQ(bit_writer.Append(reversed, enc->enc_bit_length), enc->enc_bit_length);
+    }
+
+    HuffmanDecoder<max_symbols, max_bit_length> decoder;
+    decoder.Build(*huff_enc);
+
+    BitStreamReader bit_reader(data, data_size);
+    for(uint16_t s=0; s<max_symbols; ++s) {
+        uint16_t symbol;
+        ASSERT_TRUE(decoder.Decode(bit_reader, &symbol));
+        EXPECT_EQ(symbol, s);
+    }
+
+    delete huff_enc;
+}
+
+TEST(HuffmanDecoderTest, DecodeSymbols) {
+    const size_t data_size = 4096;
+    // Room for the 8 bytes loaded past the end
+    uint8_t data[data_size + 8] = {0};
+    const uint16_t max_symbols = 24;
+    const uint8_t max_bit_length = 15;
+
+    HuffmanFrequencyBuilder<max_symbols, max_bit_length> builder;
+    uint32_t f0 = 1;
+    uint32_t f1 = 1;
+    for(uint16_t s=0; s<max_symbols; ++s) {
+        builder.SetSymbolFrequency(s, f0);
+        f1 += f0;
+        f0 = f1 - f0;
+    }
+    HuffmanEncoding<max_symbols, max_bit_length> *huff_enc = builder.Build();
+    ASSERT_TRUE(huff_enc != nullptr);
+
+    BitStreamWriter bit_writer(data, data_size);
+    uint32_t seed = 3;
+    size_t num_written = 0;
+    while(bit_writer.Get().size + max_bit_length < data_size * 8) {
+        seed = seed * 1103515245u + 12345u;
+        const EncodedSymbol *enc = huff_enc->GetEncodedSymbol((seed >> 16) % max_symbols);
+
+        uint16_t reversed = 0;
+        for(uint8_t i=0; i<enc->enc_bit_length; ++i) {
+            reversed |= ((enc->enc_value >> i) & 1) << (enc->enc_bit_length - i - 1);
+        }
+        ASSERT_EQ(bit_writer.Append(reversed, enc->enc_bit_length), enc->enc_bit_length);
+        ++num_written;
+    }
+
+    HuffmanDecoder<max_symbols, max_bit_length> decoder;
+    decoder.Build(*huff_enc);
+
+    // The same symbols as one at a time, in runs of any length
+    BitStreamReader expected_reader(data, data_size);
+    BitStreamReader bit_reader(data, data_size);
+    std::vector<HuffmanDecoder<max_symbols, max_bit_length>::Symbol> symbols(64);
+    size_t num_read = 0;
+
+    while(num_read < num_written) {
+        const size_t run = std::min<size_t>(1 + num_read % 50, num_written - num_read);
+        ASSERT_EQ(run, decoder.DecodeSymbols(bit_reader, run, symbols.data()));
+
+        for(size_t i=0; i<run; ++i) {
+            uint16_t symbol;
+            ASSERT_TRUE(decoder.Decode(expected_reader, &symbol));
+            EXPECT_EQ(symbol, symbols[i]);
+        }
+        EXPECT_EQ(expected_reader.NextPos(), bit_reader.NextPos());
+
+        num_read += run;
+    }
+
+    // Stops at the end of the stream
+    BitStreamReader short_reader(data, 2);
+    const size_t decoded = decoder.DecodeSymbols(short_reader, symbols.size(), symbols.data());
+    EXPECT_LT(decoded, symbols.size());
+    EXPECT_LE(short_reader.NextPos(), 16u);
+
+    delete huff_enc;
+}
@@ -0,0 +1,172 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../io_ring.h"
+
+// Builds without ZJUMP_USE_IO_URING, or kernels without io_uring, cannot set
+// up a ring at all.
+#define SKIP_IF_NO_IO_RING(ring)                            \
+    if(!(ring).Init(8)) {                                   \
+        GTEST_SKIP() << "io_uring is not available";        \
+    }
+
+TEST(IoRingTest, WritesAndReadsBack) {
+    IoRing ring;
+    SKIP_IF_NO_IO_RING(ring);
+
+    std::vector<uint8_t> data(3 * 4096 + 17);
+    std::vector<uint8_t> read_back(data.size());
+    for(size_t i=0; i<data.size(); ++i) {
+        data[i] = static_cast<uint8_t>(i * 7);
+    }
+
+    struct iovec buffers[2] = {{data.data(), data.size()}, {read_back.data(), read_back.size()}};
+    ring.RegisterBuffers(buffers, 2);
+
+    FILE *file = tmpfile();
+    ASSERT_NE(nullptr, file);
+
+    // two halves in flight at once, the second one first
+    IoRequest first;
+    IoRequest second;
+    first.fd = second.fd = fileno(file);
+    first.write = second.write = true;
+    first.buffer_index = second.buffer_index = 0;
+    first.data = data.data();
+    first.size = 5000;
+    second.data = data.data() + 5000;
+    second.size = data.size() - 5000;
+    second.offset = 5000;
+
+    ASSERT_TRUE(ring.Start(&second));
+    ASSERT_TRUE(ring.Start(&first));
+    EXPECT_TRUE(ring.Wait(&first));
+    EXPECT_TRUE(ring.Wait(&second));
+    EXPECT_EQ(0u, ring.InFlight());
+
+    IoRequest read;
+    read.fd = fileno(file);
+    read.buffer_index = 1;
+    read.data = read_back.data();
+    read.size = read_back.size();
+    ASSERT_TRUE(ring.Start(&read));
+    ASSERT_TRUE(ring.Wait(&read));
+    EXPECT_EQ(data.size(), read.done);
+    EXPECT_TRUE(data == read_back);
+
+    fclose(file);
+}
+
+TEST(IoRingTest, ReadStopsAtEndOfFile) {
+    IoRing ring;
+    SKIP_IF_NO_IO_RING(ring);
+
+    FILE *file = tmpfile();
+    ASSERT_NE(nullptr, file);
+    ASSERT_EQ(10u, fwrite("0123456789", 1, 10, file));
+    fflush(file);
+
+    uint8_t buffer[64];
+    IoRequest read;
+    read.fd = fileno(file);
+    read.data = buffer;
+    read.size = sizeof(buffer);
+    read.offset = 4;
+
+    ASSERT_TRUE(ring.Start(&read));
+    ASSERT_TRUE(ring.Wait(&read));
+    EXPECT_EQ(6u, read.done);
+    EXPECT_EQ('4', buffer[0]);
+
+    fclose(file);
+}
+
+TEST(IoRingTest, ReportsErrors) {
+    IoRing ring;
+    SKIP_IF_NO_IO_RING(ring);
+
+    FILE *read_only = fopen("/proc/self/exe", "rb");
+    ASSERT_NE(nullptr, read_only);
+
+    uint8_t buffer[16] = {0};
+    IoRequest write;
+    write.fd = fileno(read_only);
+    write.write = true;
+    write.data = buffer;
+    write.size = sizeof(buffer);
+
+    if(ring.Start(&write)) {
+        EXPECT_FALSE(ring.Wait(&write));
+    }
+    EXPECT_NE(0, write.error);
+
+    fclose(read_only);
+}
+
+// A request whose submission failed must never be written afterwards, when
+// the next request is submitted.
+TEST(IoRingTest, FailedSubmitLeavesNothingQueued) {
+    IoRing ring;
+    SKIP_IF_NO_IO_RING(ring);
+
+    FILE *file = tmpfile();
+    ASSERT_NE(nullptr, file);
+
+    uint8_t failed_data[16];
+    uint8_t data[16];
+    std::memset(failed_data, 'a', sizeof(failed_data));
+    std::memset(data, 'b', sizeof(data));
+
+    IoRequest failed;
+    failed.fd = fileno(file);
+    failed.write = true;
+    failed.data = failed_data;
+    failed.size = sizeof(failed_data);
+    failed.offset = 4096;
+
+    ring.FailSubmitsForTesting(1);
+    EXPECT_FALSE(ring.Start(&failed));
+    EXPECT_FALSE(failed.pending);
+    EXPECT_NE(0, failed.error);
+    EXPECT_EQ(0u, ring.InFlight());
+
+    IoRequest write;
+    write.fd = fileno(file);
+    write.write = true;
+    write.data = data;
+    write.size = sizeof(data);
+
+    ASSERT_TRUE(ring.Start(&write));
+    ASSERT_TRUE(ring.Wait(&write));
+    EXPECT_EQ(sizeof(data), write.done);
+    EXPECT_EQ(0u, ring.InFlight());
+
+    struct stat st;
+    ASSERT_EQ(0, fstat(fileno(file), &st));
+    EXPECT_EQ(static_cast<off_t>(sizeof(data)), st.st_size);
+
+    fclose(file);
+}
+
+TEST(IoRingTest, PositionalIoNeedsRegularFiles) {
+    FILE *file = tmpfile();
+    ASSERT_NE(nullptr, file);
+    EXPECT_TRUE(SupportsPositionalIo(file));
+    fclose(file);
+
+    FILE *pipe_file = popen("true", "r");
+    ASSERT_NE(nullptr, pipe_file);
+    EXPECT_FALSE(SupportsPositionalIo(pipe_file));
+    pclose(pipe_file);
+}
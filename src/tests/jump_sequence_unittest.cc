@@ -0,0 +1,134 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../block.h"
+#include "../constants.h"
+#include "../jump_sequence.h"
+#include "../mem.h"
+
+static void ExpectJstRestores(const uint8_t* data,
+                              const size_t data_size,
+                              JstStats* stats,
+                              JstStats* inverse_stats) {
+    uint8_t *stream = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+    uint8_t *restored = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+    size_t restored_size = 0;
+    ZjumpBlock block;
+
+    std::memcpy(stream, data, data_size);
+
+    Jst jst(stream, data_size);
+    ASSERT_EQ(ZJUMP_NO_ERROR, jst.Transform(&block, stats));
+
+    InverseJst inverse_jst(block);
+    ASSERT_EQ(ZJUMP_NO_ERROR, inverse_jst.Transform(restored, &restored_size, inverse_stats));
+
+    ASSERT_EQ(data_size, restored_size);
+    EXPECT_EQ(0, std::memcmp(data, restored, data_size));
+
+    SecureFree<uint8_t>(stream);
+    SecureFree<uint8_t>(restored);
+}
+
+TEST(JstTest, Counters) {
+    const size_t data_size = 20000;
+    uint8_t data[data_size];
+    uint32_t seed = 11;
+
+    // Runs of a few bytes, as found after a BWT
+    for(size_t i=0; i<data_size; ) {
+        seed = seed * 1103515245u + 12345u;
+        const uint8_t byte = static_cast<uint8_t>("abcdefgh"[(seed >> 16) % 8]);
+        for(size_t n=(seed >> 8) % 20 + 1; (n > 0) && (i < data_size); --n) {
+            data[i++] = byte;
+        }
+    }
+
+    JstStats stats;
+    JstStats inverse_stats;
+    ExpectJstRestores(data, data_size, &stats, &inverse_stats);
+
+    ASSERT_GT(stats.passes.size(), 0u);
+    EXPECT_EQ(data_size, stats.stream_size);
+    EXPECT_EQ(data_size, stats.passes[0].stream_size);
+    EXPECT_GT(stats.NumJSeqs(), 0u);
+    EXPECT_LT(stats.PaddingLiteralFraction(), 1.0);
+
+    for(size_t p=0; p<stats.passes.size(); ++p) {
+        EXPECT_GT(stats.passes[p].reduction, 0);
+        EXPECT_LT(stats.passes[p].bytes_moved, stats.passes[p].stream_size);
+    }
+
+    // The inverse transform undoes the same passes
+    ASSERT_EQ(stats.passes.size(), inverse_stats.passes.size());
+    for(size_t p=0; p<stats.passes.size(); ++p) {
+        EXPECT_EQ(stats.passes[p].stream_size, inverse_stats.passes[p].stream_size);
+        EXPECT_EQ(stats.passes[p].num_jseqs, inverse_stats.passes[p].num_jseqs);
+        EXPECT_EQ(stats.passes[p].num_skip_chunks, inverse_stats.passes[p].num_skip_chunks);
+    }
+    EXPECT_EQ(stats.stream_size, inverse_stats.stream_size);
+    EXPECT_EQ(stats.padding_literals_size, inverse_stats.padding_literals_size);
+}
+
+TEST(JstTest, NoJumpSequences) {
+    const uint8_t data[] = {'z'};
+
+    JstStats stats;
+    ExpectJstRestores(data, sizeof(data), &stats, nullptr);
+
+    EXPECT_EQ(0u, stats.passes.size());
+    EXPECT_EQ(1u, stats.padding_literals_size);
+    EXPECT_DOUBLE_EQ(1.0, stats.PaddingLiteralFraction());
+}
+
+TEST(InverseJstTest, TransformWithWorkspace) {
+    const char *text = "abracadabra abracadabra abracadabra";
+    const size_t data_size = strlen(text);
+    uint8_t stream[64];
+    size_t restored_size = 0;
+    ZjumpBlock block;
+
+    std::memcpy(stream, text, data_size);
+
+    Jst jst(stream, data_size);
+    ASSERT_EQ(ZJUMP_NO_ERROR, jst.Transform(&block));
+
+    InverseJst inverse_jst(block);
+    ASSERT_LE(data_size, inverse_jst.MaxOutputSize());
+
+    std::vector<uint8_t> restored(inverse_jst.MaxOutputSize());
+    std::vector<uint8_t> workspace(inverse_jst.MaxOutputSize());
+    ASSERT_EQ(ZJUMP_NO_ERROR, inverse_jst.Transform(restored.data(), &restored_size, nullptr, workspace.data()));
+
+    ASSERT_EQ(data_size, restored_size);
+    EXPECT_EQ(0, std::memcmp(text, restored.data(), data_size));
+}
+
+TEST(InverseJstTest, OutputTooLarge) {
+    uint8_t *stream = SecureAlloc<uint8_t>(kBlockMaxExpandedStreamSize);
+    size_t stream_size = 0;
+    ZjumpBlock block;
+    ASSERT_TRUE(block.ReserveMaxSizes());
+
+    block.padding_literals_size = kBlockMaxExpandedStreamSize;
+    block.jseq_stream[0] = 2;
+    block.jseq_stream[1] = kEndOfSequenceSymbol;
+    block.jseq_stream_size = 2;
+    block.jseq_literals[0] = 'a';
+    block.jseq_literals_size = 1;
+
+    InverseJst inverse_jst(block);
+    EXPECT_EQ(kBlockMaxExpandedStreamSize, inverse_jst.MaxOutputSize());
+    EXPECT_EQ(ZJUMP_ERROR_RECONSTRUCTING_STREAM, inverse_jst.Transform(stream, &stream_size));
+
+    SecureFree<uint8_t>(stream);
+}
@@ -0,0 +1,118 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../compress.h"
+#include "../constants.h"
+#include "../list_mode.h"
+#include "test_data.h"
+
+// Text with every third block of random bytes, so the last block may carry
+// its own Huffman encodings, repeat earlier ones, or be FSE coded.
+static std::vector<uint8_t> MakeData(size_t size) {
+    return MakeWordData(size, 11);
+}
+
+static std::vector<uint8_t> Compress(const std::vector<uint8_t>& data) {
+    FILE *out_file = CompressToFile(data);
+    const std::vector<uint8_t> stream = ReadFrom(out_file);
+    fclose(out_file);
+
+    return stream;
+}
+
+TEST(StreamListerTest, ListsSizesOfEveryStream) {
+    StreamLister lister;
+
+    for(size_t num_blocks=1; num_blocks<=7; ++num_blocks) {
+        for(size_t last_size : {static_cast<size_t>(1000), kBlockMaxExpandedStreamSize}) {
+            const std::vector<uint8_t> data = MakeData((num_blocks - 1) * kBlockMaxExpandedStreamSize + last_size);
+            const std::vector<uint8_t> stream = Compress(data);
+            FILE *file = TempFileWith(stream);
+
+            StreamListing listing;
+            ASSERT_EQ(ZJUMP_NO_ERROR, lister.List(file, &listing));
+            EXPECT_EQ(stream.size(), listing.compressed_size);
+            EXPECT_EQ(data.size(), listing.uncompressed_size);
+            EXPECT_EQ(num_blocks, listing.block_sizes.size());
+
+            fclose(file);
+        }
+    }
+}
+
+TEST(StreamListerTest, ListsFromPipes) {
+    const std::vector<uint8_t> data = MakeData(5 * kBlockMaxExpandedStreamSize);
+    const std::vector<uint8_t> stream = Compress(data);
+
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    FILE *pipe_file = fdopen(fds[0], "rb");
+    ASSERT_NE(nullptr, pipe_file);
+
+    std::thread writer([&stream, &fds]() {
+        size_t written = 0;
+        while(written < stream.size()) {
+            ssize_t ret = write(fds[1], stream.data() + written, stream.size() - written);
+            if(ret <= 0) {
+                break;
+            }
+            written += static_cast<size_t>(ret);
+        }
+        close(fds[1]);
+    });
+
+    StreamLister lister;
+    StreamListing listing;
+    EXPECT_EQ(ZJUMP_NO_ERROR, lister.List(pipe_file, &listing));
+    EXPECT_EQ(stream.size(), listing.compressed_size);
+    EXPECT_EQ(data.size(), listing.uncompressed_size);
+
+    writer.join();
+    fclose(pipe_file);
+}
+
+TEST(StreamListerTest, RejectsMalformedStreams) {
+    const std::vector<uint8_t> stream = Compress(MakeData(3 * kBlockMaxExpandedStreamSize));
+    StreamLister lister;
+    StreamListing listing;
+
+    std::vector<uint8_t> truncated(stream.begin(), stream.end() - 10);
+    FILE *file = TempFileWith(truncated);
+    EXPECT_EQ(ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT, lister.List(file, &listing));
+    fclose(file);
+
+    std::vector<uint8_t> extended(stream);
+    extended.push_back(0);
+    file = TempFileWith(extended);
+    EXPECT_EQ(ZJUMP_ERROR_FORMAT_STREAM_TOO_LARGE, lister.List(file, &listing));
+    fclose(file);
+
+    file = tmpfile();
+    EXPECT_EQ(ZJUMP_ERROR_FORMAT_STREAM_TOO_SHORT, lister.List(file, &listing));
+    fclose(file);
+}
+
+TEST(StreamListingTest, BlockSizeRange) {
+    StreamListing listing;
+    listing.block_sizes = {50, 10, 40, 20, 30};
+    listing.compressed_size = 100;
+    listing.uncompressed_size = 250;
+
+    uint32_t min_size, median_size, max_size;
+    listing.BlockSizeRange(&min_size, &median_size, &max_size);
+    EXPECT_EQ(10u, min_size);
+    EXPECT_EQ(30u, median_size);
+    EXPECT_EQ(50u, max_size);
+    EXPECT_DOUBLE_EQ(2.5, listing.Ratio());
+}
@@ -0,0 +1,55 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+#include "../mapped_file.h"
+
+TEST(MappedFileTest, MapsFromCurrentPosition) {
+    FILE *file = tmpfile();
+    ASSERT_NE(nullptr, file);
+
+    const char data[] = "0123456789";
+    ASSERT_EQ(10u, fwrite(data, 1, 10, file));
+    fflush(file);
+    fseek(file, 4, SEEK_SET);
+
+    MappedFile mapped;
+    ASSERT_TRUE(mapped.Map(file));
+    EXPECT_TRUE(mapped.IsMapped());
+    ASSERT_EQ(6u, mapped.Size());
+    EXPECT_EQ(0, std::memcmp(mapped.Data(), "456789", 6));
+
+    // The FILE position is left untouched
+    EXPECT_EQ(4, ftell(file));
+
+    mapped.Unmap();
+    EXPECT_FALSE(mapped.IsMapped());
+
+    fclose(file);
+}
+
+TEST(MappedFileTest, RejectsEmptyFilesAndPipes) {
+    MappedFile mapped;
+
+    FILE *file = tmpfile();
+    ASSERT_NE(nullptr, file);
+    EXPECT_FALSE(mapped.Map(file));
+    fclose(file);
+
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    FILE *pipe_file = fdopen(fds[0], "rb");
+    ASSERT_NE(nullptr, pipe_file);
+    EXPECT_FALSE(mapped.Map(pipe_file));
+    fclose(pipe_file);
+    close(fds[1]);
+}
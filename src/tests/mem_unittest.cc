@@ -0,0 +1,235 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../compress.h"
+#include "../constants.h"
+#include "../decompress.h"
+#include "../mem.h"
+#include "test_data.h"
+
+// Allocator on top of the default one that counts what is outstanding, and
+// fails every allocation after the first max_allocs.
+struct CountingAllocator {
+    ZjumpAllocator allocator;
+    std::atomic<size_t> num_allocs;
+    std::atomic<size_t> num_live;
+    std::atomic<size_t> live_bytes;
+    std::atomic<size_t> num_misaligned;
+    size_t max_allocs;
+
+    explicit CountingAllocator(size_t max = SIZE_MAX) :
+        num_allocs(0), num_live(0), live_bytes(0), num_misaligned(0), max_allocs(max) {
+        allocator.alloc = Alloc;
+        allocator.free = Free;
+        allocator.opaque = this;
+    }
+
+    static void* Alloc(void* opaque, size_t size, size_t alignment) {
+        CountingAllocator *self = static_cast<CountingAllocator*>(opaque);
+        if(self->num_allocs++ >= self->max_allocs) {
+            return nullptr;
+        }
+
+        const ZjumpAllocator *base = DefaultAllocator();
+        void *p = base->alloc(base->opaque, size, alignment);
+        if(p != nullptr) {
+            if(reinterpret_cast<uintptr_t>(p) % alignment != 0) {
+                ++self->num_misaligned;
+            }
+            ++self->num_live;
+            self->live_bytes += size;
+        }
+        return p;
+    }
+
+    static void Free(void* opaque, void* address, size_t size, size_t alignment) {
+        CountingAllocator *self = static_cast<CountingAllocator*>(opaque);
+        --self->num_live;
+        self->live_bytes -= size;
+
+        const ZjumpAllocator *base = DefaultAllocator();
+        base->free(base->opaque, address, size, alignment);
+    }
+};
+
+TEST(DefaultAllocatorTest, HonoursAlignment) {
+    const ZjumpAllocator *allocator = DefaultAllocator();
+
+    // Anonymous mappings are only guaranteed to be aligned to pages, and
+    // rarely to twice the huge page size
+    for(size_t alignment : {size_t(1), size_t(8), size_t(64), size_t(4096), kHugePageSize, 2 * kHugePageSize}) {
+        for(size_t size : {size_t(1), size_t(1000), kHugePageSize + 1}) {
+            uint8_t *p = static_cast<uint8_t*>(allocator->alloc(allocator->opaque, size, alignment));
+            ASSERT_NE(nullptr, p);
+            EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(p) % alignment);
+
+            p[0] = 1;
+            p[size - 1] = 2;
+            allocator->free(allocator->opaque, p, size, alignment);
+        }
+    }
+}
+
+TEST(DefaultAllocatorTest, GrowKeepsUsedElements) {
+    const ZjumpAllocator *allocator = DefaultAllocator();
+    uint32_t *array = nullptr;
+    size_t capacity = 0;
+
+    ASSERT_TRUE(Grow<uint32_t>(allocator, &array, &capacity, 0, 4));
+    EXPECT_EQ(4u, capacity);
+    for(uint32_t i=0; i<4; ++i) {
+        array[i] = i;
+    }
+
+    ASSERT_TRUE(Grow<uint32_t>(allocator, &array, &capacity, 3, 100));
+    EXPECT_EQ(100u, capacity);
+    for(uint32_t i=0; i<3; ++i) {
+        EXPECT_EQ(i, array[i]);
+    }
+
+    // Already large enough
+    ASSERT_TRUE(Grow<uint32_t>(allocator, &array, &capacity, 0, 10));
+    EXPECT_EQ(100u, capacity);
+
+    Deallocate<uint32_t>(allocator, array, capacity);
+}
+
+TEST(AllocatorTest, RoundTripGoesThroughAllocator) {
+    const std::vector<uint8_t> data = MakeWordData(3 * kBlockMaxExpandedStreamSize + 777, 3);
+    CountingAllocator counting;
+    FILE *compressed = tmpfile();
+
+    {
+        FILE *in_file = TempFileWith(data);
+        Compressor compressor(&counting.allocator);
+        ASSERT_EQ(ZJUMP_NO_ERROR, compressor.Compress(in_file, compressed));
+        fclose(in_file);
+        EXPECT_GT(counting.num_live.load(), 0u);
+    }
+    EXPECT_GT(counting.num_allocs.load(), 0u);
+    EXPECT_EQ(0u, counting.num_live.load());
+    EXPECT_EQ(0u, counting.live_bytes.load());
+
+    for(int num_threads : {1, 3}) {
+        const size_t num_allocs = counting.num_allocs;
+        FILE *out_file = tmpfile();
+
+        {
+            rewind(compressed);
+            Decompressor decompressor(&counting.allocator);
+            decompressor.SetNumThreads(num_threads);
+            ASSERT_EQ(ZJUMP_NO_ERROR, decompressor.Decompress(compressed, out_file));
+        }
+        EXPECT_GT(counting.num_allocs.load(), num_allocs);
+        EXPECT_EQ(0u, counting.num_live.load());
+        EXPECT_EQ(0u, counting.live_bytes.load());
+
+        EXPECT_EQ(data, ReadFrom(out_file));
+        fclose(out_file);
+    }
+
+    EXPECT_EQ(0u, counting.num_misaligned.load());
+    fclose(compressed);
+}
+
+TEST(AllocatorTest, FailureIsReported) {
+    const std::vector<uint8_t> data = MakeWordData(kBlockMaxExpandedStreamSize + 10, 3);
+    FILE *in_file = TempFileWith(data);
+    FILE *compressed = tmpfile();
+
+    CountingAllocator failing(0);
+    {
+        Compressor compressor(&failing.allocator);
+        EXPECT_EQ(ZJUMP_ERROR_MEMORY_ALLOC, compressor.Compress(in_file, compressed));
+    }
+
+    rewind(in_file);
+    {
+        Compressor compressor;
+        ASSERT_EQ(ZJUMP_NO_ERROR, compressor.Compress(in_file, compressed));
+    }
+
+    for(int num_threads : {1, 2}) {
+        FILE *out_file = tmpfile();
+
+        rewind(compressed);
+        Decompressor decompressor(&failing.allocator);
+        decompressor.SetNumThreads(num_threads);
+        EXPECT_EQ(ZJUMP_ERROR_MEMORY_ALLOC, decompressor.Decompress(compressed, out_file));
+        fclose(out_file);
+    }
+    EXPECT_EQ(0u, failing.num_live.load());
+
+    fclose(in_file);
+    fclose(compressed);
+}
+
+// Every allocation, in turn, is the one that fails: the call either succeeds
+// or reports it, and nothing is left allocated.
+TEST(AllocatorTest, FailureAtAnyPoint) {
+    const std::vector<uint8_t> data = MakeWordData(2 * kBlockMaxExpandedStreamSize + 10, 3);
+    FILE *in_file = TempFileWith(data);
+    FILE *compressed = tmpfile();
+
+    CountingAllocator counting;
+    {
+        Compressor compressor(&counting.allocator);
+        ASSERT_EQ(ZJUMP_NO_ERROR, compressor.Compress(in_file, compressed));
+    }
+    const size_t compress_allocs = counting.num_allocs;
+
+    for(size_t max_allocs=0; max_allocs<compress_allocs; ++max_allocs) {
+        FILE *out_file = tmpfile();
+        CountingAllocator failing(max_allocs);
+
+        rewind(in_file);
+        {
+            Compressor compressor(&failing.allocator);
+            const ZjumpErrorCode ret_code = compressor.Compress(in_file, out_file);
+            EXPECT_TRUE((ret_code == ZJUMP_NO_ERROR) || (ret_code == ZJUMP_ERROR_MEMORY_ALLOC));
+        }
+        EXPECT_EQ(0u, failing.num_live.load());
+        fclose(out_file);
+    }
+
+    counting.num_allocs = 0;
+    {
+        FILE *out_file = tmpfile();
+        rewind(compressed);
+        Decompressor decompressor(&counting.allocator);
+        ASSERT_EQ(ZJUMP_NO_ERROR, decompressor.Decompress(compressed, out_file));
+        fclose(out_file);
+    }
+    const size_t decompress_allocs = counting.num_allocs;
+
+    for(size_t max_allocs=0; max_allocs<decompress_allocs; ++max_allocs) {
+        FILE *out_file = tmpfile();
+        CountingAllocator failing(max_allocs);
+
+        rewind(compressed);
+        {
+            Decompressor decompressor(&failing.allocator);
+            const ZjumpErrorCode ret_code = decompressor.Decompress(compressed, out_file);
+            EXPECT_TRUE((ret_code == ZJUMP_NO_ERROR) || (ret_code == ZJUMP_ERROR_MEMORY_ALLOC));
+            if(ret_code == ZJUMP_NO_ERROR) {
+                EXPECT_EQ(data, ReadFrom(out_file));
+            }
+        }
+        EXPECT_EQ(0u, failing.num_live.load());
+        fclose(out_file);
+    }
+
+    fclose(in_file);
+    fclose(compressed);
+}
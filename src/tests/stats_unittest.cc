@@ -0,0 +1,96 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "../stats.h"
+
+TEST(StreamStatsTest, TotalsAndPercentiles) {
+    StreamStats stats;
+
+    for(uint64_t i=1; i<=100; ++i) {
+        BlockStats block_stats;
+        block_stats.stage_nanos[kStatsStageBwt] = i * 1000;
+        block_stats.stage_nanos[kStatsStageIo] = 7;
+        stats.AddBlock(block_stats);
+    }
+
+    EXPECT_EQ(100u, stats.NumBlocks());
+    EXPECT_EQ(5050000u, stats.TotalNanos(kStatsStageBwt));
+    EXPECT_EQ(700u, stats.TotalNanos(kStatsStageIo));
+    EXPECT_EQ(0u, stats.TotalNanos(kStatsStageJst));
+
+    EXPECT_EQ(1000u, stats.PercentileNanos(kStatsStageBwt, 0));
+    EXPECT_EQ(50000u, stats.PercentileNanos(kStatsStageBwt, 50));
+    EXPECT_EQ(99000u, stats.PercentileNanos(kStatsStageBwt, 99));
+    EXPECT_EQ(100000u, stats.PercentileNanos(kStatsStageBwt, 100));
+
+    stats.Clear();
+    EXPECT_EQ(0u, stats.NumBlocks());
+    EXPECT_EQ(0u, stats.PercentileNanos(kStatsStageBwt, 50));
+}
+
+TEST(StageTimerTest, Laps) {
+    BlockStats block_stats;
+
+    ChronoStageTimer timer(&block_stats);
+    timer.Lap(kStatsStageBwt);
+    timer.Lap(kStatsStageRle);
+
+    EXPECT_EQ(0u, block_stats.stage_nanos[kStatsStageJst]);
+    EXPECT_EQ(block_stats.stage_nanos[kStatsStageBwt] + block_stats.stage_nanos[kStatsStageRle],
+              block_stats.TotalNanos());
+
+    NullStageTimer null_timer(&block_stats);
+    const uint64_t total = block_stats.TotalNanos();
+    null_timer.Lap(kStatsStageJst);
+    EXPECT_EQ(total, block_stats.TotalNanos());
+}
+
+static std::string PrintedStats(const StreamStats& stats) {
+    FILE *file = tmpfile();
+    std::string printed;
+    int c;
+
+    PrintStreamStats(file, stats);
+    rewind(file);
+    while((c = fgetc(file)) != EOF) {
+        printed.push_back(static_cast<char>(c));
+    }
+    fclose(file);
+
+    return printed;
+}
+
+TEST(PrintStreamStatsTest, ReductionOnlyWhenEstimated) {
+    JstPassStats pass_stats;
+    pass_stats.stream_size = 1000;
+    pass_stats.num_jseqs = 10;
+    pass_stats.num_skip_chunks = 2;
+    pass_stats.bytes_moved = 900;
+    pass_stats.reduction = 0;
+
+    // Inverse passes, as recorded when decompressing
+    BlockStats block_stats;
+    block_stats.jst.passes.push_back(pass_stats);
+    StreamStats stats;
+    stats.AddBlock(block_stats);
+
+    std::string printed = PrintedStats(stats);
+    EXPECT_NE(std::string::npos, printed.find("bytes moved"));
+    EXPECT_EQ(std::string::npos, printed.find("reduction"));
+
+    // Passes of the transform, as recorded when compressing
+    block_stats.jst.passes[0].reduction = 800;
+    stats.AddBlock(block_stats);
+
+    printed = PrintedStats(stats);
+    EXPECT_NE(std::string::npos, printed.find("est. reduction (bytes)"));
+}
@@ -0,0 +1,83 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#ifndef TESTS_TEST_DATA_H_
+#define TESTS_TEST_DATA_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../compress.h"
+#include "../constants.h"
+
+// size bytes of words, with every period-th stretch of stretch_size bytes made
+// of random bytes instead. With a stretch per block, some blocks carry their
+// own Huffman encodings, others repeat the ones of an earlier block, and the
+// random ones may be FSE coded.
+inline std::vector<uint8_t> MakeWordData(size_t size,
+                                         uint32_t seed,
+                                         size_t stretch_size = kBlockMaxExpandedStreamSize,
+                                         size_t period = 3) {
+    static const char *kWords[] = {
+        "alpha ", "beta ", "gamma ", "delta ", "epsilon ", "zeta ", "eta ", "theta "
+    };
+    std::vector<uint8_t> data;
+
+    while(data.size() < size) {
+        seed = seed * 1103515245u + 12345u;
+
+        if((data.size() / stretch_size) % period == period - 1) {
+            data.push_back(static_cast<uint8_t>(seed >> 16));
+        } else {
+            for(const char *c = kWords[(seed >> 16) % 8]; (*c != '\0') && (data.size() < size); ++c) {
+                data.push_back(static_cast<uint8_t>(*c));
+            }
+        }
+    }
+
+    return data;
+}
+
+// Temporary file holding data, positioned at its start.
+inline FILE* TempFileWith(const std::vector<uint8_t>& data) {
+    FILE *file = tmpfile();
+    EXPECT_NE(nullptr, file);
+    EXPECT_EQ(data.size(), fwrite(data.data(), 1, data.size(), file));
+    rewind(file);
+    return file;
+}
+
+// Contents of file from offset to its end.
+inline std::vector<uint8_t> ReadFrom(FILE* file, long offset = 0) {
+    std::vector<uint8_t> data;
+    int c;
+
+    fseek(file, offset, SEEK_SET);
+    while((c = fgetc(file)) != EOF) {
+        data.push_back(static_cast<uint8_t>(c));
+    }
+
+    return data;
+}
+
+// Temporary file holding the stream data compresses to, positioned at its
+// start.
+inline FILE* CompressToFile(const std::vector<uint8_t>& data) {
+    FILE *in_file = TempFileWith(data);
+    FILE *out_file = tmpfile();
+
+    Compressor compressor;
+    EXPECT_EQ(ZJUMP_NO_ERROR, compressor.Compress(in_file, out_file));
+    fclose(in_file);
+
+    rewind(out_file);
+    return out_file;
+}
+
+#endif // TESTS_TEST_DATA_H_
@@ -0,0 +1,65 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../work_stealing_pool.h"
+
+TEST(WorkStealingPoolTest, RunsEveryTask) {
+    for(int num_threads : {1, 2, 4, 7}) {
+        WorkStealingPool pool(num_threads);
+        std::vector<std::atomic<int>> runs(100);
+
+        for(size_t i=0; i<runs.size(); ++i) {
+            runs[i] = 0;
+            pool.Add([&runs, i, num_threads](int thread) {
+                EXPECT_GE(thread, 0);
+                EXPECT_LT(thread, num_threads);
+                runs[i]++;
+            });
+        }
+
+        pool.Run();
+
+        for(size_t i=0; i<runs.size(); ++i) {
+            EXPECT_EQ(1, runs[i]);
+        }
+    }
+}
+
+TEST(WorkStealingPoolTest, RunsTasksAddedByTasks) {
+    for(int num_threads : {1, 3, 8}) {
+        WorkStealingPool pool(num_threads);
+        std::atomic<int> runs(0);
+
+        // Every task adds two more, down to a depth of 8
+        std::function<void(int, int)> spawn = [&](int depth, int thread) {
+            runs++;
+            if(depth == 0) {
+                return;
+            }
+            for(int c=0; c<2; ++c) {
+                pool.Add([&spawn, depth](int t) { spawn(depth - 1, t); }, thread);
+            }
+        };
+
+        pool.Add([&spawn](int thread) { spawn(8, thread); });
+        pool.Add([&spawn](int thread) { spawn(4, thread); });
+        pool.Run();
+
+        EXPECT_EQ((1 << 9) - 1 + (1 << 5) - 1, runs);
+    }
+}
+
+TEST(WorkStealingPoolTest, RunsWithoutTasks) {
+    WorkStealingPool pool(4);
+    pool.Run();
+    EXPECT_EQ(4, pool.NumThreads());
+}
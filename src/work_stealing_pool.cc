@@ -0,0 +1,117 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#include "work_stealing_pool.h"
+
+#include <cassert>
+#include <thread>
+
+WorkStealingPool::WorkStealingPool(int num_threads) {
+    assert(num_threads > 0);
+
+    for(int t=0; t<num_threads; ++t) {
+        queues_.push_back(std::unique_ptr<TaskQueue>(new TaskQueue()));
+    }
+
+    next_queue_ = 0;
+    num_queued_ = 0;
+    num_pending_ = 0;
+}
+
+int WorkStealingPool::NumThreads() const {
+    return static_cast<int>(queues_.size());
+}
+
+void WorkStealingPool::Add(const Task& task, int thread) {
+    assert(thread < NumThreads());
+
+    // Counted first, so takers never see more tasks than counted
+    num_pending_++;
+    num_queued_++;
+
+    if(thread < 0) {
+        TaskQueue &queue = *queues_[next_queue_];
+        next_queue_ = (next_queue_ + 1) % queues_.size();
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+    } else {
+        TaskQueue &queue = *queues_[thread];
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_front(task);
+    }
+
+    std::lock_guard<std::mutex> lock(idle_mutex_);
+    idle_cv_.notify_one();
+}
+
+void WorkStealingPool::Run() {
+    std::vector<std::thread> threads;
+
+    for(int t=1; t<NumThreads(); ++t) {
+        threads.push_back(std::thread(&WorkStealingPool::RunThread, this, t));
+    }
+
+    RunThread(0);
+
+    for(size_t t=0; t<threads.size(); ++t) {
+        threads[t].join();
+    }
+}
+
+bool WorkStealingPool::TakeTask(int thread, Task* task) {
+    const int num_threads = NumThreads();
+
+    for(int i=0; i<num_threads; ++i) {
+        const int victim = (thread + i) % num_threads;
+        TaskQueue &queue = *queues_[victim];
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.tasks.empty()) {
+            continue;
+        }
+
+        if(victim == thread) {
+            *task = queue.tasks.front();
+            queue.tasks.pop_front();
+        } else {
+            *task = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+
+        num_queued_--;
+        return true;
+    }
+
+    return false;
+}
+
+void WorkStealingPool::RunThread(int thread) {
+    Task task;
+
+    while(true) {
+        if(TakeTask(thread, &task)) {
+            task(thread);
+
+            if(--num_pending_ == 0) {
+                std::lock_guard<std::mutex> lock(idle_mutex_);
+                idle_cv_.notify_all();
+            }
+            continue;
+        }
+
+        // Nothing to take: wait for new tasks, or for the last ones to finish
+        std::unique_lock<std::mutex> lock(idle_mutex_);
+        idle_cv_.wait(lock, [this]() {
+            return (num_queued_ > 0) || (num_pending_ == 0);
+        });
+
+        if((num_pending_ == 0) && (num_queued_ == 0)) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,64 @@
+/**
+    Copyright (c) 2017 Vicente Romero. All rights reserved.
+    Licensed under the MIT License.
+    See LICENSE file in the project root for full license information.
+*/
+
+#ifndef WORK_STEALING_POOL_H_
+#define WORK_STEALING_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// WorkStealingPool class
+//
+// Runs tasks on a fixed number of threads. Every thread takes tasks from the
+// front of its own queue and, when it runs out of them, steals from the back
+// of the queue of another thread. Tasks receive the index of the thread that
+// runs them, so they can use per-thread contexts.
+//
+// Tasks may add more tasks while they run: those go to the front of the
+// queue of the same thread, so a thread finishes what it started before
+// taking older tasks, and other threads steal the older ones.
+class WorkStealingPool {
+public:
+    typedef std::function<void(int)> Task;
+
+    explicit WorkStealingPool(int num_threads);
+
+    int NumThreads() const;
+
+    // Before Run, tasks are spread over the threads in turn. From a task
+    // run by thread, they go to its own queue.
+    void Add(const Task& task, int thread = -1);
+
+    // Runs every task, including the ones added meanwhile, and returns when
+    // all of them are done. The calling thread is thread 0.
+    void Run();
+
+private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<TaskQueue>> queues_;
+    size_t next_queue_;
+    // Tasks queued, and tasks queued or running
+    std::atomic<size_t> num_queued_;
+    std::atomic<size_t> num_pending_;
+    std::mutex idle_mutex_;
+    std::condition_variable idle_cv_;
+
+    bool TakeTask(int thread, Task* task);
+
+    void RunThread(int thread);
+};
+
+#endif // WORK_STEALING_POOL_H_
@@ -4,16 +4,27 @@
     See LICENSE file in the project root for full license information.
 */
 
+#include <chrono>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <string>
+#include <vector>
 
+#include "bench_mode.h"
+#include "bwt_engine.h"
 #include "compress.h"
 #include "constants.h"
+#include "cpu_features.h"
 #include "decompress.h"
+#include "file_batch.h"
+#include "list_mode.h"
+#include "stats.h"
 
 using namespace std;
 
+static const int kDefaultBenchIterations = 3;
+
 struct ExecConfig {
     bool help_opt;
     bool decompress_opt;
@@ -22,8 +33,19 @@ struct ExecConfig {
     bool keep_opt;
     bool version_opt;
     bool license_opt;
+    bool benchmark_opt;
+    bool json_opt;
+    bool stats_opt;
+    bool test_opt;
+    bool list_opt;
+    int num_threads;
+    int bench_iterations;
+    vector<size_t> bench_block_sizes;
+    vector<int> bench_threads;
     string in_file_name;
     string out_file_name;
+    // Only with several input files
+    vector<string> in_file_names;
     FILE *in_file;
     FILE *out_file;
 
@@ -35,6 +57,13 @@ struct ExecConfig {
         keep_opt        = false;
         version_opt     = false;
         license_opt     = false;
+        benchmark_opt   = false;
+        json_opt        = false;
+        stats_opt       = false;
+        test_opt        = false;
+        list_opt        = false;
+        num_threads     = 1;
+        bench_iterations = kDefaultBenchIterations;
         in_file         = stdin;
         out_file        = stdout;
     }
@@ -58,6 +87,7 @@ static void DisplayVersionNumber() {
     uint32_t minor = (kZjumpVersion / 100) % 100;
     uint32_t patch = kZjumpVersion % 100;
     fprintf(stderr, "zjump %u.%u.%u\n", major, minor, patch);
+    fprintf(stderr, "CPU features: %s\n", GetCpuFeatures().Names().c_str());
 }
 
 static void DisplayLicense() {
@@ -73,20 +103,51 @@ static void Usage(const char *name)
     fprintf(stderr,
 "zjump, a data compressor/decompressor\n"
 "\n"
-"Usage: %s [OPTIONS] [FILE]\n"
+"Usage: %s [OPTIONS] [FILE...]\n"
 "\n"
+"  -b, --benchmark      Benchmark compression and decompression of FILE in memory\n"
 "  -c, --stdout         Write on standard output\n"
 "  -d, --decompress     Decompress FILE\n"
 "  -f, --force          Force to overwrite the output file\n"
 "  -h, --help           Output this help and exit\n"
 "  -k, --keep           Keep the input file (do not delete it)\n"
+"  -l, --list           List the sizes of every compressed FILE\n"
 "  -L, --license        Display software license\n"
+"  -t, --test           Decompress every FILE without writing it, and report\n"
+"                       whether it is intact and how fast it decompresses\n"
+"  -T, -j, --threads N  Process the blocks of every FILE on N threads\n"
+"                       (default: 1)\n"
+"      --stats          Print the time spent on every stage (needs a build\n"
+"                       with ZJUMP_STATS)\n"
 "  -V, --version        Display version number\n"
 "\n"
+"Benchmark options:\n"
+"  -i, --iterations N   Number of rounds of every configuration (default: %d)\n"
+"  -B, --block-sizes L  Comma-separated list of block sizes, up to %zu bytes\n"
+"                       (default: 50000,100000,%zu)\n"
+"  -T, --threads L      Comma-separated list of suffix sorting thread counts\n"
+"                       (default: 1 and, if greater, the number of cores)\n"
+"      --json           Print the results as JSON\n"
+"\n"
 "If no FILE is given, zjump compresses or decompresses\n"
-"from standard input to standard output."
-"\n",
-    name);
+"from standard input to standard output. Several FILEs are processed at\n"
+"once, sharing the threads given by -T.\n",
+    name, kDefaultBenchIterations, kBlockMaxExpandedStreamSize, kBlockMaxExpandedStreamSize);
+}
+
+static string OutputFileName(const ExecConfig& config, const string& in_file_name) {
+    if(config.decompress_opt) {
+        size_t last_dot = in_file_name.find_last_of('.');
+
+        if( (last_dot == string::npos) ||
+            (in_file_name.compare(last_dot, string::npos, kZjumpCompressedExt) != 0)) {
+            return in_file_name + kZjumpDecompressedExt;
+        } else {
+            return in_file_name.substr(0, last_dot);
+        }
+    } else {
+        return in_file_name + kZjumpCompressedExt;
+    }
 }
 
 static void SetOutputFileName(ExecConfig* config) {
@@ -94,23 +155,72 @@ static void SetOutputFileName(ExecConfig* config) {
         return;
     }
 
-    if(config->decompress_opt) {
-        size_t last_dot = config->in_file_name.find_last_of('.');
+    config->out_file_name = OutputFileName(*config, config->in_file_name);
+}
 
-        if( (last_dot == string::npos) ||
-            (config->in_file_name.compare(last_dot, string::npos, kZjumpCompressedExt) != 0)) {
-            config->out_file_name = config->in_file_name + kZjumpDecompressedExt;
-        } else {
-            config->out_file_name = config->in_file_name.substr(0, last_dot);
+// Parses a comma-separated list of positive numbers not greater than max.
+template<typename T>
+static bool ParseNumberList(const char* str, T max, vector<T>* values) {
+    values->clear();
+
+    while(*str != '\0') {
+        char *end = nullptr;
+        unsigned long long value = strtoull(str, &end, 10);
+
+        if((end == str) || (value == 0) || (value > static_cast<unsigned long long>(max))) {
+            return false;
         }
-    } else {
-        config->out_file_name = config->in_file_name + kZjumpCompressedExt;
+
+        values->push_back(static_cast<T>(value));
+
+        if(*end == ',') {
+            ++end;
+        } else if(*end != '\0') {
+            return false;
+        }
+        str = end;
     }
+
+    return !values->empty();
 }
 
+// Returns the index of the first argument that is not an option, or -1 if
+// the value of an option is not valid.
 static int ParseOptions(int argc, char **argv, ExecConfig* config) {
     for(int i=1; i<argc; ++i) {
-        if((strcmp(argv[i], "-c") == 0) || (strcmp(argv[i], "--stdout") == 0)) {
+        const bool has_value = (i + 1 < argc);
+
+        if((strcmp(argv[i], "-b") == 0) || (strcmp(argv[i], "--benchmark") == 0)) {
+            config->benchmark_opt = true;
+        } else if(strcmp(argv[i], "--json") == 0) {
+            config->json_opt = true;
+        } else if(strcmp(argv[i], "--stats") == 0) {
+            config->stats_opt = true;
+        } else if((strcmp(argv[i], "-i") == 0) || (strcmp(argv[i], "--iterations") == 0)) {
+            vector<int> iterations;
+            if(!has_value || !ParseNumberList(argv[++i], 1000000, &iterations) || (iterations.size() != 1)) {
+                fprintf(stderr, "Invalid number of iterations\n");
+                return -1;
+            }
+            config->bench_iterations = iterations[0];
+        } else if((strcmp(argv[i], "-j") == 0) || (strcmp(argv[i], "--jobs") == 0)) {
+            vector<int> threads;
+            if(!has_value || !ParseNumberList(argv[++i], 1024, &threads) || (threads.size() != 1)) {
+                fprintf(stderr, "Invalid number of threads\n");
+                return -1;
+            }
+            config->num_threads = threads[0];
+        } else if((strcmp(argv[i], "-B") == 0) || (strcmp(argv[i], "--block-sizes") == 0)) {
+            if(!has_value || !ParseNumberList(argv[++i], kBlockMaxExpandedStreamSize, &config->bench_block_sizes)) {
+                fprintf(stderr, "Invalid list of block sizes\n");
+                return -1;
+            }
+        } else if((strcmp(argv[i], "-T") == 0) || (strcmp(argv[i], "--threads") == 0)) {
+            if(!has_value || !ParseNumberList(argv[++i], 1024, &config->bench_threads)) {
+                fprintf(stderr, "Invalid list of thread counts\n");
+                return -1;
+            }
+        } else if((strcmp(argv[i], "-c") == 0) || (strcmp(argv[i], "--stdout") == 0)) {
             config->stdout_opt = true;
         } else if((strcmp(argv[i], "-d") == 0) || (strcmp(argv[i], "--decompress") == 0)) {
             config->decompress_opt = true;
@@ -120,8 +230,12 @@ static int ParseOptions(int argc, char **argv, ExecConfig* config) {
             config->help_opt = true;
         } else if((strcmp(argv[i], "-k") == 0) || (strcmp(argv[i], "--keep") == 0)) {
             config->keep_opt = true;
+        } else if((strcmp(argv[i], "-l") == 0) || (strcmp(argv[i], "--list") == 0)) {
+            config->list_opt = true;
         } else if((strcmp(argv[i], "-L") == 0) || (strcmp(argv[i], "--license") == 0)) {
             config->license_opt = true;
+        } else if((strcmp(argv[i], "-t") == 0) || (strcmp(argv[i], "--test") == 0)) {
+            config->test_opt = true;
         } else if((strcmp(argv[i], "-V") == 0) || (strcmp(argv[i], "--version") == 0)) {
             config->version_opt = true;
         } else if(argv[i][0] == '-') {
@@ -139,15 +253,37 @@ static ZjumpErrorCode ValidateOptions(int argc, char **argv, int last_opt, ExecC
         return ZJUMP_NO_ERROR;
     }
 
+    // -T takes a list of thread counts in benchmark mode only
+    if(!config->benchmark_opt && !config->bench_threads.empty()) {
+        if(config->bench_threads.size() != 1) {
+            fprintf(stderr, "Invalid number of threads\n");
+            return ZJUMP_ERROR_ARGUMENT;
+        }
+        config->num_threads = config->bench_threads[0];
+    }
+
+    if( (config->test_opt && (config->benchmark_opt || config->stdout_opt)) ||
+        (config->list_opt && (config->benchmark_opt || config->stdout_opt || config->test_opt))) {
+        fprintf(stderr, "Incorrect arguments. Use -h to display more information\n");
+        return ZJUMP_ERROR_ARGUMENT;
+    }
+
     int last_args = argc - last_opt;
-    if(last_args > 1) {
+    if((last_args > 1) && (config->benchmark_opt || config->stdout_opt)) {
         fprintf(stderr, "Incorrect arguments. Use -h to display more information\n");
         return ZJUMP_ERROR_ARGUMENT;
+    } else if(last_args > 1) {
+        config->in_file_names.assign(argv + last_opt, argv + argc);
     } else if(last_args == 1) {
         config->in_file_name = argv[last_opt];
         SetOutputFileName(config);
     }
 
+    if(config->benchmark_opt && config->in_file_name.empty()) {
+        fprintf(stderr, "Benchmark mode needs a FILE\n");
+        return ZJUMP_ERROR_ARGUMENT;
+    }
+
     return ZJUMP_NO_ERROR;
 }
 
@@ -161,16 +297,16 @@ static bool FileExists(const char* file_name) {
     }
 }
 
-static ZjumpErrorCode ValidateOutput(const ExecConfig& config) {
+static ZjumpErrorCode ValidateOutput(const ExecConfig& config, const string& out_file_name_str) {
     if(config.force_opt) {
         return ZJUMP_NO_ERROR;
     }
 
-    if(config.out_file_name.empty()) {
+    if(out_file_name_str.empty()) {
         return ZJUMP_NO_ERROR;
     }
 
-    const char *out_file_name = config.out_file_name.c_str();
+    const char *out_file_name = out_file_name_str.c_str();
 
     if(FileExists(out_file_name)) {
         fprintf(stderr, "Output file %s already exists.\n", out_file_name);
@@ -224,10 +360,230 @@ static ZjumpErrorCode RemoveInput(const ExecConfig& config) {
     return ZJUMP_NO_ERROR;
 }
 
+static ZjumpErrorCode ReadWholeFile(FILE* file, vector<uint8_t>* data) {
+    uint8_t buffer[64 * 1024];
+    size_t read = 0;
+
+    data->clear();
+
+    while((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data->insert(data->end(), buffer, buffer + read);
+    }
+
+    if(ferror(file)) {
+        return ZJUMP_ERROR_FILE;
+    }
+
+    return ZJUMP_NO_ERROR;
+}
+
+// Compresses and decompresses the input file in memory with every
+// combination of block size and number of threads.
+static ZjumpErrorCode RunBenchmark(ExecConfig* config) {
+    const char *in_file_name = config->in_file_name.c_str();
+
+    config->in_file = fopen(in_file_name, "rb");
+    if(config->in_file == nullptr) {
+        perror(in_file_name);
+        return ZJUMP_ERROR_FILE;
+    }
+
+    vector<uint8_t> data;
+    ZjumpErrorCode ret_code = ReadWholeFile(config->in_file, &data);
+    if(ret_code != ZJUMP_NO_ERROR) {
+        perror(in_file_name);
+        return ret_code;
+    }
+
+    if(data.empty()) {
+        fprintf(stderr, "%s is empty\n", in_file_name);
+        return ZJUMP_ERROR_ARGUMENT;
+    }
+
+    if(config->bench_block_sizes.empty()) {
+        config->bench_block_sizes = {50000, 100000, kBlockMaxExpandedStreamSize};
+    }
+
+    if(config->bench_threads.empty()) {
+        config->bench_threads.push_back(1);
+        if(ParallelBwtEngine::MaxThreads() > 1) {
+            config->bench_threads.push_back(ParallelBwtEngine::MaxThreads());
+        }
+    }
+
+    InMemoryBench bench(data.data(), data.size());
+    vector<BenchResult> results;
+
+    for(size_t block_size : config->bench_block_sizes) {
+        for(int num_threads : config->bench_threads) {
+            BenchResult result;
+
+            ret_code = bench.Run(block_size, num_threads, config->bench_iterations, &result);
+            if(ret_code != ZJUMP_NO_ERROR) {
+                fprintf(stderr, "Benchmark failed with block size %zu and %d threads (error %d)\n",
+                        block_size, num_threads, ret_code);
+                return ret_code;
+            }
+
+            results.push_back(result);
+        }
+    }
+
+    if(config->json_opt) {
+        PrintBenchResultsJson(stdout, in_file_name, results);
+    } else {
+        PrintBenchResults(stdout, in_file_name, results);
+    }
+
+    return ZJUMP_NO_ERROR;
+}
+
+// Compresses or decompresses several files, or a single one on several
+// threads, with their blocks spread over the same threads.
+static ZjumpErrorCode RunBatch(ExecConfig* config) {
+    if(config->in_file_names.empty()) {
+        config->in_file_names.push_back(config->in_file_name);
+    }
+
+    if(config->stats_opt) {
+        fprintf(stderr, "--stats: not available with several files or threads\n");
+    }
+
+    FileBatch batch(config->decompress_opt ? kBatchDecompress : kBatchCompress, config->num_threads);
+    batch.SetKeepInput(config->keep_opt);
+
+    ZjumpErrorCode ret_code = ZJUMP_NO_ERROR;
+
+    for(const string& in_file_name : config->in_file_names) {
+        const string out_file_name = OutputFileName(*config, in_file_name);
+
+        ZjumpErrorCode file_code = ValidateOutput(*config, out_file_name);
+        if(file_code != ZJUMP_NO_ERROR) {
+            ret_code = file_code;
+            continue;
+        }
+
+        batch.Add(in_file_name, out_file_name);
+    }
+
+    ZjumpErrorCode batch_code = batch.Run();
+
+    for(const BatchFileResult& result : batch.Results()) {
+        if(result.error != ZJUMP_NO_ERROR) {
+            fprintf(stderr, "%s: failed (error %d)\n", result.in_name.c_str(), result.error);
+        }
+    }
+
+    return (ret_code != ZJUMP_NO_ERROR) ? ret_code : batch_code;
+}
+
+static void PrintTestResult(const char* name, const BatchFileResult& result) {
+    if(result.error != ZJUMP_NO_ERROR) {
+        printf("%s: failed (error %d)\n", name, result.error);
+        return;
+    }
+
+    const double speed = (result.seconds > 0) ? static_cast<double>(result.out_size) / result.seconds / 1000000 : 0;
+    printf("%s: OK, %zu -> %zu bytes, %.2f MB/s\n", name, result.in_size, result.out_size, speed);
+}
+
+// Decompresses every file, or the standard input, without writing anything.
+static ZjumpErrorCode RunTest(ExecConfig* config) {
+    if(config->in_file_names.empty() && config->in_file_name.empty()) {
+        BatchFileResult result;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        Decompressor decompressor;
+        decompressor.SetNumThreads(config->num_threads);
+        result.error = decompressor.Decompress(config->in_file, nullptr);
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.in_size = decompressor.CompressedSize();
+        result.out_size = decompressor.DecompressedSize();
+
+        PrintTestResult("(stdin)", result);
+        return result.error;
+    }
+
+    if(config->in_file_names.empty()) {
+        config->in_file_names.push_back(config->in_file_name);
+    }
+
+    FileBatch batch(kBatchTest, config->num_threads);
+
+    for(const string& in_file_name : config->in_file_names) {
+        batch.Add(in_file_name);
+    }
+
+    ZjumpErrorCode ret_code = batch.Run();
+
+    for(const BatchFileResult& result : batch.Results()) {
+        PrintTestResult(result.in_name.c_str(), result);
+    }
+
+    return ret_code;
+}
+
+// Prints the sizes of every file, or of the standard input, and their totals.
+static ZjumpErrorCode RunList(ExecConfig* config) {
+    if(config->in_file_names.empty()) {
+        config->in_file_names.push_back(config->in_file_name);
+    }
+
+    StreamLister lister;
+    StreamListing total;
+    size_t num_listed = 0;
+    ZjumpErrorCode ret_code = ZJUMP_NO_ERROR;
+
+    PrintStreamListingHeader(stdout);
+
+    for(const string& in_file_name : config->in_file_names) {
+        const char *name = in_file_name.empty() ? "(stdin)" : in_file_name.c_str();
+        FILE *in_file = in_file_name.empty() ? stdin : fopen(name, "rb");
+        if(in_file == nullptr) {
+            perror(name);
+            if(ret_code == ZJUMP_NO_ERROR) {
+                ret_code = ZJUMP_ERROR_FILE;
+            }
+            continue;
+        }
+
+        StreamListing listing;
+        ZjumpErrorCode file_code = lister.List(in_file, &listing);
+
+        if(in_file != stdin) {
+            fclose(in_file);
+        }
+
+        if(file_code != ZJUMP_NO_ERROR) {
+            printf("%s: failed (error %d)\n", name, file_code);
+            if(ret_code == ZJUMP_NO_ERROR) {
+                ret_code = file_code;
+            }
+            continue;
+        }
+
+        PrintStreamListing(stdout, name, listing);
+
+        total.compressed_size += listing.compressed_size;
+        total.uncompressed_size += listing.uncompressed_size;
+        total.block_sizes.insert(total.block_sizes.end(), listing.block_sizes.begin(), listing.block_sizes.end());
+        ++num_listed;
+    }
+
+    if(num_listed > 1) {
+        PrintStreamListing(stdout, "(total)", total);
+    }
+
+    return ret_code;
+}
+
 int main(int argc, char **argv) {
     ExecConfig config;
 
     int last_opt = ParseOptions(argc, argv, &config);
+    if(last_opt < 0) {
+        return ZJUMP_ERROR_ARGUMENT;
+    }
 
     int ret_code = ValidateOptions(argc, argv, last_opt, &config);
     if(ret_code != ZJUMP_NO_ERROR) {
@@ -245,7 +601,24 @@ int main(int argc, char **argv) {
         return ZJUMP_NO_ERROR;
     }
 
-    ret_code = ValidateOutput(config);
+    if(config.benchmark_opt) {
+        return RunBenchmark(&config);
+    }
+
+    if(config.test_opt) {
+        return RunTest(&config);
+    }
+
+    if(config.list_opt) {
+        return RunList(&config);
+    }
+
+    if(!config.in_file_names.empty() ||
+       ((config.num_threads > 1) && !config.decompress_opt && !config.out_file_name.empty())) {
+        return RunBatch(&config);
+    }
+
+    ret_code = ValidateOutput(config, config.out_file_name);
     if(ret_code != ZJUMP_NO_ERROR) {
         return ret_code;
     }
@@ -255,18 +628,31 @@ int main(int argc, char **argv) {
         return ret_code;
     }
 
+    if(config.stats_opt && !StageTimer::kEnabled) {
+        fprintf(stderr, "--stats: zjump was built without ZJUMP_STATS, no stats will be printed\n");
+    }
+
     if(config.decompress_opt) {
         Decompressor decompressor;
+        decompressor.SetNumThreads(config.num_threads);
         ret_code = decompressor.Decompress(config.in_file, config.out_file);
         if(ret_code != ZJUMP_NO_ERROR) {
             return ret_code;
         }
+
+        if(config.stats_opt && StageTimer::kEnabled) {
+            PrintStreamStats(stderr, decompressor.Stats());
+        }
     } else {
         Compressor compressor;
         ret_code = compressor.Compress(config.in_file, config.out_file);
         if(ret_code != ZJUMP_NO_ERROR) {
             return ret_code;
         }
+
+        if(config.stats_opt && StageTimer::kEnabled) {
+            PrintStreamStats(stderr, compressor.Stats());
+        }
     }
 
     ret_code = RemoveInput(config);